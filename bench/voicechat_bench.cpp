@@ -0,0 +1,503 @@
+// 热点路径的微基准：每个用例报告每次操作的耗时和堆分配次数，可输出 JSON 或 CSV 供回归比较
+#include "protocol.hpp"
+#include "frame_buffer.hpp"
+#include "frame_blocker.hpp"
+#include "logger.hpp"
+#include "mix_kernels.hpp"
+#include "opus_codec.hpp"
+#include "spsc_ring.hpp"
+#include "voice_server.hpp"
+#include <opus/opus.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace voicechat;
+
+// 替换全局 operator new 统计堆分配次数，protobuf 等库内的分配同样计入
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+// 阻止编译器把结果未被使用的计算优化掉
+template <typename T>
+void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct BenchCase {
+    std::string name;
+    std::function<void()> body;
+};
+
+struct BenchResult {
+    size_t iterations;
+    double nanosPerOp;
+    double allocationsPerOp;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// 固定次数运行；iterations 为 0 时按 minTime 自动确定次数，Opus 编码与帧解析的耗时相差几个数量级
+BenchResult runCase(const BenchCase& bench, size_t iterations, std::chrono::milliseconds minTime) {
+    // 预热，让帧缓冲池和 arena 进入稳定状态，同时估计单次耗时
+    size_t warmup = 0;
+    auto warmupStart = Clock::now();
+    auto warmupTime = minTime / 10;
+    do {
+        bench.body();
+        ++warmup;
+    } while ((iterations == 0 && Clock::now() - warmupStart < warmupTime) ||
+             (iterations != 0 && warmup < iterations / 10 + 1));
+    if (iterations == 0) {
+        double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - warmupStart).count()) / warmup;
+        double target = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(minTime).count());
+        iterations = static_cast<size_t>(std::max(1.0, target / std::max(nanos, 1.0)));
+    }
+
+    uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        bench.body();
+    }
+    auto elapsed = Clock::now() - start;
+    uint64_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    return {
+        iterations,
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations,
+        static_cast<double>(allocations) / iterations
+    };
+}
+
+// 440Hz 正弦加少量噪声的单声道 PCM，避免编码器把输入当作静音
+std::vector<float> samplePcm(size_t samples) {
+    std::vector<float> pcm(samples);
+    uint32_t noise = 12345;
+    for (size_t i = 0; i < samples; ++i) {
+        noise = noise * 1664525u + 1013904223u;
+        double t = static_cast<double>(i) / MEDIA_CLOCK_RATE;
+        pcm[i] = static_cast<float>(0.3 * std::sin(2.0 * 3.14159265358979323846 * 440.0 * t) +
+                                    0.02 * (static_cast<double>(noise >> 8) / (1u << 24) - 0.5));
+    }
+    return pcm;
+}
+
+// 与 OpusCodec 相同配置的编码器，便于比较不同帧长和复杂度
+std::shared_ptr<OpusEncoder> makeEncoder(int complexity) {
+    int error = OPUS_OK;
+    OpusEncoder* encoder = opus_encoder_create(MEDIA_CLOCK_RATE, 1, OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !encoder) {
+        throw std::runtime_error("opus_encoder_create failed");
+    }
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(64000));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    return std::shared_ptr<OpusEncoder>(encoder, opus_encoder_destroy);
+}
+
+std::shared_ptr<OpusDecoder> makeDecoder() {
+    int error = OPUS_OK;
+    OpusDecoder* decoder = opus_decoder_create(MEDIA_CLOCK_RATE, 1, &error);
+    if (error != OPUS_OK || !decoder) {
+        throw std::runtime_error("opus_decoder_create failed");
+    }
+    return std::shared_ptr<OpusDecoder>(decoder, opus_decoder_destroy);
+}
+
+// 与客户端发送的媒体包相同的消息体：类型字节 + 媒体头 + 一帧 20ms 的 Opus 数据
+std::vector<uint8_t> sampleMediaPacket(uint32_t sourceId = 42) {
+    MediaHeader header;
+    header.audioLevel = 96;
+    header.sequence = 12345;
+    header.timestamp = 12345 * 960;
+    header.sourceId = sourceId;
+    std::vector<uint8_t> payload(120, 0x5a);
+    FramePtr frame = encodeMediaFrame(header, payload.data(), payload.size());
+    return std::vector<uint8_t>(frame->body(), frame->body() + frame->bodySize());
+}
+
+ControlMessage sampleJoin(const std::string& userId) {
+    ControlMessage msg;
+    msg.set_type(ControlMessage::JOIN);
+    msg.set_user_id(userId);
+    msg.set_room_id("bench-room");
+    msg.set_protocol_version(PROTOCOL_VERSION);
+    return msg;
+}
+
+std::vector<uint8_t> sampleControlPacket() {
+    FramePtr frame = encodeFrame(FRAME_CONTROL, sampleJoin("bench-user-0001"));
+    return std::vector<uint8_t>(frame->body(), frame->body() + frame->bodySize());
+}
+
+// 内存中的传输层：不经过套接字，只统计投递次数，测量的是服务器自身的转发开销
+class InMemoryServer : public INetworkServer {
+public:
+    static constexpr size_t MAX_CLIENTS = 65536;
+
+    bool start(uint16_t) override { return true; }
+    void stop() override {}
+    void broadcast(const std::vector<uint8_t>&) override {}
+    bool sendTo(ClientId, const std::vector<uint8_t>&, SendPriority) override { return true; }
+
+    bool sendFrame(ClientId, SharedFrame frame, SendPriority) override {
+        // 记录服务器在欢迎消息和加入确认中分配的源ID
+        if (frameTypeOf(frame->body(), frame->bodySize()) == FRAME_RESPONSE) {
+            ServerResponse response;
+            if (response.ParseFromArray(frame->body() + FRAME_TYPE_SIZE,
+                                        static_cast<int>(frame->bodySize() - FRAME_TYPE_SIZE)) &&
+                response.source_id() != 0) {
+                lastSourceId = response.source_id();
+            }
+        }
+        return true;
+    }
+
+    void multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame, SendPriority) override {
+        delivered += clientIds.size();
+        doNotOptimize(frame->size());
+    }
+
+    uint32_t getMediaToken(ClientId) override { return 0; }
+    size_t maxClients() const override { return MAX_CLIENTS; }
+    void disconnectClient(ClientId) override {}
+
+    void setClientConnectedCallback(ClientCallback callback) override { connected = std::move(callback); }
+    void setClientDisconnectedCallback(ClientCallback callback) override { disconnected = std::move(callback); }
+    void setMessageCallback(ClientMessageCallback callback) override { message = std::move(callback); }
+
+    ClientCallback connected;
+    ClientCallback disconnected;
+    ClientMessageCallback message;
+    uint32_t lastSourceId = 0;
+    uint64_t delivered = 0;
+};
+
+// 一个有 members 名成员的房间，由第一个成员发言；消息经过与真实传输层相同的回调进入服务器
+class FanoutFixture {
+public:
+    explicit FanoutFixture(size_t members) {
+        auto transport = std::make_unique<InMemoryServer>();
+        transport_ = transport.get();
+        server_ = std::make_unique<VoiceServer>(0, std::move(transport));
+        if (!server_->start()) {
+            throw std::runtime_error("failed to start in-memory server");
+        }
+        for (size_t i = 0; i < members; ++i) {
+            ClientId clientId = (1u << HANDLE_INDEX_BITS) | static_cast<ClientId>(i);
+            transport_->connected(clientId);
+            FramePtr join = encodeFrame(FRAME_CONTROL, sampleJoin("member-" + std::to_string(i)));
+            transport_->message(clientId, ByteSpan(join->body(), join->bodySize()));
+            if (i == 0) {
+                speaker_ = clientId;
+                packet_ = sampleMediaPacket(transport_->lastSourceId);
+            }
+        }
+    }
+
+    void deliver() {
+        transport_->message(speaker_, ByteSpan(packet_));
+    }
+
+private:
+    InMemoryServer* transport_;
+    std::unique_ptr<VoiceServer> server_;
+    ClientId speaker_ = INVALID_HANDLE;
+    std::vector<uint8_t> packet_;
+};
+
+// 与 PortAudioDevice 采集路径相同的步骤：音频回调把采集数据写入无锁环形缓冲，
+// 采集线程取出一个整块放入复用的数组交给 VoiceClient 回调
+class CaptureHandoff {
+public:
+    explicit CaptureHandoff(size_t samples)
+        : input_(samplePcm(samples)), ring_(samples * 10), block_(samples) {
+        callback_ = [](const std::vector<float>& data) {
+            doNotOptimize(data.data());
+        };
+    }
+
+    void callback() {
+        ring_.write(input_.data(), input_.size());
+        if (ring_.readAvailable() >= block_.size()) {
+            ring_.read(block_.data(), block_.size());
+            callback_(block_);
+        }
+    }
+
+private:
+    std::vector<float> input_;
+    SpscRing<float> ring_;
+    std::vector<float> block_;
+    AudioCallback callback_;
+};
+
+std::string formatMillis(double ms) {
+    std::ostringstream stream;
+    stream << ms;
+    return stream.str();
+}
+
+enum class OutputFormat { Table, Json, Csv };
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--format=table|json|csv] [--filter=substring]"
+              << " [--min-time=ms] [iterations]" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    OutputFormat format = OutputFormat::Table;
+    std::string filter;
+    std::chrono::milliseconds minTime(200);
+    size_t iterations = 0;  // 0 表示按 minTime 自动确定
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--format=json") {
+            format = OutputFormat::Json;
+        } else if (arg == "--format=csv") {
+            format = OutputFormat::Csv;
+        } else if (arg == "--format=table") {
+            format = OutputFormat::Table;
+        } else if (arg.rfind("--filter=", 0) == 0) {
+            filter = arg.substr(9);
+        } else if (arg.rfind("--min-time=", 0) == 0) {
+            minTime = std::chrono::milliseconds(std::strtoul(arg.c_str() + 11, nullptr, 10));
+        } else if (!arg.empty() && arg[0] != '-') {
+            iterations = std::strtoul(arg.c_str(), nullptr, 10);
+            if (iterations == 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // 服务器用例会输出连接和加入房间的日志，基准输出需保持可解析
+    Logger::instance().setLevel(LogLevel::Warn);
+
+    const std::vector<uint8_t> mediaPacket = sampleMediaPacket();
+    const std::vector<uint8_t> controlPacket = sampleControlPacket();
+    const uint8_t* controlBody = controlPacket.data() + FRAME_TYPE_SIZE;
+    const int controlBodySize = static_cast<int>(controlPacket.size() - FRAME_TYPE_SIZE);
+    const ControlMessage joinMessage = sampleJoin("bench-user-0001");
+    const std::vector<uint8_t> opusPayload(120, 0x5a);
+
+    std::vector<BenchCase> cases = {
+        // 服务器转发一个媒体包：解析包头、判断静音、复制进池化的帧
+        {"media_parse_forward", [&]() {
+            MediaView media;
+            parseMediaPacket(mediaPacket.data() + FRAME_TYPE_SIZE, mediaPacket.size() - FRAME_TYPE_SIZE, media);
+            uint32_t level = isOpusSilence(media.payload) ? 0 : media.header.audioLevel;
+            FramePtr frame = makeFrame(mediaPacket.data(), mediaPacket.size());
+            doNotOptimize(level);
+            doNotOptimize(frame);
+        }},
+        // 客户端封装一个媒体包
+        {"media_encode", [&]() {
+            MediaHeader header;
+            header.audioLevel = 96;
+            header.sequence = 1;
+            header.sourceId = 42;
+            FramePtr frame = encodeMediaFrame(header, opusPayload.data(), opusPayload.size());
+            doNotOptimize(frame);
+        }},
+        // 服务器解析一条控制消息
+        {"control_parse/heap", [&]() {
+            ControlMessage msg;
+            msg.ParseFromArray(controlBody, controlBodySize);
+            doNotOptimize(msg.type());
+        }},
+        {"control_parse/arena", [&]() {
+            ParseArena::Scope arena;
+            ControlMessage& msg = *arena.create<ControlMessage>();
+            msg.ParseFromArray(controlBody, controlBodySize);
+            doNotOptimize(msg.type());
+        }},
+        // 序列化并加上长度头和类型字节
+        {"control_serialize", [&]() {
+            FramePtr frame = encodeFrame(FRAME_CONTROL, joinMessage);
+            doNotOptimize(frame);
+        }},
+    };
+
+    // 长度头分帧：从连续的字节流中按4字节长度头切出消息，与接收路径相同，每次操作为一条消息
+    {
+        constexpr size_t FRAMES_PER_STREAM = 64;
+        auto stream = std::make_shared<std::vector<uint8_t>>();
+        FramePtr frame = makeFrame(mediaPacket.data(), mediaPacket.size());
+        for (size_t i = 0; i < FRAMES_PER_STREAM; ++i) {
+            stream->insert(stream->end(), frame->data(), frame->data() + frame->size());
+        }
+        auto offset = std::make_shared<size_t>(0);
+        cases.push_back({"framing/split_stream", [stream, offset]() {
+            if (*offset >= stream->size()) {
+                *offset = 0;
+            }
+            const uint8_t* header = stream->data() + *offset;
+            uint32_t size = static_cast<uint32_t>(header[0]) | (static_cast<uint32_t>(header[1]) << 8) |
+                            (static_cast<uint32_t>(header[2]) << 16) | (static_cast<uint32_t>(header[3]) << 24);
+            const uint8_t* body = header + FrameBuffer::HEADER_SIZE;
+            doNotOptimize(frameTypeOf(body, size));
+            *offset += FrameBuffer::HEADER_SIZE + size;
+        }});
+    }
+
+    // Opus 支持的帧长（毫秒的十倍，2.5ms 记为 25）与几档复杂度，OpusCodec 固定使用 20ms、复杂度 8
+    const int frameDurations[] = {25, 50, 100, 200, 400, 600};
+    const int complexities[] = {0, 5, 8, 10};
+    for (int duration : frameDurations) {
+        const int samples = MEDIA_CLOCK_RATE / 1000 * duration / 10;
+        std::string durationName = formatMillis(duration / 10.0) + "ms";
+        auto pcm = std::make_shared<std::vector<float>>(samplePcm(static_cast<size_t>(samples)));
+        for (int complexity : complexities) {
+            auto encoder = makeEncoder(complexity);
+            auto packet = std::make_shared<std::vector<uint8_t>>(1275);
+            cases.push_back({"opus_encode/" + durationName + "/c" + std::to_string(complexity),
+                             [encoder, pcm, packet, samples]() {
+                doNotOptimize(opus_encode_float(encoder.get(), pcm->data(), samples, packet->data(),
+                                                static_cast<opus_int32>(packet->size())));
+            }});
+        }
+        auto encoded = std::make_shared<std::vector<uint8_t>>(1275);
+        opus_int32 encodedSize = opus_encode_float(makeEncoder(8).get(), pcm->data(), samples, encoded->data(),
+                                                   static_cast<opus_int32>(encoded->size()));
+        encoded->resize(encodedSize > 0 ? static_cast<size_t>(encodedSize) : 0);
+        auto decoder = makeDecoder();
+        auto output = std::make_shared<std::vector<float>>(static_cast<size_t>(samples));
+        cases.push_back({"opus_decode/" + durationName, [decoder, encoded, output, samples]() {
+            doNotOptimize(opus_decode_float(decoder.get(), encoded->data(), static_cast<opus_int32>(encoded->size()),
+                                            output->data(), samples, 0));
+        }});
+    }
+
+    // OpusCodec 本身，包含其每次调用分配的输入输出数组
+    {
+        auto codec = std::make_shared<OpusCodec>();
+        codec->initialize(MEDIA_CLOCK_RATE, 1);
+        auto pcm = std::make_shared<std::vector<float>>(samplePcm(MEDIA_CLOCK_RATE / 50));
+        auto encoded = std::make_shared<std::vector<uint8_t>>(codec->encode(*pcm));
+        cases.push_back({"opus_codec/encode", [codec, pcm]() {
+            doNotOptimize(codec->encode(*pcm).size());
+        }});
+        cases.push_back({"opus_codec/decode", [codec, encoded]() {
+            doNotOptimize(codec->decode(*encoded).size());
+        }});
+    }
+
+    // 采集数据重新分块：每次操作送入一个 1024 帧的声卡缓冲，按 Opus 帧长切出编码帧
+    for (int tenths : {25, 100, 200, 600}) {
+        auto blocker = std::make_shared<FrameBlocker>(static_cast<size_t>(MEDIA_CLOCK_RATE) * tenths / 10000);
+        auto input = std::make_shared<std::vector<float>>(samplePcm(1024));
+        cases.push_back({"framing/reblock/" + formatMillis(tenths / 10.0) + "ms", [blocker, input]() {
+            blocker->push(input->data(), input->size(), [](const float* frame, size_t) {
+                doNotOptimize(frame);
+            });
+        }});
+    }
+
+    // 采集回调到编码器的交接，每次操作为一个 20ms 的采集缓冲
+    {
+        auto handoff = std::make_shared<CaptureHandoff>(MEDIA_CLOCK_RATE / 50);
+        cases.push_back({"capture_handoff/spsc_ring", [handoff]() {
+            handoff->callback();
+        }});
+    }
+
+    // 客户端播放混音：按增益叠加多路 20ms 的解码结果后软削波
+    for (size_t streams : {1, 4, 16}) {
+        auto inputs = std::make_shared<std::vector<float>>(samplePcm(MEDIA_CLOCK_RATE / 50));
+        auto mix = std::make_shared<std::vector<float>>(inputs->size());
+        cases.push_back({"client_mix/streams_" + std::to_string(streams), [inputs, mix, streams]() {
+            std::fill(mix->begin(), mix->end(), 0.0f);
+            for (size_t i = 0; i < streams; ++i) {
+                mixAccumulateGain(mix->data(), inputs->data(), 0.8f, mix->size());
+            }
+            mixSoftClip(mix->data(), mix->size());
+            doNotOptimize(mix->data());
+        }});
+    }
+
+    // 服务器收到一个媒体包并转发给房间内其余成员，传输层为内存实现
+    for (size_t members : {2, 10, 100, 1000}) {
+        std::string name = "fanout/members_" + std::to_string(members);
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            continue;
+        }
+        auto fixture = std::make_shared<FanoutFixture>(members);
+        cases.push_back({name, [fixture]() {
+            fixture->deliver();
+        }});
+    }
+
+    if (format == OutputFormat::Table) {
+        std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(12) << "iterations"
+                  << std::setw(14) << "ns/op" << std::setw(14) << "allocs/op" << std::endl;
+    } else if (format == OutputFormat::Csv) {
+        std::cout << "name,iterations,ns_per_op,allocs_per_op" << std::endl;
+    } else {
+        std::cout << "{\"benchmarks\": [";
+    }
+    bool first = true;
+    for (const auto& bench : cases) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = runCase(bench, iterations, minTime);
+        std::cout << std::fixed;
+        if (format == OutputFormat::Table) {
+            std::cout << std::left << std::setw(36) << bench.name << std::right << std::setw(12) << result.iterations
+                      << std::setw(14) << std::setprecision(1) << result.nanosPerOp
+                      << std::setw(14) << std::setprecision(2) << result.allocationsPerOp << std::endl;
+        } else if (format == OutputFormat::Csv) {
+            std::cout << bench.name << "," << result.iterations << "," << std::setprecision(1) << result.nanosPerOp
+                      << "," << std::setprecision(2) << result.allocationsPerOp << std::endl;
+        } else {
+            std::cout << (first ? "\n" : ",\n") << "  {\"name\": \"" << bench.name << "\", \"iterations\": "
+                      << result.iterations << ", \"ns_per_op\": " << std::setprecision(1) << result.nanosPerOp
+                      << ", \"allocs_per_op\": " << std::setprecision(2) << result.allocationsPerOp << "}";
+        }
+        first = false;
+    }
+    if (format == OutputFormat::Json) {
+        std::cout << "\n]}" << std::endl;
+    }
+    return 0;
+}
@@ -1,22 +1,111 @@
 #pragma once
 
 #include "network_interface.hpp"
+#include "udp_media.hpp"
 #include <boost/asio.hpp>
+#include <boost/circular_buffer.hpp>
+#include <array>
+#include <chrono>
 #include <memory>
-#include <queue>
+#include <random>
 #include <mutex>
+#include <thread>
+#include <atomic>
 
 namespace voicechat {
 
+// 有界发送队列：写操作进行期间到达的数据在队列中累积，
+// 下一次写时合并为一次 scatter-gather 写出；积压超过上限时
+// 优先丢弃最旧的媒体包，控制消息不会被丢弃。
+// 控制消息和媒体包分两个队列存放，丢弃只发生在媒体队列头部；
+// 每个包带有入队序号，取批次时按序号合并，两类数据之间的发送顺序不变
+class OutboundQueue {
+public:
+    static constexpr size_t DEFAULT_MAX_QUEUED_BYTES = 256 * 1024;
+    static constexpr size_t MAX_BATCH_PACKETS = 64;
+    static constexpr size_t INITIAL_CAPACITY = 64;  // 待发送队列的初始包数
+
+    explicit OutboundQueue(size_t maxQueuedBytes = DEFAULT_MAX_QUEUED_BYTES);
+
+    // 入队，返回 true 表示当前没有写操作，调用者需要发起一次写
+    bool push(SharedFrame frame, SendPriority priority);
+
+    // 把待发送的数据转入当前批次并填充缓冲区序列；
+    // 没有待发送数据时结束写状态并返回 false
+    bool takeBatch(std::vector<boost::asio::const_buffer>& buffers);
+
+    // 当前批次写完成后释放其数据
+    void completeBatch();
+
+    // 丢弃积压的数据并结束写状态，用于连接关闭后重新连接；不能有进行中的写操作
+    void clear();
+
+    // 是否有进行中的写操作
+    bool isWriting() const;
+
+    // 因积压被丢弃的包数
+    size_t droppedCount() const;
+
+private:
+    struct Packet {
+        SharedFrame frame;
+        uint64_t order;  // 入队序号
+    };
+
+    static void append(boost::circular_buffer<Packet>& queue, Packet packet);
+
+    mutable std::mutex mutex_;
+    // 满时容量翻倍，稳定运行时不再分配内存
+    boost::circular_buffer<Packet> control_;
+    boost::circular_buffer<Packet> media_;
+    std::vector<Packet> inFlight_;
+    uint64_t nextOrder_;
+    size_t pendingBytes_;
+    size_t maxQueuedBytes_;
+    size_t dropped_;
+    bool writing_;
+};
+
+// 发送批次的缓冲区序列视图：作为 async_write 的参数时只复制两个指针，
+// 避免每次写都复制一份 std::vector<const_buffer>；写完成前不能修改其指向的数组
+class ConstBufferView {
+public:
+    using value_type = boost::asio::const_buffer;
+    using const_iterator = const boost::asio::const_buffer*;
+
+    explicit ConstBufferView(const std::vector<boost::asio::const_buffer>& buffers)
+        : begin_(buffers.data()), end_(buffers.data() + buffers.size()) {}
+
+    const_iterator begin() const { return begin_; }
+    const_iterator end() const { return end_; }
+
+private:
+    const_iterator begin_;
+    const_iterator end_;
+};
+
 class AsioConnection : public INetworkConnection {
 public:
+    // 服务器下发的单条消息上限，房间列表等响应可能远大于客户端消息
+    static constexpr size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+    // 使用自有的 io_context 和IO线程，connect() 同步解析地址，只能连接一次
     AsioConnection();
+    // 使用调用方运行的 io_context，不创建线程：connect() 在 io_context 上异步解析和连接，
+    // 不阻塞调用线程，断开后可再次调用以重新连接，再次调用时放弃尚未完成的连接尝试。
+    // disconnect() 和析构须在该 io_context 的线程上调用，析构前其上的回调须已执行完
+    explicit AsioConnection(boost::asio::io_context& context);
     ~AsioConnection() override;
 
     bool connect(const std::string& host, uint16_t port) override;
     void disconnect() override;
-    bool send(const std::vector<uint8_t>& data) override;
+    bool send(const std::vector<uint8_t>& data, SendPriority priority = SendPriority::Control) override;
+    bool send(SharedFrame frame, SendPriority priority = SendPriority::Control) override;
     bool isConnected() const override;
+    bool enableMedia(uint32_t token) override;
+
+    // UDP媒体通道当前是否可用
+    bool isMediaActive() const;
 
     void setMessageCallback(MessageCallback callback) override;
     void setErrorCallback(ErrorCallback callback) override;
@@ -24,65 +113,146 @@ public:
     void setDisconnectedCallback(ConnectionCallback callback) override;
 
 private:
-    void doConnect(const boost::asio::ip::tcp::endpoint& endpoint);
+    void doResolve(const std::string& host, uint16_t port, uint64_t attempt);
+    void doConnect(const boost::asio::ip::tcp::endpoint& endpoint, uint64_t attempt);
     void doRead();
     void doWrite();
     void handleError(const boost::system::error_code& error);
+    void doMediaReceive();
+    void doMediaProbe();
+    void sendDatagram(SharedFrame frame);
 
 private:
-    boost::asio::io_context io_context_;
+    std::unique_ptr<boost::asio::io_context> ownedContext_;  // 默认构造时自有，使用外部 io_context 时为空
+    boost::asio::io_context& io_context_;
     boost::asio::ip::tcp::socket socket_;
+    boost::asio::ip::tcp::resolver resolver_;
+    std::atomic<uint64_t> connectAttempt_;  // 每次连接递增，之前的尝试的回调据此放弃
     std::thread io_thread_;
     
+    // UDP媒体通道
+    boost::asio::ip::udp::socket udpSocket_;
+    boost::asio::steady_timer mediaTimer_;
+    std::array<uint8_t, MAX_DATAGRAM_SIZE> datagramBuffer_;
+    std::vector<uint8_t> datagramMessage_;
+    std::array<uint8_t, MEDIA_TOKEN_SIZE> mediaToken_;
+    std::atomic<bool> mediaActive_;
+    std::chrono::steady_clock::time_point lastDatagramTime_;
+    UdpImpairment impairment_;
+    
     MessageCallback messageCallback_;
     ErrorCallback errorCallback_;
     ConnectionCallback connectedCallback_;
     ConnectionCallback disconnectedCallback_;
     
-    std::mutex mutex_;
-    std::queue<std::vector<uint8_t>> writeQueue_;
-    bool isWriting_;
+    OutboundQueue writeQueue_;
+    std::vector<boost::asio::const_buffer> writeBuffers_;
     
     // 用于读取的缓冲区
-    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t HEADER_SIZE = FrameBuffer::HEADER_SIZE;
     std::vector<uint8_t> readBuffer_;
     std::vector<uint8_t> headerBuffer_;
-    bool isConnected_;
+    std::atomic<bool> isConnected_;  // IO线程写，任意线程的 send() 读
 };
 
 class AsioServer : public INetworkServer {
 public:
-    AsioServer();
+    static constexpr size_t DEFAULT_MAX_CLIENTS = 65536;
+
+    // ioThreads 为运行 io_context 的线程数，0 表示使用硬件并发数；
+    // maxClients 为客户端表容量，连接数达到上限后拒绝新连接；
+    // maxFrameSize 为客户端消息体的上限，超过时断开该连接
+    explicit AsioServer(size_t ioThreads = 0, size_t maxClients = DEFAULT_MAX_CLIENTS,
+                        size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
     ~AsioServer() override;
 
     bool start(uint16_t port) override;
     void stop() override;
     void broadcast(const std::vector<uint8_t>& data) override;
-    bool sendTo(const std::string& clientId, const std::vector<uint8_t>& data) override;
+    bool sendTo(ClientId clientId, const std::vector<uint8_t>& data,
+                SendPriority priority = SendPriority::Control) override;
+    bool sendFrame(ClientId clientId, SharedFrame frame,
+                   SendPriority priority = SendPriority::Control) override;
+    void multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame,
+                        SendPriority priority = SendPriority::Control) override;
+    uint32_t getMediaToken(ClientId clientId) override;
+    size_t maxClients() const override;
+    void disconnectClient(ClientId clientId) override;
 
-    void setClientConnectedCallback(std::function<void(const std::string&)> callback) override;
-    void setClientDisconnectedCallback(std::function<void(const std::string&)> callback) override;
-    void setMessageCallback(std::function<void(const std::string&, const std::vector<uint8_t>&)> callback) override;
+    void setClientConnectedCallback(ClientCallback callback) override;
+    void setClientDisconnectedCallback(ClientCallback callback) override;
+    void setMessageCallback(ClientMessageCallback callback) override;
 
 private:
+    // 单个客户端连接，所有回调通过 bind_executor 在该连接独立的 strand 上执行，
+    // 读写回调因此串行执行，不同连接之间可以并行。strand 以具体类型保存，
+    // 不作为 socket 的执行器，避免类型擦除的执行器在每次复制时分配内存
+    struct ClientSession {
+        ClientSession(boost::asio::ip::tcp::socket sock, boost::asio::io_context& context)
+            : strand(boost::asio::make_strand(context)), socket(std::move(sock)),
+              headerBuffer(FrameBuffer::HEADER_SIZE) {}
+
+        ClientId id = INVALID_HANDLE;
+        boost::asio::strand<boost::asio::io_context::executor_type> strand;
+        boost::asio::ip::tcp::socket socket;
+        std::vector<uint8_t> headerBuffer;
+        std::vector<uint8_t> readBuffer;  // 复用的消息体缓冲区，仅在strand上访问
+        OutboundQueue writeQueue;
+        std::vector<boost::asio::const_buffer> writeBuffers;  // 仅在strand上访问
+        std::atomic<bool> closing{false};  // 发送队列写完后关闭
+        uint32_t mediaToken = 0;  // 发布到 sessionTable_ 之前分配，之后不再修改
+
+        // UDP媒体通道状态，由 mediaMutex 保护
+        std::mutex mediaMutex;
+        boost::asio::ip::udp::endpoint mediaEndpoint;
+        std::chrono::steady_clock::time_point mediaLastSeen;  // 最近一次确认下行可用的时间
+
+        // 获取可用的UDP端点，超过 MEDIA_TIMEOUT 未收到保活包或媒体数据时返回 false
+        bool activeMediaEndpoint(boost::asio::ip::udp::endpoint& endpoint);
+    };
+
+    // UDP接收者，每个IO线程各有一个未完成的接收操作
+    struct DatagramReceiver {
+        std::array<uint8_t, MAX_DATAGRAM_SIZE> buffer;
+        boost::asio::ip::udp::endpoint sender;
+    };
+
     void doAccept();
-    void removeClient(const std::string& clientId);
-    void handleClientData(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
-                         const std::string& clientId,
-                         std::shared_ptr<std::vector<uint8_t>> headerBuffer);
+    void removeClient(ClientId clientId);
+    void doReadHeader(std::shared_ptr<ClientSession> session);
+    void doWrite(std::shared_ptr<ClientSession> session);
+    void handleClientData(std::shared_ptr<ClientSession> session);
+    std::shared_ptr<ClientSession> findClient(ClientId clientId);
+    uint32_t allocateMediaTokenLocked(ClientId clientId);
+    void doReceiveDatagram(std::shared_ptr<DatagramReceiver> receiver);
+    void handleDatagram(DatagramReceiver& receiver, size_t length);
+    void sendDatagram(const boost::asio::ip::udp::endpoint& endpoint, SharedFrame frame);
+    void sendDatagrams(const std::vector<boost::asio::ip::udp::endpoint>& endpoints, const SharedFrame& frame);
 
 private:
     boost::asio::io_context io_context_;
     boost::asio::ip::tcp::acceptor acceptor_;
-    std::thread io_thread_;
+    size_t ioThreadCount_;
+    size_t maxFrameSize_;
+    std::vector<std::thread> ioThreads_;
     
-    std::function<void(const std::string&)> clientConnectedCallback_;
-    std::function<void(const std::string&)> clientDisconnectedCallback_;
-    std::function<void(const std::string&, const std::vector<uint8_t>&)> messageCallback_;
+    ClientCallback clientConnectedCallback_;
+    ClientCallback clientDisconnectedCallback_;
+    ClientMessageCallback messageCallback_;
     
     std::mutex clientsMutex_;
-    std::unordered_map<std::string, std::shared_ptr<boost::asio::ip::tcp::socket>> clients_;
-    bool running_;
+    SlotMap<std::shared_ptr<ClientSession>> clients_;  // 客户端句柄 -> 会话
+    // 按槽位下标发布的会话，容量与 clients_ 相同；发送路径通过原子读取查找，不获取 clientsMutex_
+    std::vector<std::shared_ptr<ClientSession>> sessionTable_;
+    // 媒体令牌的低位为会话的槽位下标，其余位为随机校验位；收到数据报时按下标读取 sessionTable_
+    // 并核对完整令牌，不获取 clientsMutex_
+    uint32_t tokenIndexMask_;
+    std::mt19937 tokenGenerator_;  // 由 clientsMutex_ 保护
+    std::atomic<bool> running_;
+    
+    // UDP媒体通道，与TCP监听相同端口
+    boost::asio::ip::udp::socket udpSocket_;
+    UdpImpairment impairment_;
 };
 
 } // namespace voicechat 
\ No newline at end of file
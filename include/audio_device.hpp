@@ -1,13 +1,23 @@
 #pragma once
 
 #include "audio_interface.hpp"
+#include "spsc_ring.hpp"
 #include <portaudio.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <thread>
 
 namespace voicechat {
 
+class Counter;
+
+// 基于 PortAudio 的声卡设备。音频回调线程只与无锁环形缓冲交换数据，不加锁也不分配内存：
+// 采集时回调写入环形缓冲，由独立的采集线程取出已有的全部数据调用上层回调（编码和发送都在该线程），
+// 每次回调的长度不固定，由上层按编码帧长重新分块；
+// 播放时 write() 写入环形缓冲，回调取出数据，不足部分补静音
 class PortAudioDevice : public IAudioDevice {
 public:
     PortAudioDevice(bool isInput);
@@ -17,6 +27,8 @@ public:
     bool start() override;
     bool stop() override;
     void setCallback(AudioCallback callback) override;
+    // 只允许一个线程调用，环形缓冲满时丢弃放不下的部分
+    void write(const std::vector<float>& samples) override;
 
 private:
     // PortAudio回调函数
@@ -26,18 +38,63 @@ private:
                          PaStreamCallbackFlags statusFlags,
                          void* userData);
 
-    // 处理音频数据
-    void processAudio(const float* input, float* output, unsigned long frameCount);
+    // 处理音频数据，在音频回调线程中执行
+    void processAudio(const float* input, float* output, unsigned long frameCount,
+                      PaStreamCallbackFlags statusFlags);
+
+    // 采集线程：从环形缓冲取出整块数据交给上层回调
+    void captureLoop();
 
 private:
     bool isInput_;                    // 是否为输入设备
     int sampleRate_;                  // 采样率
     int channels_;                    // 通道数
     PaStream* stream_;               // PortAudio流
-    AudioCallback callback_;          // 音频回调函数
-    std::mutex mutex_;               // 互斥锁
-    std::vector<float> buffer_;      // 音频缓冲区
-    static constexpr size_t BUFFER_SIZE = 1024;  // 缓冲区大小
+    AudioCallback callback_;          // 音频回调函数，由 mutex_ 保护
+    std::mutex mutex_;               // 保护 callback_，音频回调线程不使用
+    std::unique_ptr<SpscRing<float>> ring_;  // 音频回调线程与采集/播放线程之间的缓冲
+    std::atomic<bool> running_;      // 采集线程运行标志
+    std::thread captureThread_;      // 采集线程
+    Counter& xruns_;                 // 溢出/欠载计数
+    static constexpr int RING_MILLISECONDS = 200;  // 环形缓冲容纳的时长
+    static constexpr std::chrono::milliseconds CAPTURE_POLL_INTERVAL{2};  // 采集线程的轮询间隔
+};
+
+// 基于 PortAudio 的全双工声卡设备：一个流同时采集和播放，两个方向使用同一个硬件时钟，流只打开一次。
+// 每次 PortAudio 回调中先以采集数据调用采集回调，再调用渲染回调填写同样长度的播放数据，
+// 不经过额外的线程和缓冲；两个回调都在实时音频回调中执行，只能读写无锁环形缓冲
+class PortAudioDuplexDevice : public IDuplexAudioDevice {
+public:
+    PortAudioDuplexDevice();
+    ~PortAudioDuplexDevice() override;
+
+    bool initialize(int sampleRate, int channels) override;
+    bool start() override;
+    bool stop() override;
+    void setCaptureCallback(CaptureCallback callback) override;
+    void setRenderCallback(RenderCallback callback) override;
+    bool realtimeCallbacks() const override { return true; }
+
+private:
+    static int paCallback(const void* inputBuffer, void* outputBuffer,
+                         unsigned long framesPerBuffer,
+                         const PaStreamCallbackTimeInfo* timeInfo,
+                         PaStreamCallbackFlags statusFlags,
+                         void* userData);
+
+    // 在音频回调线程中执行
+    void processAudio(const float* input, float* output, unsigned long frameCount,
+                      PaStreamCallbackFlags statusFlags);
+
+private:
+    int sampleRate_;
+    int channels_;
+    PaStream* stream_;
+    CaptureCallback captureCallback_;  // 只在流停止时设置，音频回调中直接调用
+    RenderCallback renderCallback_;    // 同上
+    bool running_;
+    Counter& captureXruns_;
+    Counter& playbackXruns_;
 };
 
-} // namespace voicechat 
\ No newline at end of file
+} // namespace voicechat
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <functional>
 #include <memory>
@@ -9,6 +10,12 @@ namespace voicechat {
 // 音频回调函数类型定义
 using AudioCallback = std::function<void(const std::vector<float>&)>;
 
+// 渲染回调：设备需要播放数据时调用，填满 output 中的 samples 个交错采样
+using RenderCallback = std::function<void(float* output, size_t samples)>;
+
+// 全双工设备的采集回调：input 中为 samples 个交错采样，只在回调期间有效
+using CaptureCallback = std::function<void(const float* input, size_t samples)>;
+
 // 音频设备接口
 class IAudioDevice {
 public:
@@ -25,6 +32,32 @@ public:
     
     // 设置音频回调
     virtual void setCallback(AudioCallback callback) = 0;
+    
+    // 写入待播放的音频数据，仅输出设备使用
+    virtual void write(const std::vector<float>& samples) = 0;
+};
+
+// 全双工音频设备：采集和播放使用同一个时钟。每采集到一块数据先调用采集回调，
+// 再通过渲染回调取得同样长度的播放数据，播放缓冲的深度和往返延迟保持不变
+class IDuplexAudioDevice {
+public:
+    virtual ~IDuplexAudioDevice() = default;
+
+    // 打开设备，之后可以多次启动和停止，设备销毁时关闭
+    virtual bool initialize(int sampleRate, int channels) = 0;
+
+    // 启动音频流
+    virtual bool start() = 0;
+
+    // 停止音频流，返回后不再调用回调
+    virtual bool stop() = 0;
+
+    // 设置采集回调和渲染回调，两者在同一个音频线程中执行，只能在流停止时设置
+    virtual void setCaptureCallback(CaptureCallback callback) = 0;
+    virtual void setRenderCallback(RenderCallback callback) = 0;
+
+    // 回调是否直接在实时音频回调中执行：是则回调不能阻塞、加锁或分配内存，编码等处理需交给其他线程
+    virtual bool realtimeCallbacks() const { return false; }
 };
 
 // 音频编解码器接口
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace voicechat {
+
+// 把任意长度的采集数据重新切分为固定长度的编码帧，使声卡缓冲大小与 Opus 帧长无关。
+// 每个样本最多复制一次：不足一帧的部分复制进内部缓冲凑满后输出，
+// 内部缓冲为空时输入中完整的帧直接以原指针交给回调，不复制
+class FrameBlocker {
+public:
+    // frameSamples 为每帧的交错采样数（每通道采样数 × 通道数）
+    explicit FrameBlocker(size_t frameSamples = 0) { setFrameSamples(frameSamples); }
+
+    // 修改帧长，丢弃尚未凑满的数据
+    void setFrameSamples(size_t frameSamples) {
+        frame_.assign(frameSamples, 0.0f);
+        filled_ = 0;
+    }
+
+    size_t frameSamples() const { return frame_.size(); }
+
+    // 尚未凑满一帧的采样数
+    size_t pending() const { return filled_; }
+
+    // 丢弃尚未凑满的数据，如停止采集时
+    void reset() { filled_ = 0; }
+
+    // 追加采集数据，每凑满一帧调用一次 onFrame(const float* frame, size_t frameSamples)
+    template <typename Callback>
+    void push(const float* samples, size_t count, Callback&& onFrame) {
+        const size_t frameSamples = frame_.size();
+        if (frameSamples == 0) {
+            return;
+        }
+        // 先补满上次剩下的半帧
+        if (filled_ > 0) {
+            size_t copied = std::min(count, frameSamples - filled_);
+            std::copy_n(samples, copied, frame_.data() + filled_);
+            filled_ += copied;
+            samples += copied;
+            count -= copied;
+            if (filled_ < frameSamples) {
+                return;
+            }
+            filled_ = 0;
+            onFrame(static_cast<const float*>(frame_.data()), frameSamples);
+        }
+        // 完整的帧直接输出
+        for (; count >= frameSamples; samples += frameSamples, count -= frameSamples) {
+            onFrame(samples, frameSamples);
+        }
+        // 剩余部分留待下次
+        std::copy_n(samples, count, frame_.data());
+        filled_ = count;
+    }
+
+private:
+    std::vector<float> frame_;
+    size_t filled_ = 0;
+};
+
+} // namespace voicechat
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <boost/intrusive_ptr.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace voicechat {
+
+class FramePool;
+
+// 不持有数据的只读字节视图，只在底层缓冲区有效期间可用，需要保留数据时由使用方复制
+class ByteSpan {
+public:
+    constexpr ByteSpan() = default;
+    constexpr ByteSpan(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+    ByteSpan(const std::vector<uint8_t>& bytes) : data_(bytes.data()), size_(bytes.size()) {}
+
+    constexpr const uint8_t* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr const uint8_t* begin() const { return data_; }
+    constexpr const uint8_t* end() const { return data_ + size_; }
+    constexpr uint8_t operator[](size_t index) const { return data_[index]; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 传输层数据帧：前 HEADER_SIZE 字节为长度头（4字节，小端序），
+// 调用者直接把消息体写入 body()，发送时不再复制或额外加头
+class FrameBuffer {
+public:
+    static constexpr size_t HEADER_SIZE = 4;
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    uint8_t* body() { return storage_.data() + HEADER_SIZE; }
+    const uint8_t* body() const { return storage_.data() + HEADER_SIZE; }
+    size_t bodySize() const { return storage_.size() - HEADER_SIZE; }
+
+    // 完整的帧（长度头 + 消息体）
+    const uint8_t* data() const { return storage_.data(); }
+    size_t size() const { return storage_.size(); }
+
+    // 调整消息体大小并更新长度头
+    void resize(size_t bodySize);
+
+    // 数据进入服务器的时间，用于统计从接收到写出完成的转发延迟；
+    // 未设置时为默认值，不参与统计
+    void setIngestTime(std::chrono::steady_clock::time_point time) { ingestTime_ = time; }
+    std::chrono::steady_clock::time_point ingestTime() const { return ingestTime_; }
+
+private:
+    friend class FramePool;
+    friend void intrusive_ptr_add_ref(const FrameBuffer* frame);
+    friend void intrusive_ptr_release(const FrameBuffer* frame);
+
+    explicit FrameBuffer(FramePool* pool);
+
+    std::vector<uint8_t> storage_;
+    std::chrono::steady_clock::time_point ingestTime_;
+    mutable std::atomic<uint32_t> refCount_;
+    FramePool* pool_;
+};
+
+// 可写的帧，由构造它的一方填充消息体
+using FramePtr = boost::intrusive_ptr<FrameBuffer>;
+// 只读的帧，可被多个发送队列同时引用而无需复制
+using SharedFrame = boost::intrusive_ptr<const FrameBuffer>;
+
+// 帧缓冲池：引用计数归零的帧回到池中复用，稳定运行时不再分配内存
+class FramePool {
+public:
+    // 池中最多缓存的帧数
+    static constexpr size_t MAX_CACHED_FRAMES = 4096;
+    // 超过该容量的缓冲区不回收
+    static constexpr size_t MAX_CACHED_CAPACITY = 64 * 1024;
+
+    ~FramePool();
+
+    // 进程内共享的帧缓冲池
+    static FramePool& instance();
+
+    // 获取消息体大小为 bodySize 的帧，长度头已写好
+    FramePtr acquire(size_t bodySize);
+
+private:
+    friend void intrusive_ptr_release(const FrameBuffer* frame);
+
+    void release(FrameBuffer* frame);
+
+    std::mutex mutex_;
+    std::vector<FrameBuffer*> freeFrames_;
+};
+
+// 复制数据生成一个帧
+FramePtr makeFrame(const uint8_t* data, size_t size);
+
+void intrusive_ptr_add_ref(const FrameBuffer* frame);
+void intrusive_ptr_release(const FrameBuffer* frame);
+
+} // namespace voicechat
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "audio_interface.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voicechat {
+
+// 无声卡设备的时钟：RealTime 按实际时长逐个周期处理，AsFastAsPossible 不等待，用于测量 CPU 开销
+enum class AudioClock {
+    RealTime,
+    AsFastAsPossible,
+};
+
+// 不依赖声卡的音频设备基类：后台线程按固定周期处理一个缓冲，
+// 输入设备每个周期读取一块数据并调用回调，输出设备每个周期取出一块待播放数据，不足时补静音。
+// 输入设备也是客户端播放的时钟，实时运行时数据读完后继续按周期输出静音。
+// 后台线程会调用派生类的虚函数，派生类需在析构函数中调用 stop()
+class HeadlessAudioDevice : public IAudioDevice {
+public:
+    // 每次回调的时长，与 Opus 帧长一致
+    static constexpr std::chrono::milliseconds DEFAULT_PERIOD{20};
+
+    HeadlessAudioDevice(bool isInput, AudioClock clock, std::chrono::microseconds period = DEFAULT_PERIOD);
+    ~HeadlessAudioDevice() override;
+
+    bool initialize(int sampleRate, int channels) override;
+    bool start() override;
+    bool stop() override;
+    void setCallback(AudioCallback callback) override;
+    void write(const std::vector<float>& samples) override;
+
+    // 输入数据已全部读完
+    bool finished() const { return finished_; }
+
+protected:
+    // 打开底层数据源，initialize 时调用
+    virtual bool open() { return true; }
+    // 输入设备：填充一个周期的交错采样，返回 false 表示数据已结束
+    virtual bool read(float* samples, size_t count);
+    // 输出设备：输出一个周期的交错采样
+    virtual void play(const float* samples, size_t count);
+    // 停止后刷新输出，如补全 WAV 文件头
+    virtual void flush() {}
+
+    int sampleRate_;
+    int channels_;
+
+private:
+    void run();
+
+    const bool isInput_;
+    const AudioClock clock_;
+    const std::chrono::microseconds period_;
+    size_t blockSamples_;  // 每个周期的交错采样数
+
+    std::atomic<bool> running_;
+    std::atomic<bool> finished_;
+    std::thread thread_;
+    std::mutex mutex_;
+    AudioCallback callback_;
+    std::vector<float> pending_;  // 输出设备待播放的数据，由 mutex_ 保护
+};
+
+// 从 WAV（16 位整数或 32 位浮点 PCM）或 raw 文件读取采集数据。
+// raw 文件为 16 位有符号小端 PCM，采样率和通道数与 initialize 的参数相同；
+// WAV 的采样率必须与设备一致，单声道和立体声之间自动转换
+class FileAudioSource : public HeadlessAudioDevice {
+public:
+    FileAudioSource(std::string path, AudioClock clock, bool loop = false);
+    ~FileAudioSource() override;
+
+protected:
+    bool open() override;
+    bool read(float* samples, size_t count) override;
+
+private:
+    bool readFrames(float* samples, size_t frames);
+
+    const std::string path_;
+    const bool loop_;
+    std::ifstream file_;
+    std::streampos dataStart_;
+    uint64_t dataBytes_;      // 数据块大小
+    uint64_t dataRemaining_;
+    int fileChannels_;
+    bool fileFloat_;          // 32 位浮点采样，否则为 16 位整数
+    std::vector<uint8_t> raw_;
+};
+
+// 把播放数据写入 WAV（16 位 PCM）或 raw 文件，文件类型由扩展名决定（.raw/.pcm 为 raw）
+class FileAudioSink : public HeadlessAudioDevice {
+public:
+    FileAudioSink(std::string path, AudioClock clock);
+    ~FileAudioSink() override;
+
+protected:
+    bool open() override;
+    void play(const float* samples, size_t count) override;
+    void flush() override;
+
+private:
+    const std::string path_;
+    const bool wav_;
+    std::ofstream file_;
+    uint64_t dataBytes_;
+    std::vector<uint8_t> converted_;
+};
+
+// 丢弃播放数据的输出设备
+class NullAudioSink : public HeadlessAudioDevice {
+public:
+    explicit NullAudioSink(AudioClock clock) : HeadlessAudioDevice(false, clock) {}
+};
+
+// 合成的采集信号：固定频率的正弦，或按音节起伏并有停顿的类语音噪声
+class SignalGenerator : public HeadlessAudioDevice {
+public:
+    enum class Signal {
+        Tone,
+        SpeechNoise,
+        Silence,
+    };
+
+    SignalGenerator(Signal signal, AudioClock clock, double frequency = 440.0, double amplitude = 0.3);
+    ~SignalGenerator() override;
+
+protected:
+    bool read(float* samples, size_t count) override;
+
+private:
+    float nextNoise();
+
+    const Signal signal_;
+    const double frequency_;
+    const double amplitude_;
+    uint64_t position_;  // 已生成的帧数
+    uint32_t noiseState_;
+    float lowpass_;
+};
+
+// 按描述创建音频设备，用于命令行和环境变量配置：
+//   portaudio            声卡（默认）
+//   tone[:频率]          正弦信号，仅输入
+//   noise                类语音噪声，仅输入
+//   silence              静音，仅输入
+//   file:路径            输入时读取、输出时写入 WAV 或 raw 文件
+//   null                 丢弃播放数据，仅输出
+// 描述无效时抛出 std::invalid_argument
+std::unique_ptr<IAudioDevice> createAudioDevice(const std::string& spec, bool isInput, AudioClock clock);
+
+// 按输入、输出设备的描述创建全双工设备：两者都是声卡时使用同一个 PortAudio 全双工流，
+// 否则把两个设备组合为 PairedAudioDevice，以输入设备为时钟
+std::unique_ptr<IDuplexAudioDevice> createDuplexAudioDevice(const std::string& inputSpec,
+                                                            const std::string& outputSpec, AudioClock clock);
+
+} // namespace voicechat
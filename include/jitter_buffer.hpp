@@ -0,0 +1,110 @@
+#pragma once
+
+#include "protocol.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace voicechat {
+
+// 抖动缓冲的统计
+struct JitterStats {
+    uint64_t packets = 0;    // 按时播放的包
+    uint64_t fec = 0;        // 用带内 FEC 恢复的帧
+    uint64_t concealed = 0;  // 由解码器丢包补偿的帧
+    uint64_t late = 0;       // 到达时已错过播放时间而丢弃的包
+    uint64_t discarded = 0;  // 缓冲过深时为降低延迟丢弃的包
+};
+
+// 单个发言者的自适应抖动缓冲：按序列号重排媒体包，按 RFC 3550 的方法用时间戳和到达时间估计抖动，
+// 目标延迟随抖动增减。播放端每个帧周期调用一次 pop()，缺失的帧交给解码器用带内 FEC 或丢包补偿填补；
+// 发言停止（连续约 100ms 没有数据）后回到缓冲状态，下次发言重新积累到目标延迟再开始播放。
+// 不是线程安全的，由调用方加锁
+class JitterBuffer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // pop() 的结果
+    enum class Playout {
+        Empty,    // 未在播放，输出静音
+        Packet,   // 正常解码 payload
+        Fec,      // 该帧丢失，payload 为下一包，用其中的带内 FEC 解码
+        Conceal,  // 该帧丢失，由解码器做丢包补偿
+    };
+
+    static constexpr std::chrono::milliseconds MIN_DELAY{20};
+    static constexpr std::chrono::milliseconds MAX_DELAY{400};
+
+    explicit JitterBuffer(std::chrono::milliseconds minDelay = MIN_DELAY,
+                          std::chrono::milliseconds maxDelay = MAX_DELAY);
+
+    // 放入一个收到的包
+    void push(const MediaHeader& header, ByteSpan payload, Clock::time_point arrival = Clock::now());
+
+    // 取出下一帧，payload 的容量会被复用
+    Playout pop(std::vector<uint8_t>& payload);
+
+    // 当前已缓冲的时长，即新到的包还要等待多久才会播放
+    std::chrono::milliseconds currentDelay() const;
+    // 根据抖动计算出的目标延迟
+    std::chrono::milliseconds targetDelay() const;
+    // 到达抖动的估计值（毫秒）
+    double jitterMillis() const;
+
+    bool playing() const { return playing_; }
+    const JitterStats& stats() const { return stats_; }
+
+private:
+    // 槽位数为2的幂，20ms 的帧可容纳 1.28 秒，大于最大延迟
+    static constexpr size_t SLOTS = 64;
+    // 连续补偿的最长时间，超过后认为发言已结束；按时长而不是帧数，与发送端的帧长无关
+    static constexpr double MAX_CONCEAL_MS = 100.0;
+    // 目标延迟为一帧加上抖动的倍数
+    static constexpr double JITTER_MULTIPLIER = 4.0;
+    // 判断缓冲过深或过浅的步长不小于该值：帧很短时发送端按采集周期成批发出，
+    // 缓冲深度在一个采集周期内的正常起伏不应触发调整
+    static constexpr double MIN_ADAPT_STEP_MS = 20.0;
+    // 缓冲过深时只丢弃电平不超过该值（约 -50 dBFS）的帧，避免截断语音
+    static constexpr uint8_t QUIET_LEVEL = 77;
+
+    struct Slot {
+        bool filled = false;
+        uint16_t sequence = 0;
+        uint8_t audioLevel = 0;
+        std::vector<uint8_t> payload;
+    };
+
+    Slot& slotFor(uint16_t sequence) { return slots_[sequence & (SLOTS - 1)]; }
+    bool has(uint16_t sequence) const;
+    void take(uint16_t sequence, std::vector<uint8_t>& payload);
+    void clear();
+    void updateJitter(const MediaHeader& header, Clock::time_point arrival);
+    double frameMillis() const;
+    double adaptStepMillis() const;
+    size_t bufferedFrames() const;
+
+    const double minDelayMs_;
+    const double maxDelayMs_;
+    std::array<Slot, SLOTS> slots_;
+    size_t buffered_;
+    bool playing_;
+    bool started_;             // 是否已播放过，为真时 playedSequence_ 有效
+    uint16_t playedSequence_;  // 已播放到的位置，早于它的包都已迟到
+    uint16_t nextSequence_;    // 下一个要播放的序列号，未播放时为缓冲中最早的包
+    uint16_t highestSequence_; // 缓冲中最新的包
+    int concealRun_;           // 连续补偿的帧数
+
+    uint32_t frameSamples_;    // 每帧的采样数，由相邻包的时间戳推算
+    bool hasLast_;
+    uint16_t lastSequence_;
+    uint32_t lastTimestamp_;
+    double lastArrival_;       // 上一个包的到达时间（采样数，相对 epoch_）
+    double jitter_;            // RFC 3550 的到达抖动（采样数）
+    double targetMs_;
+    Clock::time_point epoch_;
+
+    JitterStats stats_;
+};
+
+} // namespace voicechat
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// 编译期日志级别：低于该级别的日志语句整体被编译器删除
+// 0=trace 1=debug 2=info 3=warn 4=error 5=off，由 CMake 的 VOICECHAT_LOG_MIN_LEVEL 设置
+#ifndef VOICECHAT_LOG_MIN_LEVEL
+#define VOICECHAT_LOG_MIN_LEVEL 1
+#endif
+
+namespace voicechat {
+
+enum class LogLevel : uint8_t {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5,
+};
+
+// 异步日志：每个线程把格式化后的日志写入自己的无锁单生产者环形缓冲，
+// 后台线程定期取出并输出，调用线程不会因 stdout 的锁或 flush 阻塞。
+// 缓冲区满时丢弃新日志并计数，不会阻塞热路径
+class Logger {
+public:
+    static constexpr size_t MAX_MESSAGE_SIZE = 240;
+    static constexpr size_t RING_CAPACITY = 1024;  // 每个线程的日志条数，需为2的幂
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{10};
+
+    static Logger& instance();
+
+    // 运行期日志级别，默认 Info，可由环境变量 VOICECHAT_LOG_LEVEL 设置
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >= static_cast<uint8_t>(level_.load(std::memory_order_relaxed));
+    }
+
+    // 同步输出所有已缓冲的日志，程序退出前调用
+    void flush();
+
+    // 因缓冲区满而丢弃的日志条数
+    uint64_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+    ~Logger();
+
+private:
+    friend class LogLine;
+
+    struct Entry {
+        std::chrono::system_clock::time_point time;
+        LogLevel level;
+        uint32_t length;
+        char text[MAX_MESSAGE_SIZE];
+    };
+
+    // 单生产者单消费者环形缓冲：生产者是所属线程，消费者是后台线程
+    struct Ring {
+        Entry entries[RING_CAPACITY];
+        std::atomic<uint64_t> head{0};  // 下一个写入位置，只由生产者修改
+        std::atomic<uint64_t> tail{0};  // 下一个读取位置，只由消费者修改
+        std::atomic<bool> producerAlive{true};
+
+        Entry* reserve();
+        void commit();
+    };
+
+    Logger();
+    Ring* threadRing();
+    void run();
+
+    std::atomic<LogLevel> level_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex ringsMutex_;  // 只在线程注册和后台线程遍历时获取
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    std::mutex flushMutex_;
+    std::condition_variable flushCondition_;
+    bool stopping_;
+    std::thread flusher_;
+};
+
+// 单条日志：构造时在当前线程的环形缓冲中预留一个条目，
+// 流式输出直接写入该条目（超出 MAX_MESSAGE_SIZE 的部分被截断），析构时提交
+class LogLine {
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    std::ostream& stream();
+
+private:
+    Logger::Ring* ring_;
+    Logger::Entry* entry_;
+};
+
+} // namespace voicechat
+
+// 日志宏：低于编译期级别时整条语句被删除；运行期关闭时只有一次原子读取和分支，
+// 参数表达式不会被求值。用法：VC_LOG_INFO("客户端已连接: " << clientId);
+#define VC_LOG(level, expr)                                                           \
+    do {                                                                              \
+        if (static_cast<int>(level) >= VOICECHAT_LOG_MIN_LEVEL &&                     \
+            ::voicechat::Logger::instance().enabled(level)) {                         \
+            ::voicechat::LogLine vcLogLine(level);                                    \
+            vcLogLine.stream() << expr;                                               \
+        }                                                                             \
+    } while (0)
+
+#define VC_LOG_TRACE(expr) VC_LOG(::voicechat::LogLevel::Trace, expr)
+#define VC_LOG_DEBUG(expr) VC_LOG(::voicechat::LogLevel::Debug, expr)
+#define VC_LOG_INFO(expr) VC_LOG(::voicechat::LogLevel::Info, expr)
+#define VC_LOG_WARN(expr) VC_LOG(::voicechat::LogLevel::Warn, expr)
+#define VC_LOG_ERROR(expr) VC_LOG(::voicechat::LogLevel::Error, expr)
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace voicechat {
+
+// 指标分片数：每个线程固定使用其中一个分片，热路径上的记录只是一次无竞争的原子加，不加锁
+constexpr size_t METRIC_SHARDS = 16;
+
+// 当前线程使用的分片下标，线程首次记录指标时轮流分配
+size_t metricShard();
+
+// 单调递增计数器
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        shards_[metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// 可增可减的瞬时值
+class Gauge {
+public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// 合并各分片后的直方图数据
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    std::vector<uint64_t> buckets;
+
+    // 分位数，q 取 [0, 1]，返回值的相对误差不超过约 6%
+    uint64_t quantile(double q) const;
+};
+
+// HDR 风格的对数-线性直方图：每个2的幂区间再细分为 16 个子桶，
+// 可记录 0 到 2^48 的整数值（如纳秒、字节），记录时只有原子加
+class Histogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32_t MAX_EXPONENT = 47;
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    void record(uint64_t value);
+    HistogramSnapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(size_t index);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// 进程内的指标注册表。注册（通常在启动时）需要加锁并返回引用，
+// 调用方保存该引用，之后的记录不再经过注册表
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    // 同名且标签相同的指标只注册一次；labels 形如 transport="udp"
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    // scale 为输出时的单位换算，如记录纳秒、以秒输出时为 1e-9
+    Histogram& histogram(const std::string& name, const std::string& help, double scale = 1.0,
+                         const std::string& labels = "");
+
+    // Prometheus 文本格式，直方图以 summary 输出分位数
+    std::string renderPrometheus() const;
+
+    // 便于阅读的摘要，用于定期输出
+    std::string renderSummary() const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        double scale = 1.0;
+        std::vector<Series> series;
+    };
+
+    Series& findOrCreate(const std::string& name, const std::string& help, Type type,
+                         const std::string& labels, double scale);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;  // 按名称排序输出
+};
+
+} // namespace voicechat
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "metrics.hpp"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace voicechat {
+
+// 本地指标查询端口：任何 HTTP GET 都返回 Prometheus 文本格式的全部指标。
+// 在独立的线程上运行，不占用语音服务器的IO线程
+class MetricsServer {
+public:
+    explicit MetricsServer(MetricsRegistry& registry = MetricsRegistry::instance());
+    ~MetricsServer();
+
+    // 只监听本机地址，port 为 0 时由系统分配
+    bool start(uint16_t port);
+    void stop();
+
+    // 实际监听的端口，未启动时为 0
+    uint16_t port() const;
+
+private:
+    void doAccept();
+
+    MetricsRegistry& registry_;
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+};
+
+} // namespace voicechat
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOICECHAT_MIX_SSE2 1
+#endif
+
+namespace voicechat {
+
+// PCM混音内核：样本为 [-1, 1] 范围的 float，服务器端和客户端混音共用。
+// 有 SSE2 时每次处理4个样本，尾部和其他平台使用标量实现
+
+// dst[i] += src[i]
+inline void mixAccumulate(float* dst, const float* src, size_t count) {
+    size_t i = 0;
+#ifdef VOICECHAT_MIX_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i));
+        _mm_storeu_ps(dst + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+// 减去自己声音后的混音（mix-minus）：dst[i] = mix[i] - own[i]
+inline void mixMinus(float* dst, const float* mix, const float* own, size_t count) {
+    size_t i = 0;
+#ifdef VOICECHAT_MIX_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(mix + i), _mm_loadu_ps(own + i));
+        _mm_storeu_ps(dst + i, diff);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = mix[i] - own[i];
+    }
+}
+
+// 把样本限制在 [-1, 1]，防止多路叠加后溢出削波失真
+inline void mixClamp(float* samples, size_t count) {
+    size_t i = 0;
+#ifdef VOICECHAT_MIX_SSE2
+    const __m128 upper = _mm_set1_ps(1.0f);
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_loadu_ps(samples + i);
+        _mm_storeu_ps(samples + i, _mm_max_ps(lower, _mm_min_ps(upper, value)));
+    }
+#endif
+    for (; i < count; ++i) {
+        float value = samples[i];
+        samples[i] = value > 1.0f ? 1.0f : (value < -1.0f ? -1.0f : value);
+    }
+}
+
+// 带增益的叠加：dst[i] += src[i] * gain
+inline void mixAccumulateGain(float* dst, const float* src, float gain, size_t count) {
+    size_t i = 0;
+#ifdef VOICECHAT_MIX_SSE2
+    const __m128 scale = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), scale));
+        _mm_storeu_ps(dst + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+// 软削波的拐点：幅度不超过该值的样本保持不变
+constexpr float SOFT_CLIP_KNEE = 0.75f;
+
+// 软削波：超过拐点的部分用 tanh 的有理近似 u(27+u²)/(27+9u²) 平滑压缩到 [-1, 1]，
+// 比直接截断的谐波失真小，用于客户端多路叠加后的输出
+inline void mixSoftClip(float* samples, size_t count) {
+    constexpr float range = 1.0f - SOFT_CLIP_KNEE;
+    size_t i = 0;
+#ifdef VOICECHAT_MIX_SSE2
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 knee = _mm_set1_ps(SOFT_CLIP_KNEE);
+    const __m128 scale = _mm_set1_ps(1.0f / range);
+    const __m128 width = _mm_set1_ps(range);
+    const __m128 limit = _mm_set1_ps(3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 c27 = _mm_set1_ps(27.0f);
+    const __m128 c9 = _mm_set1_ps(9.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_loadu_ps(samples + i);
+        __m128 sign = _mm_and_ps(value, signMask);
+        __m128 magnitude = _mm_andnot_ps(signMask, value);
+        __m128 u = _mm_min_ps(limit, _mm_mul_ps(_mm_max_ps(zero, _mm_sub_ps(magnitude, knee)), scale));
+        __m128 u2 = _mm_mul_ps(u, u);
+        __m128 t = _mm_div_ps(_mm_mul_ps(u, _mm_add_ps(c27, u2)), _mm_add_ps(c27, _mm_mul_ps(c9, u2)));
+        __m128 result = _mm_add_ps(_mm_min_ps(magnitude, knee), _mm_mul_ps(width, t));
+        _mm_storeu_ps(samples + i, _mm_or_ps(result, sign));
+    }
+#endif
+    for (; i < count; ++i) {
+        float value = samples[i];
+        float magnitude = value < 0.0f ? -value : value;
+        if (magnitude <= SOFT_CLIP_KNEE) {
+            continue;
+        }
+        float u = (magnitude - SOFT_CLIP_KNEE) / range;
+        u = u > 3.0f ? 3.0f : u;
+        float t = u * (27.0f + u * u) / (27.0f + 9.0f * u * u);
+        float result = SOFT_CLIP_KNEE + range * t;
+        samples[i] = value < 0.0f ? -result : result;
+    }
+}
+
+// 样本平方和，用于计算电平
+inline float sumOfSquares(const float* samples, size_t count) {
+    size_t i = 0;
+    float sum = 0.0f;
+#ifdef VOICECHAT_MIX_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_loadu_ps(samples + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(value, value));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        sum += samples[i] * samples[i];
+    }
+    return sum;
+}
+
+} // namespace voicechat
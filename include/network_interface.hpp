@@ -1,5 +1,9 @@
 #pragma once
 
+#include "frame_buffer.hpp"
+#include "slot_map.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <functional>
 #include <memory>
@@ -7,10 +11,26 @@
 
 namespace voicechat {
 
+// 发送优先级：对端积压时媒体数据可以被丢弃，控制消息不会被丢弃
+enum class SendPriority {
+    Control,
+    Media
+};
+
+// 服务器端的客户端句柄，由传输层在接受连接时分配
+using ClientId = Handle;
+
+// 服务器接受的单条消息体的默认上限，远大于任何合法的客户端消息；
+// 长度头超过上限的连接被断开，不会按不可信的长度分配内存
+constexpr size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024;
+
 // 网络事件回调类型定义
 using MessageCallback = std::function<void(const std::vector<uint8_t>&)>;
 using ErrorCallback = std::function<void(const std::string&)>;
 using ConnectionCallback = std::function<void()>;
+using ClientCallback = std::function<void(ClientId)>;
+// 消息数据只在回调执行期间有效
+using ClientMessageCallback = std::function<void(ClientId, ByteSpan)>;
 
 // 网络连接接口
 class INetworkConnection {
@@ -24,7 +44,14 @@ public:
     virtual void disconnect() = 0;
     
     // 发送数据
-    virtual bool send(const std::vector<uint8_t>& data) = 0;
+    virtual bool send(const std::vector<uint8_t>& data, SendPriority priority = SendPriority::Control) = 0;
+    
+    // 发送已分帧的数据，帧头由 FrameBuffer 预留，发送时不再复制
+    virtual bool send(SharedFrame frame, SendPriority priority = SendPriority::Control) = 0;
+    
+    // 启用UDP媒体通道，token 为服务器分配的媒体会话令牌；
+    // 启用后媒体数据优先走UDP，UDP不通时自动回退到TCP
+    virtual bool enableMedia(uint32_t token) = 0;
     
     // 设置回调
     virtual void setMessageCallback(MessageCallback callback) = 0;
@@ -51,12 +78,30 @@ public:
     virtual void broadcast(const std::vector<uint8_t>& data) = 0;
     
     // 发送消息给特定客户端
-    virtual bool sendTo(const std::string& clientId, const std::vector<uint8_t>& data) = 0;
+    virtual bool sendTo(ClientId clientId, const std::vector<uint8_t>& data,
+                        SendPriority priority = SendPriority::Control) = 0;
+    
+    // 发送已分帧的数据，同一帧可发送给多个客户端
+    virtual bool sendFrame(ClientId clientId, SharedFrame frame,
+                           SendPriority priority = SendPriority::Control) = 0;
+    
+    // 发送同一帧给多个客户端，使用UDP媒体通道的接收者批量发送
+    virtual void multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame,
+                                SendPriority priority = SendPriority::Control) = 0;
+    
+    // 获取客户端的UDP媒体会话令牌，客户端不存在时返回0
+    virtual uint32_t getMediaToken(ClientId clientId) = 0;
+    
+    // 客户端表容量，分配的客户端句柄的槽位下标都小于该值
+    virtual size_t maxClients() const = 0;
+    
+    // 断开指定客户端，已排队的数据发送完毕后关闭连接
+    virtual void disconnectClient(ClientId clientId) = 0;
     
     // 设置回调
-    virtual void setClientConnectedCallback(std::function<void(const std::string&)> callback) = 0;
-    virtual void setClientDisconnectedCallback(std::function<void(const std::string&)> callback) = 0;
-    virtual void setMessageCallback(std::function<void(const std::string&, const std::vector<uint8_t>&)> callback) = 0;
+    virtual void setClientConnectedCallback(ClientCallback callback) = 0;
+    virtual void setClientDisconnectedCallback(ClientCallback callback) = 0;
+    virtual void setMessageCallback(ClientMessageCallback callback) = 0;
 };
 
 } // namespace voicechat 
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "audio_interface.hpp"
 #include <opus/opus.h>
+#include <chrono>
 #include <vector>
 #include <memory>
 
@@ -13,19 +14,50 @@ public:
     ~OpusCodec() override;
 
     bool initialize(int sampleRate, int channels) override;
+
+    // 只创建解码器，用于只接收的场景（如客户端每个远端发言者一个解码器）
+    bool initializeDecoder(int sampleRate, int channels);
+
+    // 清除解码器状态，供另一路音频流复用
+    void resetDecoder();
+
+    // 设置编码帧长，Opus 支持 2.5、5、10、20、40、60ms，其他值返回 false；默认 20ms。
+    // 帧越短延迟越低，但包头开销和包数随之增加
+    bool setFrameDuration(std::chrono::microseconds duration);
+    static bool isValidFrameDuration(std::chrono::microseconds duration);
+
+    // 每帧每通道的采样数
+    int frameSize() const;
+
+    // 编码一帧，samples 必须等于 frameSize() × 通道数，否则返回空
     std::vector<uint8_t> encode(const std::vector<float>& pcmData) override;
+    std::vector<uint8_t> encode(const float* pcm, size_t samples);
+
+    // 解码任意帧长（最长 120ms）的包
     std::vector<float> decode(const std::vector<uint8_t>& encodedData) override;
 
+    // 上一帧丢失时，用下一包携带的带内 FEC 数据恢复丢失的那一帧
+    std::vector<float> decodeFec(const std::vector<uint8_t>& nextPacket);
+
+    // 丢包补偿：没有任何数据时根据解码器状态外推一帧，帧长与上一个解码的包相同
+    std::vector<float> conceal();
+
 private:
+    std::vector<float> decodeFrame(const uint8_t* data, size_t size, bool fec);
+
     // Opus编码器和解码器
     OpusEncoder* encoder_;
     OpusDecoder* decoder_;
     
     int sampleRate_;
     int channels_;
+    std::chrono::microseconds frameDuration_;
+    int lastDecodedSize_;  // 上一个包解码出的每通道采样数，用于丢包补偿和 FEC
     
-    // Opus推荐的帧大小（以采样点为单位，20ms @ 48kHz = 960）
-    static constexpr int FRAME_SIZE = 960;
+    // 默认帧长（20ms @ 48kHz = 960 个采样点）
+    static constexpr std::chrono::microseconds DEFAULT_FRAME_DURATION{20000};
+    // 单个包最长 120ms
+    static constexpr int MAX_DECODE_MILLISECONDS = 120;
     // 最大数据包大小
     static constexpr int MAX_PACKET_SIZE = 1275;
 };
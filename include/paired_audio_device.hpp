@@ -0,0 +1,36 @@
+#pragma once
+
+#include "audio_interface.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace voicechat {
+
+// 由独立的输入设备和输出设备组成的全双工设备，用于无声卡的环境或输入输出不是同一个声卡时。
+// 以输入设备为时钟：每采集到一块数据先调用采集回调，再渲染同样长度的数据写入输出设备
+class PairedAudioDevice : public IDuplexAudioDevice {
+public:
+    PairedAudioDevice(std::unique_ptr<IAudioDevice> captureDevice, std::unique_ptr<IAudioDevice> playbackDevice);
+    ~PairedAudioDevice() override;
+
+    bool initialize(int sampleRate, int channels) override;
+    bool start() override;
+    bool stop() override;
+    void setCaptureCallback(CaptureCallback callback) override;
+    void setRenderCallback(RenderCallback callback) override;
+
+private:
+    // 在输入设备的采集线程中执行
+    void onCapture(const std::vector<float>& samples);
+
+    std::unique_ptr<IAudioDevice> captureDevice_;
+    std::unique_ptr<IAudioDevice> playbackDevice_;
+    std::mutex mutex_;
+    CaptureCallback captureCallback_;
+    RenderCallback renderCallback_;
+    std::vector<float> rendered_;  // 渲染缓冲，只在采集线程使用
+    bool initialized_;
+};
+
+} // namespace voicechat
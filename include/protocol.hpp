@@ -0,0 +1,120 @@
+#pragma once
+
+#include "voice_message.pb.h"
+#include "frame_buffer.hpp"
+#include <google/protobuf/arena.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace voicechat {
+
+// 当前协议版本，客户端在每条控制消息中携带
+constexpr uint32_t PROTOCOL_VERSION = 3;
+
+// 消息类型字节的长度
+constexpr size_t FRAME_TYPE_SIZE = 1;
+
+// 音频电平的取值范围：127 + dBFS，0 表示静音
+constexpr uint32_t MAX_AUDIO_LEVEL = 127;
+
+// 根据一帧PCM的均方根计算音频电平，由发送端在编码前填入媒体包头
+uint32_t audioLevelOf(const float* samples, size_t count);
+
+// Opus 的 DTX/静音帧只有TOC字节（不超过2字节），无需解码即可判断
+inline bool isOpusSilence(ByteSpan payload) {
+    return payload.size() <= 2;
+}
+
+// 媒体包：类型字节 FRAME_MEDIA 之后是 12 字节的定长头（网络字节序，布局参照RTP），
+// 其后直到消息末尾都是 Opus 数据。服务器只读取包头即可转发
+//   0      版本（高2位），其余位保留为0
+//   1      语音电平 0-127（低7位），服务器据此选择转发的发言者
+//   2-3    序列号，每包加1，回绕
+//   4-7    采样时钟时间戳（48kHz），每包增加该包的采样数
+//   8-11   源ID，服务器在客户端进入房间时分配
+constexpr size_t MEDIA_HEADER_SIZE = 12;
+constexpr uint8_t MEDIA_VERSION = 1;
+constexpr uint32_t MEDIA_CLOCK_RATE = 48000;
+// 服务器混音流使用的源ID，不会分配给客户端：MIXER_SOURCE_ID 为发给听众的完整混音，
+// MIXER_MINUS_SOURCE_ID 为发给发言者的减去自己声音的混音。两者的序列号、时间戳和编码器状态互不相关，
+// 使用不同的源ID，接收方才能为它们分别维持抖动缓冲和解码器
+constexpr uint32_t MIXER_SOURCE_ID = 0;
+constexpr uint32_t MIXER_MINUS_SOURCE_ID = 1;
+
+inline bool isMixerSourceId(uint32_t sourceId) {
+    return sourceId == MIXER_SOURCE_ID || sourceId == MIXER_MINUS_SOURCE_ID;
+}
+
+struct MediaHeader {
+    uint8_t audioLevel = 0;
+    uint16_t sequence = 0;
+    uint32_t timestamp = 0;
+    uint32_t sourceId = 0;
+};
+
+// 媒体包的只读视图，payload 指向接收缓冲区，只在缓冲区有效期间可用
+struct MediaView {
+    MediaHeader header;
+    ByteSpan payload;
+};
+
+// 解析媒体包中类型字节之后的部分，长度不足或版本不符时返回 false
+bool parseMediaPacket(const uint8_t* data, size_t size, MediaView& view);
+
+// 生成完整的媒体帧：长度头 + 类型字节 + 媒体头 + Opus 数据
+FramePtr encodeMediaFrame(const MediaHeader& header, const uint8_t* payload, size_t size);
+
+// 节点间转发的媒体包：类型字节 FRAME_BRIDGE_MEDIA 之后是4字节的房间通道号（网络字节序），
+// 通道号由接收节点在房间列表中公布，其后是与 FRAME_MEDIA 相同的媒体包
+constexpr size_t BRIDGE_CHANNEL_SIZE = 4;
+
+// 把媒体包（类型字节之后的部分）封装为发往对端节点的帧
+FramePtr encodeBridgeMediaFrame(uint32_t channel, const uint8_t* packet, size_t size);
+
+// 解析节点间媒体包中类型字节之后的部分
+bool parseBridgeMedia(const uint8_t* data, size_t size, uint32_t& channel, MediaView& view);
+
+// 按线程复用的 protobuf arena，用于解析控制消息和服务器响应：
+// 消息及其字符串字段都分配在 arena 上，作用域结束后失效，按批整体释放；
+// 初始块由线程持有，稳定运行时解析不调用 malloc
+class ParseArena {
+public:
+    static constexpr size_t INITIAL_BLOCK_SIZE = 8 * 1024;
+    // 最外层作用域结束时，已用空间超过该值才释放
+    static constexpr size_t RESET_THRESHOLD = INITIAL_BLOCK_SIZE / 2;
+
+    // 一次消息处理的作用域，其中创建的消息在作用域结束后失效
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        template <typename Message>
+        Message* create() {
+            return google::protobuf::Arena::CreateMessage<Message>(&owner_.arena_);
+        }
+
+    private:
+        ParseArena& owner_;
+    };
+
+private:
+    ParseArena();
+    static ParseArena& local();
+
+    alignas(16) char initialBlock_[INITIAL_BLOCK_SIZE];
+    google::protobuf::Arena arena_;
+    int depth_;
+};
+
+// 把消息直接序列化进帧缓冲：长度头 + 1字节类型 + protobuf数据
+FramePtr encodeFrame(FrameType type, const google::protobuf::MessageLite& message);
+
+// 读取消息体的类型字节，无法识别时返回 FRAME_UNKNOWN
+FrameType frameTypeOf(const uint8_t* data, size_t size);
+
+} // namespace voicechat
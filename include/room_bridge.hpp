@@ -0,0 +1,112 @@
+#pragma once
+
+#include "asio_network.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voicechat {
+
+// 桥接配置中的一个对端节点
+struct BridgePeer {
+    std::string nodeId;
+    std::string host;
+    uint16_t port = 0;
+};
+
+// 解析以逗号分隔的 "节点ID@主机:端口" 列表，格式错误时抛出 std::invalid_argument
+std::vector<BridgePeer> parseBridgePeers(const std::string& spec);
+
+// 本节点有成员的一个房间，channel 为本节点分配的房间通道号
+struct BridgeRoom {
+    std::string name;
+    uint32_t channel;
+};
+using BridgeRoomList = std::vector<BridgeRoom>;
+
+// 到一个对端节点的出站链路，断开后由 RoomBridge 重新连接；发送可在任意线程调用
+class BridgeLink {
+public:
+    explicit BridgeLink(BridgePeer peer);
+
+    const std::string& nodeId() const { return peer_.nodeId; }
+
+    // 链路未连接时丢弃数据并返回 false
+    bool send(const SharedFrame& frame, SendPriority priority);
+    bool isConnected() const;
+
+private:
+    friend class RoomBridge;
+
+    const BridgePeer peer_;
+    std::shared_ptr<AsioConnection> connection_;  // start() 时创建，重连复用同一个对象；stop() 时通过 std::atomic_store 清空
+    std::atomic<bool> needsHello_;                // 新连接建立后需要先发送 HELLO 和房间列表
+    std::chrono::steady_clock::time_point lastAttempt_;  // 只在链路线程访问
+};
+
+// 房间跨节点转发的一个目标：对端链路及该房间在对端的通道号
+struct BridgeTarget {
+    std::shared_ptr<BridgeLink> link;
+    uint32_t channel;
+};
+using BridgeTargets = std::vector<BridgeTarget>;
+
+// 节点间桥接的链路管理。每个节点主动连接配置中的所有其他节点（全连接），
+// 只在自己发起的链路上发送 HELLO、本节点有成员的房间列表以及本地发言者的媒体包；
+// 对端把收到的媒体包只发给自己的本地成员，不再转发给其他节点，每个包在每条链路上只传一次。
+// 所有链路共用一个 io_context 和链路线程，地址解析和连接都是异步的，某个对端不可达不会拖慢其他链路
+class RoomBridge {
+public:
+    // 链路维护周期
+    static constexpr std::chrono::milliseconds TICK_INTERVAL{100};
+    // 连接失败或断开后重试的间隔，未完成的连接尝试（包括地址解析）超过该时间也被放弃并重试
+    static constexpr std::chrono::seconds RECONNECT_INTERVAL{2};
+    // 房间列表没有变化时也定期重发，对端据此纠正丢失的状态
+    static constexpr std::chrono::seconds ANNOUNCE_INTERVAL{5};
+    // 每条 ROOMS 消息最多携带的房间数，避免超过对端的消息大小上限
+    static constexpr size_t ROOMS_PER_MESSAGE = 512;
+
+    // 返回本节点当前有成员的房间列表；列表未变化时返回同一个对象，据此判断是否需要发送
+    using RoomListProvider = std::function<std::shared_ptr<const BridgeRoomList>()>;
+
+    // secret 为所有节点共用的密钥，随 HELLO 发送，为空时只按节点ID校验对端
+    RoomBridge(std::string nodeId, std::vector<BridgePeer> peers, std::string secret, RoomListProvider provider);
+    ~RoomBridge();
+
+    void start();
+    void stop();
+
+    const std::string& nodeId() const { return nodeId_; }
+
+    // 到指定节点的出站链路，未配置该节点时返回 nullptr
+    std::shared_ptr<BridgeLink> link(const std::string& nodeId) const;
+
+    // 校验入站链路的 HELLO：节点必须在配置的对端列表中，且密钥与本节点一致
+    bool authenticate(const std::string& nodeId, const std::string& secret) const;
+
+private:
+    void scheduleTick();
+    void tick();
+    void createConnection(BridgeLink& link);
+    void announce(BridgeLink& link, const BridgeRoomList& rooms);
+
+    const std::string nodeId_;
+    const std::string secret_;
+    std::vector<std::shared_ptr<BridgeLink>> links_;  // 构造后不再变化
+    RoomListProvider provider_;
+    std::atomic<bool> running_;
+
+    // 链路线程运行 io_context：维护定时器和所有链路的连接回调都在该线程上执行
+    boost::asio::io_context io_context_;
+    boost::asio::steady_timer timer_;
+    std::thread thread_;
+    std::shared_ptr<const BridgeRoomList> announced_;  // 最近一次发送的房间列表，只在链路线程访问
+    std::chrono::steady_clock::time_point lastAnnounce_;
+};
+
+} // namespace voicechat
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "network_interface.hpp"
+#include "opus_codec.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace voicechat {
+
+// 混音周期，与客户端的 Opus 帧长一致（20ms @ 48kHz = 960 个采样点）
+constexpr std::chrono::milliseconds MIX_INTERVAL(20);
+constexpr size_t MIX_FRAME_SAMPLES = 960;
+constexpr int MIX_SAMPLE_RATE = 48000;
+
+// 一次混音输出：同一帧发给 recipients 中的所有客户端
+struct MixOutput {
+    std::vector<ClientId> recipients;
+    SharedFrame frame;
+};
+
+// 混音统计，耗时为混音线程处理该房间的时间（解码、混音、编码）
+struct MixerStats {
+    uint64_t ticks = 0;
+    uint64_t totalNanos = 0;
+    uint64_t maxNanos = 0;
+    size_t speakers = 0;  // 最近一个周期参与混音的发言者数
+
+    // 平均每个周期的耗时占周期长度的比例
+    double load() const {
+        if (ticks == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(totalNanos) / ticks /
+               std::chrono::duration_cast<std::chrono::nanoseconds>(MIX_INTERVAL).count();
+    }
+};
+
+// 服务器端混音（MCU）：每个发言者使用独立的解码器状态，
+// 每个周期把所有发言者的PCM相加，发言者收到减去自己声音的混音，
+// 其余听众共享同一路完整混音，房间内每个客户端同一时刻只接收一路音频流。
+// 成员在发言和收听之间切换时收到的是两条流（源ID分别为 MIXER_MINUS_SOURCE_ID 和 MIXER_SOURCE_ID），
+// 每条流的序列号、时间戳和编码器状态各自连续
+class RoomMixer {
+public:
+    // 每个发言者最多积压的音频（以混音周期计），超过时丢弃最旧的采样
+    static constexpr size_t MAX_QUEUED_FRAMES = 3;
+    // 交接队列中每个发言者最多缓存的包数，按 Opus 最短的 2.5ms 帧折算
+    static constexpr size_t MAX_QUEUED_PACKETS = MAX_QUEUED_FRAMES * MIX_FRAME_SAMPLES / 120;
+
+    explicit RoomMixer(std::string roomName);
+
+    // 提交发言者的一帧 Opus 数据，可在任意IO线程调用
+    void submit(ClientId speaker, ByteSpan payload);
+
+    // 发言者离开房间，释放其编解码器状态
+    void removeSpeaker(ClientId speaker);
+
+    // 执行一个混音周期，members 为房间当前成员；只在混音线程调用
+    void tick(const std::vector<ClientId>& members, std::vector<MixOutput>& outputs);
+
+    MixerStats stats() const;
+
+    const std::string& roomName() const { return roomName_; }
+
+private:
+    struct Speaker {
+        OpusCodec codec;  // 解码该发言者的音频，并编码发给他的 mix-minus
+        std::vector<float> decoded;  // 已解码、尚未混音的采样；客户端帧长可以不是 20ms
+        std::vector<float> pcm;      // 本周期参与混音的一帧
+        uint32_t sequence = 0;
+        bool active = false;  // 本周期是否有数据
+    };
+
+    Speaker* findOrCreateSpeaker(ClientId speaker);
+    SharedFrame encodeMix(OpusCodec& codec, const std::vector<float>& pcm, uint32_t sequence, uint32_t sourceId);
+
+    const std::string roomName_;
+
+    // IO线程与混音线程之间交接的数据
+    std::mutex queueMutex_;
+    std::unordered_map<ClientId, std::deque<std::vector<uint8_t>>> pending_;
+    std::vector<ClientId> removed_;
+
+    // 以下只在混音线程访问
+    std::unordered_map<ClientId, std::unique_ptr<Speaker>> speakers_;
+    std::unordered_map<ClientId, std::deque<std::vector<uint8_t>>> frames_;
+    std::unique_ptr<OpusCodec> mixCodec_;  // 编码发给非发言者的完整混音
+    uint32_t mixSequence_;
+    // 混音的采样时钟，每个周期前进 MIX_FRAME_SAMPLES，无人发言或某路流本周期没有输出时也照常前进。
+    // 各路输出流都用它作为时间戳，序列号只在实际发出帧时递增，接收方据此区分停顿和丢包
+    uint32_t sampleClock_;
+    std::vector<float> mix_;
+    std::vector<float> scratch_;
+
+    std::atomic<uint64_t> ticks_;
+    std::atomic<uint64_t> totalNanos_;
+    std::atomic<uint64_t> maxNanos_;
+    std::atomic<size_t> activeSpeakers_;
+};
+
+} // namespace voicechat
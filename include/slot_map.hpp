@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace voicechat {
+
+// 紧凑的32位句柄：低 HANDLE_INDEX_BITS 位为槽位下标，高位为代数。
+// 槽位被复用时代数加一，过期的句柄因此不会指向新的对象；0 为无效句柄
+using Handle = uint32_t;
+
+constexpr Handle INVALID_HANDLE = 0;
+constexpr uint32_t HANDLE_INDEX_BITS = 20;
+constexpr uint32_t HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+constexpr uint32_t HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+constexpr size_t MAX_SLOT_CAPACITY = size_t(1) << HANDLE_INDEX_BITS;
+
+inline uint32_t handleIndex(Handle handle) {
+    return handle & HANDLE_INDEX_MASK;
+}
+
+inline uint32_t handleGeneration(Handle handle) {
+    return handle >> HANDLE_INDEX_BITS;
+}
+
+// 代数化槽位表：容量固定，元素存放在连续数组中且地址不会变化，
+// 插入、查找和删除都是 O(1)。本身不加锁，由调用者负责同步
+template <typename T>
+class SlotMap {
+public:
+    explicit SlotMap(size_t capacity)
+        : slots_(capacity < MAX_SLOT_CAPACITY ? capacity : MAX_SLOT_CAPACITY)
+        , size_(0)
+    {
+        // 空闲槽位按下标从小到大分配，活跃元素尽量集中在数组前部
+        freeList_.reserve(slots_.size());
+        for (size_t i = slots_.size(); i > 0; --i) {
+            freeList_.push_back(static_cast<uint32_t>(i - 1));
+        }
+    }
+
+    // 插入元素，表满时返回 INVALID_HANDLE
+    Handle insert(T value) {
+        if (freeList_.empty()) {
+            return INVALID_HANDLE;
+        }
+        uint32_t index = freeList_.back();
+        freeList_.pop_back();
+
+        Slot& slot = slots_[index];
+        slot.value = std::move(value);
+        slot.occupied = true;
+        ++size_;
+        return (slot.generation << HANDLE_INDEX_BITS) | index;
+    }
+
+    T* find(Handle handle) {
+        Slot* slot = slotFor(handle);
+        return slot ? &slot->value : nullptr;
+    }
+
+    const T* find(Handle handle) const {
+        const Slot* slot = const_cast<SlotMap*>(this)->slotFor(handle);
+        return slot ? &slot->value : nullptr;
+    }
+
+    bool contains(Handle handle) const {
+        return find(handle) != nullptr;
+    }
+
+    // 删除元素，槽位代数加一使旧句柄失效
+    bool erase(Handle handle) {
+        Slot* slot = slotFor(handle);
+        if (!slot) {
+            return false;
+        }
+        slot->value = T();
+        slot->occupied = false;
+        slot->generation = (slot->generation % HANDLE_GENERATION_MASK) + 1;
+        freeList_.push_back(handleIndex(handle));
+        --size_;
+        return true;
+    }
+
+    // 按下标顺序遍历所有元素，func(Handle, T&)
+    template <typename Func>
+    void forEach(Func&& func) {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            Slot& slot = slots_[i];
+            if (slot.occupied) {
+                func((slot.generation << HANDLE_INDEX_BITS) | static_cast<uint32_t>(i), slot.value);
+            }
+        }
+    }
+
+    template <typename Func>
+    void forEach(Func&& func) const {
+        const_cast<SlotMap*>(this)->forEach([&func](Handle handle, T& value) {
+            func(handle, static_cast<const T&>(value));
+        });
+    }
+
+    void clear() {
+        forEach([this](Handle handle, T&) {
+            erase(handle);
+        });
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Slot {
+        T value{};
+        uint32_t generation = 1;  // 从1开始，保证有效句柄不为0
+        bool occupied = false;
+    };
+
+    Slot* slotFor(Handle handle) {
+        uint32_t index = handleIndex(handle);
+        if (index >= slots_.size()) {
+            return nullptr;
+        }
+        Slot& slot = slots_[index];
+        if (!slot.occupied || slot.generation != handleGeneration(handle)) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeList_;
+    size_t size_;
+};
+
+} // namespace voicechat
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "network_interface.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace voicechat {
+
+// 房间内只转发最响的 K 个发言者。电平取自发送端填写在媒体包头的语音电平，
+// 服务器不解码音频；迟滞避免发言者在被选中与落选之间频繁切换
+class SpeakerSelector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t DEFAULT_MAX_SPEAKERS = 3;
+
+    // 电平达到该值（约 -60 dBFS）才算在说话
+    static constexpr uint32_t ACTIVE_LEVEL = 67;
+    // 新发言者需要比被替换者响这么多（dB）才能取代他
+    static constexpr float LEVEL_HYSTERESIS = 6.0f;
+    // 被选中后至少保持的时间，之前不会被更响的人替换
+    static constexpr std::chrono::milliseconds MIN_HOLD{600};
+    // 超过该时间没有说话的发言者可被立即替换
+    static constexpr std::chrono::milliseconds SPEAKER_TIMEOUT{400};
+
+    explicit SpeakerSelector(size_t maxSpeakers = DEFAULT_MAX_SPEAKERS);
+
+    // 根据该发言者本次数据包的电平决定是否转发，可在任意IO线程调用；now 为数据包到达时间
+    bool shouldForward(ClientId speaker, uint32_t level, Clock::time_point now = Clock::now());
+
+    // 发言者离开房间
+    void removeSpeaker(ClientId speaker);
+
+    // 修改同时转发的发言者数，0 表示不限制
+    void setMaxSpeakers(size_t maxSpeakers);
+    size_t maxSpeakers() const { return maxSpeakers_.load(std::memory_order_relaxed); }
+
+private:
+    struct SpeakerState {
+        float score = 0.0f;  // 平滑后的电平
+        Clock::time_point lastActive;
+        Clock::time_point selectedSince;
+        bool selected = false;
+    };
+
+    std::atomic<size_t> maxSpeakers_;
+
+    // 每个房间一把锁，临界区只有 O(K) 的比较，不与其他房间竞争
+    std::mutex mutex_;
+    std::unordered_map<ClientId, SpeakerState> speakers_;
+    std::vector<ClientId> selected_;
+};
+
+} // namespace voicechat
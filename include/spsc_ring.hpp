@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace voicechat {
+
+// 单生产者单消费者的无锁环形缓冲，容量在构造时分配并向上取整为2的幂。
+// 读写只做原子读写和内存复制，不加锁也不分配内存，可以在实时音频回调中使用；
+// 同一时刻只能有一个线程写、一个线程读
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : capacity_(roundUpPowerOfTwo(capacity)), mask_(capacity_ - 1), data_(new T[capacity_]()) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // 可读的元素数，只由消费者调用
+    size_t readAvailable() const {
+        return static_cast<size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed));
+    }
+
+    // 可写的元素数，只由生产者调用
+    size_t writeAvailable() const {
+        return capacity_ - static_cast<size_t>(head_.load(std::memory_order_relaxed) -
+                                               tail_.load(std::memory_order_acquire));
+    }
+
+    // 写入最多 count 个元素，空间不足时只写入能容纳的部分，返回写入的个数
+    size_t write(const T* data, size_t count) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        size_t free = capacity_ - static_cast<size_t>(head - tail_.load(std::memory_order_acquire));
+        count = std::min(count, free);
+        size_t offset = static_cast<size_t>(head) & mask_;
+        size_t first = std::min(count, capacity_ - offset);
+        std::copy_n(data, first, data_.get() + offset);
+        std::copy_n(data + first, count - first, data_.get());
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // 读出最多 count 个元素，返回读出的个数
+    size_t read(T* out, size_t count) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        size_t available = static_cast<size_t>(head_.load(std::memory_order_acquire) - tail);
+        count = std::min(count, available);
+        size_t offset = static_cast<size_t>(tail) & mask_;
+        size_t first = std::min(count, capacity_ - offset);
+        std::copy_n(data_.get() + offset, first, out);
+        std::copy_n(data_.get(), count - first, out + first);
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    static size_t roundUpPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> data_;
+    alignas(64) std::atomic<uint64_t> head_{0};  // 下一个写入位置，只由生产者修改
+    alignas(64) std::atomic<uint64_t> tail_{0};  // 下一个读取位置，只由消费者修改
+};
+
+} // namespace voicechat
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace voicechat {
+
+// UDP媒体通道参数
+// 客户端 -> 服务器的数据报：4字节媒体令牌（小端序）+ 消息体；服务器 -> 客户端的数据报：消息体。
+// 只含令牌的数据报为探测包；令牌后跟一个 0 字节为保活包，表示客户端能收到服务器的数据报。
+// 服务器对两者都回复空数据报作为确认，但只在收到保活包或媒体数据后才向客户端发送UDP媒体
+constexpr size_t MEDIA_TOKEN_SIZE = 4;
+constexpr uint8_t MEDIA_KEEPALIVE = 0;
+constexpr size_t MAX_DATAGRAM_SIZE = 1500;
+// 客户端探测/保活间隔
+constexpr std::chrono::milliseconds MEDIA_PROBE_INTERVAL{1000};
+// 超过该时间没有收到对端数据报，认为UDP不可用并回退到TCP
+constexpr std::chrono::milliseconds MEDIA_TIMEOUT{5000};
+
+// UDP损伤模拟，用于在回环网络上测试丢包、延迟和乱序
+// 通过环境变量 VOICECHAT_UDP_IMPAIR 配置，例如 "loss=0.05,delay=40,jitter=20,dup=0.01"
+class UdpImpairment {
+public:
+    UdpImpairment();
+
+    // 从环境变量读取配置，未设置时不做任何损伤
+    static UdpImpairment fromEnvironment();
+
+    // 解析 "key=value,..." 格式的配置
+    static UdpImpairment parse(const std::string& spec);
+
+    bool enabled() const;
+
+    // 按配置丢弃、复制或延迟执行一次发送
+    void submit(const boost::asio::any_io_executor& executor, std::function<void()> send) const;
+
+private:
+    double lossRate_;       // 丢包率 0-1
+    double duplicateRate_;  // 重复率 0-1
+    int delayMs_;           // 固定延迟
+    int jitterMs_;          // 随机抖动上限，会造成乱序
+};
+
+} // namespace voicechat
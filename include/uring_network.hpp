@@ -0,0 +1,76 @@
+#pragma once
+
+#include "network_interface.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace voicechat {
+
+// 基于 io_uring 的服务器后端（仅 Linux）：每个工作线程拥有一个 ring，
+// 在同一个监听 socket 上发起 multishot accept，连接由接受它的线程负责；
+// 接收使用 multishot recv 和内核提供的缓冲区环，稳定运行时每个连接不需要重新提交接收；
+// 发送队列与 AsioServer 相同，一轮事件处理中产生的所有写操作在一次 io_uring_enter 中批量提交。
+// 只提供TCP，getMediaToken 返回 0，客户端的媒体数据走TCP
+class UringServer : public INetworkServer {
+public:
+    static constexpr size_t DEFAULT_MAX_CLIENTS = 65536;
+    static constexpr unsigned RING_ENTRIES = 4096;
+    static constexpr unsigned RECV_BUFFER_COUNT = 1024;  // 每个工作线程的接收缓冲区数，需为2的幂
+    static constexpr size_t RECV_BUFFER_SIZE = 4096;
+
+    // workerThreads 为工作线程数，0 表示使用硬件并发数；maxFrameSize 为客户端消息体的上限
+    explicit UringServer(size_t workerThreads = 0, size_t maxClients = DEFAULT_MAX_CLIENTS,
+                         size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+    ~UringServer() override;
+
+    // 当前内核是否支持本后端需要的 io_uring 特性（multishot recv 与缓冲区环）
+    static bool isSupported();
+
+    bool start(uint16_t port) override;
+    void stop() override;
+    void broadcast(const std::vector<uint8_t>& data) override;
+    bool sendTo(ClientId clientId, const std::vector<uint8_t>& data,
+                SendPriority priority = SendPriority::Control) override;
+    bool sendFrame(ClientId clientId, SharedFrame frame,
+                   SendPriority priority = SendPriority::Control) override;
+    void multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame,
+                        SendPriority priority = SendPriority::Control) override;
+    uint32_t getMediaToken(ClientId clientId) override;
+    size_t maxClients() const override;
+    void disconnectClient(ClientId clientId) override;
+
+    void setClientConnectedCallback(ClientCallback callback) override;
+    void setClientDisconnectedCallback(ClientCallback callback) override;
+    void setMessageCallback(ClientMessageCallback callback) override;
+
+private:
+    struct Connection;
+    struct Worker;
+
+    std::shared_ptr<Connection> findClient(ClientId clientId);
+    // 把连接交给其所属的工作线程处理发送或关闭
+    void scheduleWrite(const std::shared_ptr<Connection>& connection);
+    // 由工作线程调用
+    std::shared_ptr<Connection> addClient(int fd, Worker& worker);
+    void removeClient(ClientId clientId);
+
+    size_t workerCount_;
+    size_t maxFrameSize_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    int listenFd_;
+
+    ClientCallback clientConnectedCallback_;
+    ClientCallback clientDisconnectedCallback_;
+    ClientMessageCallback messageCallback_;
+
+    std::mutex clientsMutex_;
+    SlotMap<std::shared_ptr<Connection>> clients_;  // 客户端句柄 -> 连接
+    // 按槽位下标发布的连接，发送路径通过原子读取查找，不获取 clientsMutex_
+    std::vector<std::shared_ptr<Connection>> connectionTable_;
+    std::atomic<bool> running_;
+};
+
+} // namespace voicechat
@@ -2,6 +2,7 @@
 
 #include "network_interface.hpp"
 #include "voice_message.pb.h"
+#include "protocol.hpp"
 #include "audio_interface.hpp"
 #include <memory>
 #include <string>
@@ -14,13 +15,22 @@
 #include "asio_network.hpp"
 #include "audio_device.hpp"
 #include "opus_codec.hpp"
+#include "jitter_buffer.hpp"
+#include "frame_blocker.hpp"
+#include "spsc_ring.hpp"
 #include <unordered_map>
+#include <atomic>
 
 namespace voicechat {
 
 class VoiceClient {
 public:
-    explicit VoiceClient(const std::string& userId);
+    // audioDevice 为空时使用声卡的全双工流（PortAudio），没有声卡的环境可用
+    // createDuplexAudioDevice() 组合 headless_audio_device.hpp 中的文件或信号发生器设备。
+    // 设备在第一次加入房间时打开，之后一直保持打开，采集和播放都由设备的音频线程驱动；
+    // 远端音频由媒体线程解码、混音后放入无锁环形缓冲，音频线程只从中取用。设备的回调在实时音频回调中
+    // 执行时（声卡），采集数据也经无锁环形缓冲交给媒体线程编码发送
+    explicit VoiceClient(const std::string& userId, std::unique_ptr<IDuplexAudioDevice> audioDevice = nullptr);
     ~VoiceClient();
 
     // 连接到服务器
@@ -45,21 +55,51 @@ public:
     // 获取当前房间ID
     const std::string& getCurrentRoomId() const { return currentRoomId_; }
 
+    // 设置当前房间是否由服务器混音
+    bool setRoomMixing(bool enabled);
+
     // 获取可用频道列表
     std::unordered_map<std::string, size_t> getAvailableRooms();
 
+    // 设置发送的 Opus 帧长（2.5、5、10、20、40、60ms），只能在加入房间前设置；默认 20ms
+    bool setFrameDuration(std::chrono::microseconds duration);
+
+    // 播放音量，作为混音时每路音频的增益，默认 1.0
+    void setPlaybackGain(float gain);
+
+    // 各远端发言者（按源ID）当前的抖动缓冲延迟
+    std::unordered_map<uint32_t, std::chrono::milliseconds> getPlayoutDelays() const;
+
 private:
     // 处理来自服务器的消息
     void onMessage(const std::vector<uint8_t>& data);
     
     // 处理音频数据
-    void handleAudioData(const AudioData& audioData);
+    void handleAudioData(const MediaView& audioData);
     
+    // 渲染回调：在设备的音频线程中取出 samples 个媒体线程已混好的采样，只读取 playoutRing_
+    void renderAudio(float* output, size_t samples);
+    // 实时采集回调：只把采集数据写入 captureRing_，由媒体线程取出编码发送
+    void queueCapture(const float* samples, size_t count);
+    // 把各发言者的下 samples 个采样混音到 output，返回参与混音的发言者数；内部加锁
+    size_t renderPlayout(float* output, size_t samples);
+    // 媒体线程：编码发送 captureRing_ 中的采集数据，并解码、混音，使 playoutRing_ 中始终有够渲染回调取用的数据
+    void mediaLoop();
+    // 启动和停止媒体线程，只在音频设备停止时调用
+    void startMedia();
+    void stopMedia();
+    // 离开房间后清除各发言者的接收状态
+    void resetPlayout();
+    // 回收空闲发言者的解码器，在媒体线程中调用，需持有 playoutMutex_
+    void evictIdleSpeakers(std::chrono::steady_clock::time_point now);
+
     // 处理服务器响应
     void handleServerResponse(const ServerResponse& response);
     
-    // 音频回调
-    void onAudioData(const std::vector<uint8_t>& audioData);
+    // 编码发送采集数据，在设备的音频线程（非实时回调）或媒体线程中执行
+    void onAudioData(const float* samples, size_t count);
+    // 编码并发送一个完整的帧
+    void sendAudioFrame(uint32_t sourceId, uint32_t timestamp, const float* pcm, size_t samples);
 
     // 请求并等待服务器响应（带返回值的版本）
     bool sendRequest(const ControlMessage& request, ServerResponse& response);
@@ -68,13 +108,58 @@ private:
     void sendRequest(const ControlMessage& request);
 
     std::string userId_;
-    std::string currentRoomId_;
-    bool muted_;
+    std::string currentRoomId_;  // 只在调用方线程使用
+    // 音频线程据此决定是否编码发送：离开房间或断开前先清除 inRoom_ 并停止设备，之后才释放连接
+    std::atomic<bool> inRoom_;
+    std::atomic<bool> muted_;
     bool running_;
-    mutable std::mutex mutex_;
     std::unique_ptr<AsioConnection> connection_;
-    std::unique_ptr<PortAudioDevice> audioDevice_;
+    std::unique_ptr<IDuplexAudioDevice> audioDevice_;
+    bool audioOpen_;  // 音频设备已打开
     std::unique_ptr<OpusCodec> audioCodec_;
+    FrameBlocker frameBlocker_;  // 把采集数据切分为编码帧，只在编码发送的线程使用
+    
+    // 媒体包头：源ID由服务器在进入房间时分配，为0时尚未分配，不发送音频；
+    // 序列号和时间戳只在编码发送的线程中更新
+    std::atomic<uint32_t> sourceId_;
+    uint16_t mediaSequence_;
+    uint32_t mediaTimestamp_;  // 采集时钟：已采集的单声道采样数，不论是否发送都推进
+    
+    // 远端发言者的接收状态，由 playoutMutex_ 保护。解码器在收到该源的第一个包时从 decoderPool_ 取出，
+    // 空闲超过 SPEAKER_IDLE_TIMEOUT 后重置并放回，各发言者的解码器状态互不影响
+    struct RemoteSpeaker {
+        JitterBuffer jitter;
+        std::unique_ptr<OpusCodec> decoder;
+        std::vector<uint8_t> payload;  // pop() 取出的包，容量复用
+        std::vector<float> pcm;        // 最近解码的一帧
+        size_t pcmOffset = 0;          // pcm 中已混音的采样数
+        std::chrono::steady_clock::time_point lastPacket;
+    };
+    static constexpr std::chrono::seconds SPEAKER_IDLE_TIMEOUT{5};
+    static constexpr size_t MAX_POOLED_DECODERS = 8;
+    std::unordered_map<uint32_t, RemoteSpeaker> speakers_;
+    std::vector<std::unique_ptr<OpusCodec>> decoderPool_;
+
+    // 从抖动缓冲取出下一帧并解码到 speaker.pcm，没有数据时返回 false；需持有 playoutMutex_
+    bool decodeNext(RemoteSpeaker& speaker);
+
+    std::atomic<float> playbackGain_;
+    // 保护各发言者的接收状态，只在网络线程、媒体线程和调用方线程之间使用，音频线程不获取
+    mutable std::mutex playoutMutex_;
+    std::chrono::steady_clock::time_point nextEviction_;  // 只在媒体线程使用
+
+    // 音频线程与媒体线程之间的无锁环形缓冲，两者都停止后才重新创建：
+    // captureRing_ 由实时采集回调写、媒体线程读，playoutRing_ 由媒体线程写、渲染回调读
+    static constexpr size_t PLAYOUT_BLOCK_SAMPLES = 480;  // 媒体线程每次混音 10ms
+    static constexpr int AUDIO_RING_MILLISECONDS = 200;
+    static constexpr std::chrono::milliseconds MEDIA_POLL_INTERVAL{5};
+    std::unique_ptr<SpscRing<float>> captureRing_;
+    std::unique_ptr<SpscRing<float>> playoutRing_;
+    std::atomic<uint32_t> captureOverflow_;  // captureRing_ 已满时丢弃的采样数，媒体线程据此推进采集时钟
+    // 渲染回调一次请求的最大采样数，媒体线程预先混好这么多再加一块，吸收自身的调度延迟
+    std::atomic<size_t> renderBlock_;
+    std::atomic<bool> mediaRunning_;
+    std::thread mediaThread_;
     
     // 存储服务器响应的Promise
     std::shared_ptr<std::promise<ServerResponse>> responsePromise_;
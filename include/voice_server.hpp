@@ -2,6 +2,7 @@
 
 #include "network_interface.hpp"
 #include "voice_message.pb.h"
+#include "protocol.hpp"
 #include "audio_interface.hpp"
 #include <memory>
 #include <unordered_map>
@@ -10,22 +11,61 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
-#include <unordered_set>
 #include <thread>
 #include <chrono>
 #include "asio_network.hpp"
+#include "room_mixer.hpp"
+#include "speaker_selector.hpp"
+#include "room_bridge.hpp"
+#include <atomic>
 
 namespace voicechat {
 
+// 房间句柄，与客户端句柄使用同样的槽位表编码
+using RoomId = Handle;
+
 struct ClientInfo {
+    ClientId id = INVALID_HANDLE;  // 与下标对应的句柄，不一致说明该槽位已空闲或被复用
+    RoomId roomId = INVALID_HANDLE;
     std::string userId;
-    std::string roomId;
-    bool muted;
+    uint32_t sourceId = 0;  // 当前房间内的媒体源ID
+    bool muted = false;
+    std::string bridgeNode;  // 非空时该连接是由该节点发起的桥接链路，不属于任何房间
+};
+
+// 房间成员的不可变快照，成员变化时整体替换，读者无需加锁
+using MemberList = std::vector<ClientId>;
+
+// 音频路径看到的房间：名称不变，成员快照通过 std::atomic_load/atomic_store 原子替换
+struct RoomChannel {
+    RoomChannel(std::string roomName, size_t maxSpeakers)
+        : name(std::move(roomName)), members(std::make_shared<const MemberList>()), selector(maxSpeakers) {}
+
+    const std::string name;
+    RoomId id = INVALID_HANDLE;  // 房间句柄，同时作为本节点公布给对端节点的通道号
+    std::shared_ptr<const MemberList> members;
+    std::shared_ptr<RoomMixer> mixer;  // 非空时房间处于服务器混音模式
+    SpeakerSelector selector;          // 转发模式下选择转发的发言者
+    std::shared_ptr<const BridgeTargets> bridgeTargets;  // 该房间也有成员的对端节点
+
+    std::shared_ptr<const MemberList> snapshot() const { return std::atomic_load(&members); }
+    std::shared_ptr<RoomMixer> currentMixer() const { return std::atomic_load(&mixer); }
+    std::shared_ptr<const BridgeTargets> currentBridgeTargets() const { return std::atomic_load(&bridgeTargets); }
+};
+
+struct Room {
+    std::string name;
+    std::shared_ptr<RoomChannel> channel;
 };
 
 class VoiceServer {
 public:
-    explicit VoiceServer(uint16_t port);
+    static constexpr size_t MAX_ROOMS = 16384;
+
+    // ioThreads 为网络IO线程数，0 表示使用硬件并发数
+    explicit VoiceServer(uint16_t port, size_t ioThreads = 0);
+    // 使用指定的网络后端（如 UringServer），启动时选择
+    VoiceServer(uint16_t port, std::unique_ptr<INetworkServer> server);
     explicit VoiceServer();
     ~VoiceServer();
 
@@ -46,29 +86,94 @@ public:
 
     std::unordered_map<std::string, size_t> getRoomParticipantCounts() const;
 
+    // 转发模式下每个房间同时转发的发言者数，0 表示不限制
+    void setMaxForwardedSpeakers(size_t count);
+
+    // 开启或关闭房间的服务器混音模式，房间不存在时返回 false
+    bool setRoomMixing(const std::string& roomId, bool enabled);
+
+    // 各混音房间的混音耗时统计
+    std::unordered_map<std::string, MixerStats> getMixerStats() const;
+
+    // 开启节点间桥接，peers 为其他节点（可以包含本节点），secret 为各节点共用的链路密钥；需在 start() 之前调用。
+    // 只接受配置中的节点发起的、密钥一致的桥接链路
+    void enableBridge(const std::string& nodeId, std::vector<BridgePeer> peers, const std::string& secret);
+
 private:
     // 处理客户端连接
-    void onClientConnected(const std::string& clientId);
-    void onClientDisconnected(const std::string& clientId);
+    void onClientConnected(ClientId clientId);
+    void onClientDisconnected(ClientId clientId);
     
     // 处理客户端消息
-    void onMessage(const std::string& clientId, const std::vector<uint8_t>& data);
+    void onMessage(ClientId clientId, ByteSpan data);
+    
+    // 拒绝客户端（如协议版本不匹配）：回复错误后断开连接
+    void rejectClient(ClientId clientId, const std::string& reason);
     
     // 处理控制消息
-    void handleControlMessage(const std::string& clientId, const voicechat::ControlMessage& msg);
+    void handleControlMessage(ClientId clientId, const voicechat::ControlMessage& msg);
     
-    // 处理音频数据
-    void handleAudioData(const std::string& clientId, const voicechat::AudioData& audioData);
+    // 处理媒体包，packet 为收到的原始消息，转发模式下原样转发，混音模式下交给混音器
+    void handleAudioData(ClientId clientId, const MediaView& audio, ByteSpan packet);
     
-    // 广播音频数据到房间
-    void broadcastToRoom(const std::string& roomId, const std::vector<uint8_t>& data, const std::string& excludeClientId = "");
+    // 广播音频数据到房间，同一帧被所有接收者共享；不持有任何锁
+    void broadcastToRoom(const RoomChannel& room, const SharedFrame& frame, ClientId excludeClientId = INVALID_HANDLE);
+
+    // 节点间桥接：处理对端链路上的控制消息和媒体包，把本地发言者的媒体包转发给房间所在的对端
+    void handleBridgeMessage(ClientId clientId, const BridgeMessage& msg);
+    void handleBridgeMedia(ClientId clientId, ByteSpan data);
+    void forwardToBridge(const RoomChannel& room, ByteSpan packet);
+    // 本节点当前有成员的房间列表，供链路线程公布给对端
+    std::shared_ptr<const BridgeRoomList> bridgeRoomsSnapshot();
+
+    // 以下函数需持有 mutex_
+    ClientInfo* findClientLocked(ClientId clientId);
+    RoomId findOrCreateRoomLocked(const std::string& name);
+    bool addToRoomLocked(ClientInfo& client, RoomId roomId);
+    void removeFromRoomLocked(ClientInfo& client);
+    void publishRouteLocked(ClientId clientId, std::shared_ptr<RoomChannel> channel);
+    bool setRoomMixingLocked(RoomId roomId, bool enabled);
+    void publishMixingRoomsLocked();
+    void updateBridgeTargetsLocked(RoomChannel& channel);
+
+    // 混音线程：每个 MIX_INTERVAL 为所有混音房间执行一个周期
+    void runMixer();
 
     uint16_t port_;
     bool running_;
     mutable std::mutex mutex_;
-    std::unique_ptr<AsioServer> server_;
-    std::unordered_map<std::string, std::string> clientRooms_;  // clientId -> roomId
-    std::unordered_map<std::string, std::unordered_set<std::string>> rooms_;  // roomId -> set of clientIds
+    std::unique_ptr<INetworkServer> server_;
+    std::vector<ClientInfo> clients_;  // 按客户端句柄的槽位下标存放
+    size_t clientCount_;
+    // 客户端所在房间，按槽位下标存放，容量与传输层的客户端表相同；音频路径无锁读取，修改时仍持有 mutex_
+    std::vector<std::shared_ptr<RoomChannel>> routes_;
+    // 客户端当前的媒体源ID，与 routes_ 一样按槽位下标存放，音频路径据此丢弃源ID不符的包
+    std::vector<std::atomic<uint32_t>> sourceIds_;
+    uint32_t nextSourceId_;
+    SlotMap<Room> rooms_;
+    // 按房间槽位下标发布的房间，对端节点发来的媒体包按通道号无锁查找
+    std::vector<std::shared_ptr<RoomChannel>> roomChannels_;
+    std::unordered_map<std::string, RoomId> roomNames_;  // 房间名 -> 句柄，仅用于控制消息
+    RoomId mainRoom_;
+    size_t maxForwardedSpeakers_;
+    
+    // 处于混音模式的房间，与成员快照一样整体替换，混音线程无锁读取
+    std::shared_ptr<const std::vector<std::shared_ptr<RoomChannel>>> mixingRooms_;
+    std::atomic<bool> mixerRunning_;
+    std::thread mixerThread_;
+
+    // 节点间桥接，未开启时 bridge_ 为空
+    struct PeerNode {
+        ClientId clientId = INVALID_HANDLE;  // 对端发起的入站链路
+        std::unordered_map<std::string, uint32_t> rooms;    // 对端有成员的房间 -> 对端通道号
+        std::unordered_map<std::string, uint32_t> pending;  // 正在接收的分条房间列表
+    };
+    std::unique_ptr<RoomBridge> bridge_;
+    std::unordered_map<std::string, PeerNode> peerNodes_;  // 节点ID -> 对端状态
+    // 入站桥接链路的标记，按客户端槽位下标存放，媒体路径无锁读取
+    std::vector<std::atomic<bool>> bridgePeers_;
+    std::shared_ptr<const BridgeRoomList> bridgeRooms_;
+    bool bridgeRoomsDirty_;
 };
 
 } // namespace voicechat 
\ No newline at end of file
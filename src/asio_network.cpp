@@ -1,14 +1,200 @@
 #include "asio_network.hpp"
-#include <iostream>
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <cerrno>
+#endif
 
 namespace voicechat {
 
+namespace {
+
+// 传输层指标，首次使用时注册，之后只做无锁的原子加
+struct NetworkMetrics {
+  Counter& tcpPacketsIn;
+  Counter& tcpBytesIn;
+  Counter& tcpPacketsOut;
+  Counter& tcpBytesOut;
+  Counter& udpPacketsIn;
+  Counter& udpBytesIn;
+  Counter& udpPacketsOut;
+  Counter& udpBytesOut;
+  Counter& udpSendErrors;
+  Counter& queueDrops;
+  Histogram& queueBytes;
+  Histogram& fanoutLatency;
+  Gauge& clients;
+
+  static NetworkMetrics& instance() {
+    static NetworkMetrics metrics(MetricsRegistry::instance());
+    return metrics;
+  }
+
+private:
+  explicit NetworkMetrics(MetricsRegistry& r)
+    : tcpPacketsIn(r.counter("voicechat_packets_received_total", "Frames received", "transport=\"tcp\""))
+    , tcpBytesIn(r.counter("voicechat_bytes_received_total", "Bytes received", "transport=\"tcp\""))
+    , tcpPacketsOut(r.counter("voicechat_packets_sent_total", "Frames written", "transport=\"tcp\""))
+    , tcpBytesOut(r.counter("voicechat_bytes_sent_total", "Bytes written", "transport=\"tcp\""))
+    , udpPacketsIn(r.counter("voicechat_packets_received_total", "Frames received", "transport=\"udp\""))
+    , udpBytesIn(r.counter("voicechat_bytes_received_total", "Bytes received", "transport=\"udp\""))
+    , udpPacketsOut(r.counter("voicechat_packets_sent_total", "Frames written", "transport=\"udp\""))
+    , udpBytesOut(r.counter("voicechat_bytes_sent_total", "Bytes written", "transport=\"udp\""))
+    , udpSendErrors(r.counter("voicechat_udp_send_errors_total", "Datagrams the kernel refused to send"))
+    , queueDrops(r.counter("voicechat_send_queue_drops_total", "Media frames dropped from full send queues"))
+    , queueBytes(r.histogram("voicechat_send_queue_bytes", "Per-connection send queue backlog sampled on enqueue"))
+    , fanoutLatency(r.histogram("voicechat_fanout_latency_seconds",
+                                "Time from audio ingest to TCP write completion", 1e-9))
+    , clients(r.gauge("voicechat_connected_clients", "Connected TCP clients"))
+  {
+  }
+};
+
+} // namespace
+
+// OutboundQueue实现
+OutboundQueue::OutboundQueue(size_t maxQueuedBytes)
+  : control_(INITIAL_CAPACITY)
+  , media_(INITIAL_CAPACITY)
+  , nextOrder_(0)
+  , pendingBytes_(0)
+  , maxQueuedBytes_(maxQueuedBytes)
+  , dropped_(0)
+  , writing_(false)
+{
+}
+
+bool OutboundQueue::push(SharedFrame frame, SendPriority priority) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  
+  // 积压超过上限时从最旧的媒体包开始丢弃，每次只移除媒体队列的头部
+  while (pendingBytes_ + frame->size() > maxQueuedBytes_ && !media_.empty()) {
+    pendingBytes_ -= media_.front().frame->size();
+    media_.pop_front();
+    ++dropped_;
+    NetworkMetrics::instance().queueDrops.add();
+  }
+  
+  // 队列中只剩控制消息时，新的媒体包直接丢弃
+  if (priority == SendPriority::Media && pendingBytes_ + frame->size() > maxQueuedBytes_) {
+    ++dropped_;
+    NetworkMetrics::instance().queueDrops.add();
+    return false;
+  }
+  
+  pendingBytes_ += frame->size();
+  append(priority == SendPriority::Media ? media_ : control_, Packet{std::move(frame), nextOrder_++});
+  NetworkMetrics::instance().queueBytes.record(pendingBytes_);
+  
+  if (writing_) {
+    return false;
+  }
+  writing_ = true;
+  return true;
+}
+
+void OutboundQueue::append(boost::circular_buffer<Packet>& queue, Packet packet) {
+  if (queue.full()) {
+    queue.set_capacity(queue.capacity() * 2);
+  }
+  queue.push_back(std::move(packet));
+}
+
+bool OutboundQueue::takeBatch(std::vector<boost::asio::const_buffer>& buffers) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers.clear();
+  
+  if (control_.empty() && media_.empty()) {
+    writing_ = false;
+    return false;
+  }
+  
+  // 合并当前积压的所有数据，单次写出；两个队列按入队序号归并
+  while ((!control_.empty() || !media_.empty()) && inFlight_.size() < MAX_BATCH_PACKETS) {
+    auto& queue = media_.empty() || (!control_.empty() && control_.front().order < media_.front().order)
+      ? control_ : media_;
+    pendingBytes_ -= queue.front().frame->size();
+    inFlight_.push_back(std::move(queue.front()));
+    queue.pop_front();
+  }
+  
+  for (const auto& packet : inFlight_) {
+    buffers.push_back(boost::asio::buffer(packet.frame->data(), packet.frame->size()));
+  }
+  return true;
+}
+
+void OutboundQueue::completeBatch() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  
+  // 带接收时间的帧（服务器转发的音频）统计转发延迟
+  auto& metrics = NetworkMetrics::instance();
+  auto now = std::chrono::steady_clock::now();
+  size_t bytes = 0;
+  for (const auto& packet : inFlight_) {
+    bytes += packet.frame->size();
+    auto ingestTime = packet.frame->ingestTime();
+    if (ingestTime != std::chrono::steady_clock::time_point()) {
+      metrics.fanoutLatency.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - ingestTime).count()));
+    }
+  }
+  metrics.tcpPacketsOut.add(inFlight_.size());
+  metrics.tcpBytesOut.add(bytes);
+  inFlight_.clear();
+}
+
+void OutboundQueue::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  control_.clear();
+  media_.clear();
+  inFlight_.clear();
+  pendingBytes_ = 0;
+  writing_ = false;
+}
+
+bool OutboundQueue::isWriting() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return writing_;
+}
+
+size_t OutboundQueue::droppedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
 // AsioConnection实现
 AsioConnection::AsioConnection()
-  : socket_(io_context_)
-  , isWriting_(false)
+  : ownedContext_(std::make_unique<boost::asio::io_context>())
+  , io_context_(*ownedContext_)
+  , socket_(io_context_)
+  , resolver_(io_context_)
+  , connectAttempt_(0)
+  , udpSocket_(io_context_)
+  , mediaTimer_(io_context_)
+  , mediaToken_{}
+  , mediaActive_(false)
+  , impairment_(UdpImpairment::fromEnvironment())
+  , headerBuffer_(HEADER_SIZE)
   , isConnected_(false)
+{
+}
+
+AsioConnection::AsioConnection(boost::asio::io_context& context)
+  : io_context_(context)
+  , socket_(io_context_)
+  , resolver_(io_context_)
+  , connectAttempt_(0)
+  , udpSocket_(io_context_)
+  , mediaTimer_(io_context_)
+  , mediaToken_{}
+  , mediaActive_(false)
+  , impairment_(UdpImpairment::fromEnvironment())
   , headerBuffer_(HEADER_SIZE)
+  , isConnected_(false)
 {
 }
 
@@ -17,11 +203,19 @@ AsioConnection::~AsioConnection() {
 }
 
 bool AsioConnection::connect(const std::string& host, uint16_t port) {
+  uint64_t attempt = ++connectAttempt_;
+  if (!ownedContext_) {
+    // 外部的 io_context：解析和连接都在其上异步进行，结果通过连接和错误回调通知
+    boost::asio::post(io_context_, [this, host, port, attempt]() {
+      doResolve(host, port, attempt);
+    });
+    return true;
+  }
+  
   try {
-    boost::asio::ip::tcp::resolver resolver(io_context_);
-    auto endpoints = resolver.resolve(host, std::to_string(port));
+    auto endpoints = resolver_.resolve(host, std::to_string(port));
     
-    doConnect(*endpoints.begin());
+    doConnect(*endpoints.begin(), attempt);
     
     // 启动IO线程
     io_thread_ = std::thread([this]() {
@@ -38,43 +232,43 @@ bool AsioConnection::connect(const std::string& host, uint16_t port) {
 }
 
 void AsioConnection::disconnect() {
-  if (isConnected_) {
-    boost::system::error_code ec;
+  mediaActive_ = false;
+  ++connectAttempt_;
+  boost::system::error_code ec;
+  if (isConnected_.exchange(false)) {
     socket_.close(ec);
-    isConnected_ = false;
   }
   
   if (io_thread_.joinable()) {
     io_context_.stop();
     io_thread_.join();
+  } else if (!ownedContext_) {
+    // 外部的 io_context 继续运行，取消所有未完成的操作，其回调随后以 operation_aborted 返回
+    resolver_.cancel();
+    socket_.close(ec);
+    udpSocket_.close(ec);
+    mediaTimer_.cancel();
   }
 }
 
-bool AsioConnection::send(const std::vector<uint8_t>& data) {
+bool AsioConnection::send(const std::vector<uint8_t>& data, SendPriority priority) {
+  return send(makeFrame(data.data(), data.size()), priority);
+}
+
+bool AsioConnection::send(SharedFrame frame, SendPriority priority) {
   if (!isConnected_) return false;
   
-  // 准备数据包（4字节头 + 数据）
-  std::vector<uint8_t> packet;
-  packet.reserve(HEADER_SIZE + data.size());
-  
-  // 添加长度头
-  uint32_t size = static_cast<uint32_t>(data.size());
-  for (int i = 0; i < HEADER_SIZE; ++i) {
-    packet.push_back(static_cast<uint8_t>((size >> (8 * i)) & 0xFF));
-  }
-  
-  // 添加数据
-  packet.insert(packet.end(), data.begin(), data.end());
-  
-  // 加入发送队列
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    writeQueue_.push(std::move(packet));
+  // 媒体数据优先走UDP，避免TCP队头阻塞
+  if (priority == SendPriority::Media && mediaActive_) {
+    sendDatagram(std::move(frame));
+    return true;
   }
   
-  // 如果没有正在进行的写操作，启动一个
-  if (!isWriting_) {
-    doWrite();
+  // 加入发送队列，如果没有正在进行的写操作，在IO线程上启动一个
+  if (writeQueue_.push(std::move(frame), priority)) {
+    boost::asio::post(io_context_, [this]() {
+      doWrite();
+    });
   }
   
   return true;
@@ -84,6 +278,45 @@ bool AsioConnection::isConnected() const {
   return isConnected_;
 }
 
+bool AsioConnection::enableMedia(uint32_t token) {
+  if (!isConnected_ || token == 0) {
+    return false;
+  }
+  
+  // 在IO线程上打开UDP socket，目标为TCP连接的服务器地址和端口
+  boost::asio::post(io_context_, [this, token]() {
+    if (udpSocket_.is_open()) {
+      return;
+    }
+    
+    boost::system::error_code ec;
+    auto remote = socket_.remote_endpoint(ec);
+    if (!ec) {
+      boost::asio::ip::udp::endpoint endpoint(remote.address(), remote.port());
+      udpSocket_.open(endpoint.protocol(), ec);
+      if (!ec) {
+        udpSocket_.connect(endpoint, ec);
+      }
+    }
+    if (ec) {
+      VC_LOG_WARN("UDP媒体通道打开失败，音频使用TCP: " << ec.message());
+      udpSocket_.close(ec);
+      return;
+    }
+    
+    for (size_t i = 0; i < MEDIA_TOKEN_SIZE; ++i) {
+      mediaToken_[i] = static_cast<uint8_t>((token >> (8 * i)) & 0xFF);
+    }
+    doMediaReceive();
+    doMediaProbe();
+  });
+  return true;
+}
+
+bool AsioConnection::isMediaActive() const {
+  return mediaActive_;
+}
+
 void AsioConnection::setMessageCallback(MessageCallback callback) {
   messageCallback_ = std::move(callback);
 }
@@ -100,9 +333,42 @@ void AsioConnection::setDisconnectedCallback(ConnectionCallback callback) {
   disconnectedCallback_ = std::move(callback);
 }
 
-void AsioConnection::doConnect(const boost::asio::ip::tcp::endpoint& endpoint) {
+void AsioConnection::doResolve(const std::string& host, uint16_t port, uint64_t attempt) {
+  if (attempt != connectAttempt_) {
+    return;
+  }
+  
+  // 关闭上一次的连接或尚未完成的连接尝试，被取消的读写回调在新的连接建立之前执行；
+  // 发送队列中是发给上一个连接的数据，一并丢弃
+  boost::system::error_code ec;
+  isConnected_ = false;
+  mediaActive_ = false;
+  resolver_.cancel();
+  socket_.close(ec);
+  udpSocket_.close(ec);
+  mediaTimer_.cancel();
+  writeQueue_.clear();
+  
+  resolver_.async_resolve(host, std::to_string(port),
+    [this, attempt](const boost::system::error_code& error,
+                    const boost::asio::ip::tcp::resolver::results_type& endpoints) {
+      if (attempt != connectAttempt_) {
+        return;
+      }
+      if (error || endpoints.empty()) {
+        handleError(error ? error : boost::asio::error::host_not_found);
+        return;
+      }
+      doConnect(*endpoints.begin(), attempt);
+    });
+}
+
+void AsioConnection::doConnect(const boost::asio::ip::tcp::endpoint& endpoint, uint64_t attempt) {
   socket_.async_connect(endpoint,
-    [this](const boost::system::error_code& error) {
+    [this, attempt](const boost::system::error_code& error) {
+      if (attempt != connectAttempt_) {
+        return;
+      }
       if (!error) {
         isConnected_ = true;
         if (connectedCallback_) {
@@ -123,11 +389,16 @@ void AsioConnection::doRead() {
       if (!error) {
         // 解析数据长度
         uint32_t dataSize = 0;
-        for (int i = 0; i < HEADER_SIZE; ++i) {
-          dataSize |= (headerBuffer_[i] << (8 * i));
+        for (size_t i = 0; i < HEADER_SIZE; ++i) {
+          dataSize |= (static_cast<uint32_t>(headerBuffer_[i]) << (8 * i));
         }
         
         // 准备接收数据
+        if (dataSize > MAX_FRAME_SIZE) {
+          VC_LOG_ERROR("服务器消息长度 " << dataSize << " 超过上限，断开连接");
+          handleError(boost::asio::error::message_size);
+          return;
+        }
         readBuffer_.resize(dataSize);
         boost::asio::async_read(socket_,
           boost::asio::buffer(readBuffer_),
@@ -148,33 +419,118 @@ void AsioConnection::doRead() {
 }
 
 void AsioConnection::doWrite() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (writeQueue_.empty()) {
-    isWriting_ = false;
+  // 把队列中积压的消息合并为一次写
+  if (!writeQueue_.takeBatch(writeBuffers_)) {
     return;
   }
   
-  isWriting_ = true;
   boost::asio::async_write(socket_,
-    boost::asio::buffer(writeQueue_.front()),
+    ConstBufferView(writeBuffers_),
     [this](const boost::system::error_code& error, std::size_t /*length*/) {
+      writeQueue_.completeBatch();
       if (!error) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        writeQueue_.pop();
-        doWrite(); // 继续发送下一个消息
+        doWrite(); // 继续发送积压的消息
       } else {
         handleError(error);
       }
     });
 }
 
+void AsioConnection::doMediaReceive() {
+  udpSocket_.async_receive(boost::asio::buffer(datagramBuffer_),
+    [this](const boost::system::error_code& error, std::size_t length) {
+      if (error == boost::asio::error::operation_aborted || !udpSocket_.is_open()) {
+        return;
+      }
+      
+      // ICMP端口不可达等错误不影响继续接收，超时检测负责回退
+      if (!error) {
+        lastDatagramTime_ = std::chrono::steady_clock::now();
+        if (!mediaActive_) {
+          mediaActive_ = true;
+          VC_LOG_INFO("UDP媒体通道已启用");
+        }
+        
+        // 空数据报是探测确认，其余为消息体
+        if (length > 0 && messageCallback_) {
+          datagramMessage_.assign(datagramBuffer_.begin(), datagramBuffer_.begin() + length);
+          messageCallback_(datagramMessage_);
+        }
+      }
+      doMediaReceive();
+    });
+}
+
+void AsioConnection::doMediaProbe() {
+  // 下行尚未确认时发送只含令牌的探测包，确认后发送保活包
+  auto probe = std::make_shared<std::vector<uint8_t>>(mediaToken_.begin(), mediaToken_.end());
+  if (mediaActive_) {
+    probe->push_back(MEDIA_KEEPALIVE);
+  }
+  auto sendProbe = [this, probe]() {
+    boost::system::error_code ec;
+    udpSocket_.send(boost::asio::buffer(*probe), 0, ec);
+  };
+  if (impairment_.enabled()) {
+    impairment_.submit(io_context_.get_executor(), sendProbe);
+  } else {
+    sendProbe();
+  }
+  
+  mediaTimer_.expires_after(MEDIA_PROBE_INTERVAL);
+  mediaTimer_.async_wait([this](const boost::system::error_code& error) {
+    if (error || !udpSocket_.is_open()) {
+      return;
+    }
+    
+    // 长时间收不到服务器的数据报，说明UDP被阻断，媒体回退到TCP
+    if (mediaActive_ && std::chrono::steady_clock::now() - lastDatagramTime_ > MEDIA_TIMEOUT) {
+      mediaActive_ = false;
+      VC_LOG_WARN("UDP媒体通道超时，音频回退到TCP");
+    }
+    doMediaProbe();
+  });
+}
+
+void AsioConnection::sendDatagram(SharedFrame frame) {
+  // 令牌与消息体以 gather 方式发送，不复制数据；调用方是音频线程，与IO线程上的接收并发，
+  // 因此在原生描述符上发送，不经过 asio 的 socket 对象
+  auto sendFrame = [this, frame]() {
+#ifdef __linux__
+    std::array<iovec, 2> iov = {{
+      {mediaToken_.data(), mediaToken_.size()},
+      {const_cast<uint8_t*>(frame->body()), frame->bodySize()}
+    }};
+    msghdr message{};
+    message.msg_iov = iov.data();
+    message.msg_iovlen = iov.size();
+    ::sendmsg(udpSocket_.native_handle(), &message, 0);
+#else
+    std::array<boost::asio::const_buffer, 2> buffers = {
+      boost::asio::buffer(mediaToken_),
+      boost::asio::buffer(frame->body(), frame->bodySize())
+    };
+    boost::system::error_code ec;
+    udpSocket_.send(buffers, 0, ec);
+#endif
+  };
+  if (impairment_.enabled()) {
+    impairment_.submit(io_context_.get_executor(), sendFrame);
+  } else {
+    sendFrame();
+  }
+}
+
 void AsioConnection::handleError(const boost::system::error_code& error) {
+  // 主动断开或重新连接时取消的操作不是连接错误，不能影响之后建立的新连接
+  if (error == boost::asio::error::operation_aborted) {
+    return;
+  }
   if (errorCallback_) {
     errorCallback_(error.message());
   }
   
-  if (isConnected_) {
-    isConnected_ = false;
+  if (isConnected_.exchange(false)) {
     if (disconnectedCallback_) {
       disconnectedCallback_();
     }
@@ -182,10 +538,31 @@ void AsioConnection::handleError(const boost::system::error_code& error) {
 }
 
 // AsioServer实现
-AsioServer::AsioServer()
+bool AsioServer::ClientSession::activeMediaEndpoint(boost::asio::ip::udp::endpoint& endpoint) {
+  std::lock_guard<std::mutex> lock(mediaMutex);
+  if (std::chrono::steady_clock::now() - mediaLastSeen > MEDIA_TIMEOUT) {
+    return false;
+  }
+  endpoint = mediaEndpoint;
+  return true;
+}
+
+AsioServer::AsioServer(size_t ioThreads, size_t maxClients, size_t maxFrameSize)
   : acceptor_(io_context_)
+  , ioThreadCount_(ioThreads > 0 ? ioThreads : std::max(1u, std::thread::hardware_concurrency()))
+  , maxFrameSize_(maxFrameSize)
+  , clients_(maxClients)
+  , sessionTable_(clients_.capacity())
+  , tokenIndexMask_(0)
+  , tokenGenerator_(std::random_device{}())
   , running_(false)
+  , udpSocket_(io_context_)
+  , impairment_(UdpImpairment::fromEnvironment())
 {
+  // 下标只占容纳最大槽位所需的位数，剩余的位都用作校验
+  while (tokenIndexMask_ < HANDLE_INDEX_MASK && tokenIndexMask_ + 1 < sessionTable_.size()) {
+    tokenIndexMask_ = (tokenIndexMask_ << 1) | 1;
+  }
 }
 
 AsioServer::~AsioServer() {
@@ -199,177 +576,456 @@ bool AsioServer::start(uint16_t port) {
     acceptor_.bind(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port));
     acceptor_.listen();
     
+    // UDP媒体通道使用相同端口；非阻塞发送，缓冲区满时直接丢弃媒体包
+    udpSocket_.open(boost::asio::ip::udp::v4());
+    udpSocket_.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port));
+    udpSocket_.non_blocking(true);
+    
     running_ = true;
     doAccept();
+    for (size_t i = 0; i < ioThreadCount_; ++i) {
+      doReceiveDatagram(std::make_shared<DatagramReceiver>());
+    }
     
-    // 启动IO线程
-    io_thread_ = std::thread([this]() {
-      io_context_.run();
-    });
+    // 启动IO线程池，所有线程共同运行同一个io_context
+    for (size_t i = 0; i < ioThreadCount_; ++i) {
+      ioThreads_.emplace_back([this]() {
+        io_context_.run();
+      });
+    }
     
     return true;
   } catch (const std::exception& e) {
-    std::cerr << "Server start error: " << e.what() << std::endl;
+    VC_LOG_ERROR("Server start error: " << e.what());
     return false;
   }
 }
 
 void AsioServer::stop() {
   running_ = false;
-  acceptor_.close();
+  boost::system::error_code ec;
+  acceptor_.close(ec);
+  udpSocket_.close(ec);
   
-  {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    for (auto& client : clients_) {
-      client.second->close();
+  // 先停止IO线程，之后关闭socket时不会再有并发的回调
+  io_context_.stop();
+  for (auto& thread : ioThreads_) {
+    if (thread.joinable()) {
+      thread.join();
     }
-    clients_.clear();
   }
+  ioThreads_.clear();
   
-  if (io_thread_.joinable()) {
-    io_context_.stop();
-    io_thread_.join();
-  }
+  std::lock_guard<std::mutex> lock(clientsMutex_);
+  clients_.forEach([this, &ec](ClientId clientId, std::shared_ptr<ClientSession>& session) {
+    session->socket.close(ec);
+    std::atomic_store(&sessionTable_[handleIndex(clientId)], std::shared_ptr<ClientSession>());
+  });
+  clients_.clear();
 }
 
 void AsioServer::broadcast(const std::vector<uint8_t>& data) {
-  std::lock_guard<std::mutex> lock(clientsMutex_);
-  for (const auto& client : clients_) {
-    sendTo(client.first, data);
+  std::vector<ClientId> clientIds;
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    clientIds.reserve(clients_.size());
+    clients_.forEach([&clientIds](ClientId clientId, const std::shared_ptr<ClientSession>&) {
+      clientIds.push_back(clientId);
+    });
   }
+  multicastFrame(clientIds, makeFrame(data.data(), data.size()));
 }
 
-bool AsioServer::sendTo(const std::string& clientId, const std::vector<uint8_t>& data) {
-  std::shared_ptr<boost::asio::ip::tcp::socket> clientSocket;
-  {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    auto it = clients_.find(clientId);
-    if (it == clients_.end()) {
-      return false;
+bool AsioServer::sendTo(ClientId clientId, const std::vector<uint8_t>& data,
+                        SendPriority priority) {
+  return sendFrame(clientId, makeFrame(data.data(), data.size()), priority);
+}
+
+bool AsioServer::sendFrame(ClientId clientId, SharedFrame frame, SendPriority priority) {
+  auto session = findClient(clientId);
+  if (!session) {
+    return false;
+  }
+  
+  // 客户端的UDP媒体通道可用时媒体数据走UDP
+  if (priority == SendPriority::Media) {
+    boost::asio::ip::udp::endpoint endpoint;
+    if (session->activeMediaEndpoint(endpoint)) {
+      sendDatagram(endpoint, std::move(frame));
+      return true;
     }
-    clientSocket = it->second;
   }
   
-  // 准备数据包
-  std::vector<uint8_t> packet;
-  packet.reserve(4 + data.size());
+  // 加入该连接的发送队列（只增加引用计数）；没有进行中的写操作时在其strand上发起一次
+  if (session->writeQueue.push(std::move(frame), priority)) {
+    boost::asio::post(session->strand,
+      [this, session]() {
+        doWrite(session);
+      });
+  }
   
-  // 添加长度头
-  uint32_t size = static_cast<uint32_t>(data.size());
-  for (int i = 0; i < 4; ++i) {
-    packet.push_back(static_cast<uint8_t>((size >> (8 * i)) & 0xFF));
+  return true;
+}
+
+void AsioServer::multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame,
+                                SendPriority priority) {
+  // 接收者按句柄下标无锁查找；UDP接收者收集后批量发送，其余走各自的TCP发送队列。
+  // 端点列表按线程复用，稳定运行时不分配内存
+  thread_local std::vector<boost::asio::ip::udp::endpoint> endpoints;
+  endpoints.clear();
+  for (ClientId clientId : clientIds) {
+    auto session = findClient(clientId);
+    if (!session) {
+      continue;
+    }
+    boost::asio::ip::udp::endpoint endpoint;
+    if (priority == SendPriority::Media && session->activeMediaEndpoint(endpoint)) {
+      endpoints.push_back(endpoint);
+      continue;
+    }
+    if (session->writeQueue.push(frame, priority)) {
+      boost::asio::post(session->strand,
+        [this, session]() {
+          doWrite(session);
+        });
+    }
   }
   
-  // 添加数据
-  packet.insert(packet.end(), data.begin(), data.end());
+  if (!endpoints.empty()) {
+    sendDatagrams(endpoints, frame);
+  }
+}
+
+uint32_t AsioServer::getMediaToken(ClientId clientId) {
+  auto session = findClient(clientId);
+  return session ? session->mediaToken : 0;
+}
+
+size_t AsioServer::maxClients() const {
+  return sessionTable_.size();
+}
+
+std::shared_ptr<AsioServer::ClientSession> AsioServer::findClient(ClientId clientId) {
+  // 槽位可能已被新连接复用，需核对完整句柄（含代数）
+  size_t index = handleIndex(clientId);
+  if (index >= sessionTable_.size()) {
+    return nullptr;
+  }
+  auto session = std::atomic_load(&sessionTable_[index]);
+  if (!session || session->id != clientId) {
+    return nullptr;
+  }
+  return session;
+}
+
+uint32_t AsioServer::allocateMediaTokenLocked(ClientId clientId) {
+  // 校验位随机且令牌非零，避免被猜测后冒用他人的媒体会话；槽位被复用时校验位也随之更换
+  uint32_t index = handleIndex(clientId);
+  uint32_t token = 0;
+  do {
+    token = (static_cast<uint32_t>(tokenGenerator_()) & ~tokenIndexMask_) | index;
+  } while (token == 0);
+  return token;
+}
+
+void AsioServer::disconnectClient(ClientId clientId) {
+  auto session = findClient(clientId);
+  if (!session) {
+    return;
+  }
   
-  // 异步发送
-  boost::asio::async_write(*clientSocket,
-    boost::asio::buffer(packet),
-    [this, clientId](const boost::system::error_code& error, std::size_t /*length*/) {
-      if (error) {
-        removeClient(clientId);
+  // 有写操作进行中时由写链在队列清空后关闭
+  session->closing = true;
+  boost::asio::post(session->strand,
+    [this, session]() {
+      if (!session->writeQueue.isWriting()) {
+        removeClient(session->id);
       }
     });
-  
-  return true;
 }
 
-void AsioServer::setClientConnectedCallback(std::function<void(const std::string&)> callback) {
+void AsioServer::setClientConnectedCallback(ClientCallback callback) {
   clientConnectedCallback_ = std::move(callback);
 }
 
-void AsioServer::setClientDisconnectedCallback(std::function<void(const std::string&)> callback) {
+void AsioServer::setClientDisconnectedCallback(ClientCallback callback) {
   clientDisconnectedCallback_ = std::move(callback);
 }
 
-void AsioServer::setMessageCallback(std::function<void(const std::string&, const std::vector<uint8_t>&)> callback) {
+void AsioServer::setMessageCallback(ClientMessageCallback callback) {
   messageCallback_ = std::move(callback);
 }
 
 void AsioServer::doAccept() {
   if (!running_) return;
   
-  auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_context_);
-  acceptor_.async_accept(*socket,
-    [this, socket](const boost::system::error_code& error) {
+  // 每个新连接创建独立的strand，见 ClientSession
+  acceptor_.async_accept(
+    [this](const boost::system::error_code& error, boost::asio::ip::tcp::socket socket) {
       if (!error) {
-        // 生成客户端ID
-        std::string clientId = std::to_string(reinterpret_cast<uintptr_t>(socket.get()));
+        auto session = std::make_shared<ClientSession>(std::move(socket), io_context_);
         
-        // 添加到客户端列表
+        // 添加到客户端表，槽位句柄即客户端ID；表满时拒绝该连接
         {
           std::lock_guard<std::mutex> lock(clientsMutex_);
-          clients_[clientId] = socket;
+          session->id = clients_.insert(session);
+          if (session->id != INVALID_HANDLE) {
+            session->mediaToken = allocateMediaTokenLocked(session->id);
+            std::atomic_store(&sessionTable_[handleIndex(session->id)], session);
+          }
         }
         
-        if (clientConnectedCallback_) {
-          clientConnectedCallback_(clientId);
+        if (session->id == INVALID_HANDLE) {
+          VC_LOG_WARN("客户端数量已达上限 " << clients_.capacity() << "，拒绝新连接");
+          boost::system::error_code ec;
+          session->socket.close(ec);
+        } else {
+          NetworkMetrics::instance().clients.add();
+          
+          // 在该连接的strand上通知并开始接收数据
+          boost::asio::dispatch(session->strand,
+            [this, session]() {
+              if (clientConnectedCallback_) {
+                clientConnectedCallback_(session->id);
+              }
+              doReadHeader(session);
+            });
         }
-        
-        // 开始接收数据
-        auto headerBuffer = std::make_shared<std::vector<uint8_t>>(4);
-        boost::asio::async_read(*socket,
-          boost::asio::buffer(*headerBuffer),
-          [this, socket, clientId, headerBuffer](const boost::system::error_code& error, std::size_t /*length*/) {
-            if (!error) {
-              handleClientData(socket, clientId, headerBuffer);
-            } else {
-              removeClient(clientId);
-            }
-          });
       }
       
       doAccept(); // 继续接受新的连接
     });
 }
 
-void AsioServer::removeClient(const std::string& clientId) {
-  std::lock_guard<std::mutex> lock(clientsMutex_);
-  auto it = clients_.find(clientId);
-  if (it != clients_.end()) {
-    it->second->close();
-    clients_.erase(it);
+void AsioServer::removeClient(ClientId clientId) {
+  std::shared_ptr<ClientSession> session;
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    auto* found = clients_.find(clientId);
+    if (!found) {
+      return;
+    }
+    session = std::move(*found);
+    clients_.erase(clientId);
+    std::atomic_store(&sessionTable_[handleIndex(clientId)], std::shared_ptr<ClientSession>());
+  }
+  NetworkMetrics::instance().clients.sub();
+  
+  boost::system::error_code ec;
+  session->socket.close(ec);
+  
+  // 在锁外回调，避免与上层的锁形成顺序反转
+  if (clientDisconnectedCallback_) {
+    clientDisconnectedCallback_(clientId);
+  }
+}
+
+void AsioServer::doReceiveDatagram(std::shared_ptr<DatagramReceiver> receiver) {
+  udpSocket_.async_receive_from(boost::asio::buffer(receiver->buffer), receiver->sender,
+    [this, receiver](const boost::system::error_code& error, std::size_t length) {
+      if (error == boost::asio::error::operation_aborted || !running_) {
+        return;
+      }
+      if (!error) {
+        handleDatagram(*receiver, length);
+      }
+      doReceiveDatagram(receiver);
+    });
+}
+
+void AsioServer::handleDatagram(DatagramReceiver& receiver, size_t length) {
+  if (length < MEDIA_TOKEN_SIZE) {
+    return;
+  }
+  
+  uint32_t token = 0;
+  for (size_t i = 0; i < MEDIA_TOKEN_SIZE; ++i) {
+    token |= (static_cast<uint32_t>(receiver.buffer[i]) << (8 * i));
+  }
+  
+  // 按令牌中的下标找到会话，校验位不符（令牌无效或槽位已被新连接复用）的数据报直接丢弃
+  size_t index = token & tokenIndexMask_;
+  if (index >= sessionTable_.size()) {
+    return;
+  }
+  auto session = std::atomic_load(&sessionTable_[index]);
+  if (!session || session->mediaToken != token) {
+    return;
+  }
+  
+  // 记录客户端的UDP端点（NAT映射可能变化）；探测包只说明上行可用，
+  // 保活包和媒体数据说明客户端也能收到下行数据报
+  bool isProbe = length == MEDIA_TOKEN_SIZE;
+  bool isKeepalive = length == MEDIA_TOKEN_SIZE + 1 && receiver.buffer[MEDIA_TOKEN_SIZE] == MEDIA_KEEPALIVE;
+  {
+    std::lock_guard<std::mutex> lock(session->mediaMutex);
+    session->mediaEndpoint = receiver.sender;
+    if (!isProbe) {
+      session->mediaLastSeen = std::chrono::steady_clock::now();
+    }
+  }
+  
+  // 回复空数据报作为确认
+  if (isProbe || isKeepalive) {
+    sendDatagram(receiver.sender, FramePool::instance().acquire(0));
+    return;
+  }
+  
+  // UDP通道只承载媒体包，加入/离开房间等控制消息必须走有序可靠的TCP连接
+  if (frameTypeOf(receiver.buffer.data() + MEDIA_TOKEN_SIZE, length - MEDIA_TOKEN_SIZE) != FRAME_MEDIA) {
+    return;
+  }
+  
+  NetworkMetrics::instance().udpPacketsIn.add();
+  NetworkMetrics::instance().udpBytesIn.add(length - MEDIA_TOKEN_SIZE);
+  if (messageCallback_) {
+    messageCallback_(session->id, ByteSpan(receiver.buffer.data() + MEDIA_TOKEN_SIZE, length - MEDIA_TOKEN_SIZE));
+  }
+}
+
+void AsioServer::sendDatagram(const boost::asio::ip::udp::endpoint& endpoint, SharedFrame frame) {
+  // 发送可能来自任意线程（广播、保活确认、损伤模拟的定时器），而 asio 的 socket 对象不能并发使用，
+  // 与 sendDatagrams 一样直接在原生描述符上发送；socket 是非阻塞的，缓冲区满时丢弃该数据报
+  auto sendFrame = [this, endpoint, frame]() {
+#ifdef __linux__
+    bool failed = ::sendto(udpSocket_.native_handle(), frame->body(), frame->bodySize(), 0,
+                           endpoint.data(), static_cast<socklen_t>(endpoint.size())) < 0;
+#else
+    boost::system::error_code ec;
+    udpSocket_.send_to(boost::asio::buffer(frame->body(), frame->bodySize()), endpoint, 0, ec);
+    bool failed = static_cast<bool>(ec);
+#endif
+    auto& metrics = NetworkMetrics::instance();
+    if (failed) {
+      metrics.udpSendErrors.add();
+    } else {
+      metrics.udpPacketsOut.add();
+      metrics.udpBytesOut.add(frame->bodySize());
+    }
+  };
+  if (impairment_.enabled()) {
+    impairment_.submit(io_context_.get_executor(), sendFrame);
+  } else {
+    sendFrame();
+  }
+}
+
+void AsioServer::sendDatagrams(const std::vector<boost::asio::ip::udp::endpoint>& endpoints,
+                               const SharedFrame& frame) {
+#ifdef __linux__
+  if (!impairment_.enabled()) {
+    // 所有接收者共享同一个消息体，通过 sendmmsg 一次系统调用发出一批数据报
+    constexpr size_t MAX_BATCH = 64;
+    iovec iov{const_cast<uint8_t*>(frame->body()), frame->bodySize()};
+    std::array<mmsghdr, MAX_BATCH> messages{};
+    int fd = udpSocket_.native_handle();
+    auto& metrics = NetworkMetrics::instance();
     
-    if (clientDisconnectedCallback_) {
-      clientDisconnectedCallback_(clientId);
+    for (size_t offset = 0; offset < endpoints.size(); offset += MAX_BATCH) {
+      size_t count = std::min(MAX_BATCH, endpoints.size() - offset);
+      for (size_t i = 0; i < count; ++i) {
+        const auto& endpoint = endpoints[offset + i];
+        messages[i] = mmsghdr{};
+        messages[i].msg_hdr.msg_name = const_cast<sockaddr*>(endpoint.data());
+        messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(endpoint.size());
+        messages[i].msg_hdr.msg_iov = &iov;
+        messages[i].msg_hdr.msg_iovlen = 1;
+      }
+      
+      size_t sent = 0;
+      while (sent < count) {
+        int result = ::sendmmsg(fd, &messages[sent], static_cast<unsigned int>(count - sent), 0);
+        if (result < 0 && errno == EINTR) {
+          continue;
+        }
+        // 第一条发送失败（如缓冲区满）时跳过它，媒体数据允许丢失
+        if (result > 0) {
+          sent += static_cast<size_t>(result);
+          metrics.udpPacketsOut.add(static_cast<uint64_t>(result));
+          metrics.udpBytesOut.add(static_cast<uint64_t>(result) * frame->bodySize());
+        } else {
+          sent += 1;
+          metrics.udpSendErrors.add();
+        }
+      }
+    }
+    return;
+  }
+#endif
+  for (const auto& endpoint : endpoints) {
+    sendDatagram(endpoint, frame);
+  }
+}
+
+void AsioServer::doReadHeader(std::shared_ptr<ClientSession> session) {
+  boost::asio::async_read(session->socket,
+    boost::asio::buffer(session->headerBuffer),
+    boost::asio::bind_executor(session->strand,
+      [this, session](const boost::system::error_code& error, std::size_t /*length*/) {
+        if (!error) {
+          handleClientData(session);
+        } else {
+          removeClient(session->id);
+        }
+      }));
+}
+
+void AsioServer::doWrite(std::shared_ptr<ClientSession> session) {
+  // 把积压的消息合并为一次 scatter-gather 写
+  if (!session->writeQueue.takeBatch(session->writeBuffers)) {
+    if (session->closing) {
+      removeClient(session->id);
     }
+    return;
   }
+  
+  boost::asio::async_write(session->socket,
+    ConstBufferView(session->writeBuffers),
+    boost::asio::bind_executor(session->strand,
+      [this, session](const boost::system::error_code& error, std::size_t /*length*/) {
+        session->writeQueue.completeBatch();
+        if (!error) {
+          doWrite(session);
+        } else {
+          removeClient(session->id);
+        }
+      }));
 }
 
-void AsioServer::handleClientData(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
-                               const std::string& clientId,
-                               std::shared_ptr<std::vector<uint8_t>> headerBuffer) {
+void AsioServer::handleClientData(std::shared_ptr<ClientSession> session) {
   // 解析数据长度
   uint32_t dataSize = 0;
-  for (int i = 0; i < 4; ++i) {
-    dataSize |= ((*headerBuffer)[i] << (8 * i));
+  for (size_t i = 0; i < FrameBuffer::HEADER_SIZE; ++i) {
+    dataSize |= (static_cast<uint32_t>(session->headerBuffer[i]) << (8 * i));
   }
   
-  // 准备接收数据
-  auto dataBuffer = std::make_shared<std::vector<uint8_t>>(dataSize);
-  boost::asio::async_read(*socket,
-    boost::asio::buffer(*dataBuffer),
-    [this, socket, clientId, dataBuffer, headerBuffer](const boost::system::error_code& error, std::size_t /*length*/) {
-      if (!error) {
-        if (messageCallback_) {
-          messageCallback_(clientId, *dataBuffer);
+  // 长度头来自不可信的客户端，超过上限时直接断开，不按该长度分配内存
+  if (dataSize > maxFrameSize_) {
+    VC_LOG_WARN("客户端 " << session->id << " 的消息长度 " << dataSize << " 超过上限 "
+                << maxFrameSize_ << "，断开连接");
+    removeClient(session->id);
+    return;
+  }
+  
+  // 读入该连接复用的缓冲区，容量足够时不分配内存
+  session->readBuffer.resize(dataSize);
+  boost::asio::async_read(session->socket,
+    boost::asio::buffer(session->readBuffer),
+    boost::asio::bind_executor(session->strand,
+      [this, session](const boost::system::error_code& error, std::size_t /*length*/) {
+        if (!error) {
+          NetworkMetrics::instance().tcpPacketsIn.add();
+          NetworkMetrics::instance().tcpBytesIn.add(FrameBuffer::HEADER_SIZE + session->readBuffer.size());
+          if (messageCallback_) {
+            messageCallback_(session->id, ByteSpan(session->readBuffer));
+          }
+          
+          // 继续读取下一个消息的头部
+          doReadHeader(session);
+        } else {
+          removeClient(session->id);
         }
-        
-        // 继续读取下一个消息的头部
-        boost::asio::async_read(*socket,
-          boost::asio::buffer(*headerBuffer),
-          [this, socket, clientId, headerBuffer](const boost::system::error_code& error, std::size_t /*length*/) {
-            if (!error) {
-              handleClientData(socket, clientId, headerBuffer);
-            } else {
-              removeClient(clientId);
-            }
-          });
-      } else {
-        removeClient(clientId);
-      }
-    });
+      }));
 }
 
-} // namespace voicechat 
\ No newline at end of file
+} // namespace voicechat
@@ -1,15 +1,30 @@
 #include "audio_device.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <iostream>
 
 namespace voicechat {
 
+namespace {
+
+Counter& xrunCounter(bool isInput) {
+    return MetricsRegistry::instance().counter(
+        "voicechat_audio_xruns_total",
+        "Audio buffer overflows (capture) and underruns (playback)",
+        isInput ? "stream=\"capture\"" : "stream=\"playback\"");
+}
+
+} // namespace
+
 PortAudioDevice::PortAudioDevice(bool isInput)
     : isInput_(isInput)
     , sampleRate_(44100)
     , channels_(2)
     , stream_(nullptr)
-    , buffer_(BUFFER_SIZE)
+    , running_(false)
+    , xruns_(xrunCounter(isInput))
 {
     // 初始化PortAudio
     PaError err = Pa_Initialize();
@@ -20,12 +35,23 @@ PortAudioDevice::PortAudioDevice(bool isInput)
 
 PortAudioDevice::~PortAudioDevice() {
     stop();
+    if (stream_) {
+        Pa_CloseStream(stream_);
+        stream_ = nullptr;
+    }
     Pa_Terminate();
 }
 
 bool PortAudioDevice::initialize(int sampleRate, int channels) {
+    if (stream_) {
+        stop();
+        Pa_CloseStream(stream_);
+        stream_ = nullptr;
+    }
+
     sampleRate_ = sampleRate;
     channels_ = channels;
+    ring_ = std::make_unique<SpscRing<float>>(static_cast<size_t>(sampleRate_) * channels_ * RING_MILLISECONDS / 1000);
     
     PaStreamParameters parameters{};
     parameters.device = isInput_ ? Pa_GetDefaultInputDevice() : Pa_GetDefaultOutputDevice();
@@ -41,7 +67,7 @@ bool PortAudioDevice::initialize(int sampleRate, int channels) {
         isInput_ ? &parameters : nullptr,    // 输入参数
         isInput_ ? nullptr : &parameters,    // 输出参数
         sampleRate_,                         // 采样率
-        BUFFER_SIZE,                         // 每次回调的帧数
+        paFramesPerBufferUnspecified,        // 每次回调的帧数由驱动决定，延迟最低
         paClipOff,                          // 不裁剪
         paCallback,                         // 回调函数
         this                                // 用户数据
@@ -52,18 +78,30 @@ bool PortAudioDevice::initialize(int sampleRate, int channels) {
 
 bool PortAudioDevice::start() {
     if (!stream_) return false;
+    if (running_) return true;
     
     PaError err = Pa_StartStream(stream_);
-    return err == paNoError;
+    if (err != paNoError) {
+        return false;
+    }
+    if (isInput_) {
+        running_ = true;
+        captureThread_ = std::thread([this] { captureLoop(); });
+    }
+    return true;
 }
 
 bool PortAudioDevice::stop() {
     if (!stream_) return false;
     
-    PaError err = Pa_StopStream(stream_);
-    if (err == paNoError) {
-        err = Pa_CloseStream(stream_);
-        stream_ = nullptr;
+    // 流保持打开，重新加入房间时可以直接 start
+    PaError err = paNoError;
+    if (Pa_IsStreamActive(stream_) == 1) {
+        err = Pa_StopStream(stream_);
+    }
+    running_ = false;
+    if (captureThread_.joinable()) {
+        captureThread_.join();
     }
     return err == paNoError;
 }
@@ -73,36 +111,212 @@ void PortAudioDevice::setCallback(AudioCallback callback) {
     callback_ = std::move(callback);
 }
 
+void PortAudioDevice::write(const std::vector<float>& samples) {
+    if (!ring_) {
+        return;
+    }
+    if (ring_->write(samples.data(), samples.size()) < samples.size()) {
+        // 播放端消费不及时，丢弃放不下的部分
+        xruns_.add();
+    }
+}
+
 int PortAudioDevice::paCallback(const void* inputBuffer, void* outputBuffer,
                                unsigned long framesPerBuffer,
-                               const PaStreamCallbackTimeInfo* timeInfo,
+                               const PaStreamCallbackTimeInfo* /*timeInfo*/,
                                PaStreamCallbackFlags statusFlags,
                                void* userData) {
     auto* device = static_cast<PortAudioDevice*>(userData);
     device->processAudio(
         static_cast<const float*>(inputBuffer),
         static_cast<float*>(outputBuffer),
-        framesPerBuffer
+        framesPerBuffer,
+        statusFlags
     );
     return paContinue;
 }
 
-void PortAudioDevice::processAudio(const float* input, float* output, unsigned long frameCount) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (isInput_ && callback_ && input) {
-        // 处理输入
-        std::vector<float> inputData(input, input + frameCount * channels_);
-        callback_(inputData);
-    } else if (!isInput_ && output) {
-        // 处理输出
-        std::fill_n(output, frameCount * channels_, 0.0f);
-        if (!buffer_.empty()) {
-            size_t copySize = std::min(buffer_.size(), static_cast<size_t>(frameCount * channels_));
-            std::copy_n(buffer_.begin(), copySize, output);
-            buffer_.erase(buffer_.begin(), buffer_.begin() + copySize);
+void PortAudioDevice::processAudio(const float* input, float* output, unsigned long frameCount,
+                                   PaStreamCallbackFlags statusFlags) {
+    // 运行在实时音频线程：只读写环形缓冲和原子计数，不加锁、不分配内存
+    size_t samples = static_cast<size_t>(frameCount) * channels_;
+    if (isInput_) {
+        bool xrun = (statusFlags & paInputOverflow) != 0;
+        if (input && ring_->write(input, samples) < samples) {
+            // 采集线程来不及取走数据
+            xrun = true;
+        }
+        if (xrun) {
+            xruns_.add();
+        }
+    } else if (output) {
+        bool xrun = (statusFlags & paOutputUnderflow) != 0;
+        size_t copied = ring_->read(output, samples);
+        if (copied < samples) {
+            std::fill_n(output + copied, samples - copied, 0.0f);
+            // 缓冲完全为空是正常的静默，播放到一半数据耗尽才算欠载
+            xrun = xrun || copied > 0;
+        }
+        if (xrun) {
+            xruns_.add();
+        }
+    }
+}
+
+void PortAudioDevice::captureLoop() {
+    std::vector<float> block;
+    block.reserve(ring_->capacity());
+    while (running_) {
+        size_t available = ring_->readAvailable();
+        if (available == 0) {
+            std::this_thread::sleep_for(CAPTURE_POLL_INTERVAL);
+            continue;
+        }
+        block.resize(available);  // 不超过预留的容量，不会重新分配
+        ring_->read(block.data(), block.size());
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (callback_) {
+            callback_(block);
+        }
+    }
+}
+
+PortAudioDuplexDevice::PortAudioDuplexDevice()
+    : sampleRate_(48000)
+    , channels_(1)
+    , stream_(nullptr)
+    , running_(false)
+    , captureXruns_(xrunCounter(true))
+    , playbackXruns_(xrunCounter(false))
+{
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        throw std::runtime_error("Failed to initialize PortAudio: " + std::string(Pa_GetErrorText(err)));
+    }
+}
+
+PortAudioDuplexDevice::~PortAudioDuplexDevice() {
+    stop();
+    if (stream_) {
+        Pa_CloseStream(stream_);
+        stream_ = nullptr;
+    }
+    Pa_Terminate();
+}
+
+bool PortAudioDuplexDevice::initialize(int sampleRate, int channels) {
+    if (stream_) {
+        // 流在设备的整个生命周期内保持打开
+        return sampleRate == sampleRate_ && channels == channels_;
+    }
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+
+    PaDeviceIndex inputDevice = Pa_GetDefaultInputDevice();
+    PaDeviceIndex outputDevice = Pa_GetDefaultOutputDevice();
+    if (inputDevice == paNoDevice || outputDevice == paNoDevice) {
+        return false;
+    }
+
+    PaStreamParameters input{};
+    input.device = inputDevice;
+    input.channelCount = channels_;
+    input.sampleFormat = paFloat32;
+    input.suggestedLatency = Pa_GetDeviceInfo(inputDevice)->defaultLowInputLatency;
+    input.hostApiSpecificStreamInfo = nullptr;
+
+    PaStreamParameters output{};
+    output.device = outputDevice;
+    output.channelCount = channels_;
+    output.sampleFormat = paFloat32;
+    output.suggestedLatency = Pa_GetDeviceInfo(outputDevice)->defaultLowOutputLatency;
+    output.hostApiSpecificStreamInfo = nullptr;
+
+    PaError err = Pa_OpenStream(
+        &stream_,
+        &input,
+        &output,
+        sampleRate_,
+        paFramesPerBufferUnspecified,        // 每次回调的帧数由驱动决定，延迟最低
+        paClipOff,
+        paCallback,
+        this
+    );
+    if (err != paNoError) {
+        stream_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool PortAudioDuplexDevice::start() {
+    if (!stream_) return false;
+    if (running_) return true;
+
+    PaError err = Pa_StartStream(stream_);
+    if (err != paNoError) {
+        return false;
+    }
+    running_ = true;
+    return true;
+}
+
+bool PortAudioDuplexDevice::stop() {
+    if (!stream_) return false;
+
+    // Pa_StopStream 返回时最后一次回调已经结束
+    PaError err = paNoError;
+    if (Pa_IsStreamActive(stream_) == 1) {
+        err = Pa_StopStream(stream_);
+    }
+    running_ = false;
+    return err == paNoError;
+}
+
+void PortAudioDuplexDevice::setCaptureCallback(CaptureCallback callback) {
+    captureCallback_ = std::move(callback);
+}
+
+void PortAudioDuplexDevice::setRenderCallback(RenderCallback callback) {
+    renderCallback_ = std::move(callback);
+}
+
+int PortAudioDuplexDevice::paCallback(const void* inputBuffer, void* outputBuffer,
+                                      unsigned long framesPerBuffer,
+                                      const PaStreamCallbackTimeInfo* /*timeInfo*/,
+                                      PaStreamCallbackFlags statusFlags,
+                                      void* userData) {
+    auto* device = static_cast<PortAudioDuplexDevice*>(userData);
+    device->processAudio(
+        static_cast<const float*>(inputBuffer),
+        static_cast<float*>(outputBuffer),
+        framesPerBuffer,
+        statusFlags
+    );
+    return paContinue;
+}
+
+void PortAudioDuplexDevice::processAudio(const float* input, float* output, unsigned long frameCount,
+                                         PaStreamCallbackFlags statusFlags) {
+    // 运行在实时音频线程：回调只读写无锁环形缓冲和原子计数，不加锁、不分配内存
+    size_t samples = static_cast<size_t>(frameCount) * channels_;
+    if (statusFlags & paInputOverflow) {
+        captureXruns_.add();
+    }
+    if (statusFlags & paOutputUnderflow) {
+        playbackXruns_.add();
+    }
+
+    if (input && captureCallback_) {
+        captureCallback_(input, samples);
+    }
+    if (output) {
+        if (renderCallback_) {
+            renderCallback_(output, samples);
+        } else {
+            std::fill_n(output, samples, 0.0f);
         }
     }
 }
 
-} // namespace voicechat 
\ No newline at end of file
+} // namespace voicechat
@@ -1,4 +1,6 @@
 #include "voice_client.hpp"
+#include "headless_audio_device.hpp"
+#include "metrics.hpp"
 #include <iostream>
 #include <string>
 #include <thread>
@@ -6,6 +8,8 @@
 #include <sstream>
 #include <limits>
 #include <iomanip>
+#include <cstdlib>
+#include <cmath>
 
 using namespace voicechat;
 
@@ -21,6 +25,7 @@ void printHelp(VoiceClient& client) {
     std::cout << "  leave - 离开当前房间" << std::endl;
     std::cout << "  mute - 静音" << std::endl;
     std::cout << "  unmute - 取消静音" << std::endl;
+    std::cout << "  mix <on|off> - 开启/关闭当前房间的服务器混音" << std::endl;
     std::cout << "  quit - 退出程序" << std::endl;
     std::cout << "  help - 显示此帮助信息" << std::endl;
     std::cout << std::endl;
@@ -86,6 +91,19 @@ void processCommand(VoiceClient& client, const std::string& line) {
         client.setMuted(false);
         std::cout << "已取消静音" << std::endl;
     }
+    else if (command == "mix") {
+        std::string mode;
+        iss >> mode;
+        if (mode != "on" && mode != "off") {
+            std::cout << "用法: mix <on|off>" << std::endl;
+            return;
+        }
+        if (client.setRoomMixing(mode == "on")) {
+            std::cout << (mode == "on" ? "已开启服务器混音" : "已关闭服务器混音") << std::endl;
+        } else {
+            std::cout << "设置混音模式失败" << std::endl;
+        }
+    }
     else if (command == "quit") {
         throw std::runtime_error("quit");  // 使用异常来退出主循环
     }
@@ -109,8 +127,29 @@ int main(int argc, char* argv[]) {
         std::string host = argv[2];
         uint16_t port = static_cast<uint16_t>(std::stoi(argv[3]));
 
+        // 音频设备由环境变量选择，默认使用声卡：
+        // VOICECHAT_AUDIO_INPUT  为 portaudio、tone[:频率]、noise、silence 或 file:路径
+        // VOICECHAT_AUDIO_OUTPUT 为 portaudio、null 或 file:路径
+        // VOICECHAT_AUDIO_CLOCK  为 realtime（默认）或 fast，决定文件和信号设备是否按实际时长运行
+        AudioClock clock = AudioClock::RealTime;
+        if (const char* value = std::getenv("VOICECHAT_AUDIO_CLOCK")) {
+            clock = std::string(value) == "fast" ? AudioClock::AsFastAsPossible : AudioClock::RealTime;
+        }
+        const char* input = std::getenv("VOICECHAT_AUDIO_INPUT");
+        const char* output = std::getenv("VOICECHAT_AUDIO_OUTPUT");
+
         // 创建客户端实例
-        VoiceClient client(userId);
+        // 两者都是声卡时使用一个全双工流，否则以输入设备为时钟驱动播放
+        VoiceClient client(userId, createDuplexAudioDevice(input ? input : "", output ? output : "", clock));
+
+        // VOICECHAT_FRAME_MS 设置发送的 Opus 帧长（2.5、5、10、20、40、60），帧越短延迟越低、包头开销越大
+        if (const char* value = std::getenv("VOICECHAT_FRAME_MS")) {
+            auto duration = std::chrono::microseconds(std::lround(std::stod(value) * 1000));
+            if (!client.setFrameDuration(duration)) {
+                std::cerr << "不支持的帧长: " << value << " ms" << std::endl;
+                return 1;
+            }
+        }
 
         // 连接到服务器
         if (!client.connect(host, port)) {
@@ -144,6 +183,8 @@ int main(int argc, char* argv[]) {
         // 断开连接
         client.disconnect();
         std::cout << "已断开连接" << std::endl;
+        // 包含音频设备的溢出/欠载次数（voicechat_audio_xruns_total）
+        std::cout << MetricsRegistry::instance().renderSummary();
 
     } catch (const std::exception& e) {
         std::cerr << "错误: " << e.what() << std::endl;
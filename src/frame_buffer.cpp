@@ -0,0 +1,81 @@
+#include "frame_buffer.hpp"
+#include <cstring>
+
+namespace voicechat {
+
+FrameBuffer::FrameBuffer(FramePool* pool)
+    : refCount_(0)
+    , pool_(pool)
+{
+}
+
+void FrameBuffer::resize(size_t bodySize) {
+    storage_.resize(HEADER_SIZE + bodySize);
+    
+    // 写入长度头（4字节，小端序）
+    uint32_t size = static_cast<uint32_t>(bodySize);
+    for (size_t i = 0; i < HEADER_SIZE; ++i) {
+        storage_[i] = static_cast<uint8_t>((size >> (i * 8)) & 0xFF);
+    }
+}
+
+FramePool::~FramePool() {
+    for (auto* frame : freeFrames_) {
+        delete frame;
+    }
+}
+
+FramePool& FramePool::instance() {
+    static FramePool pool;
+    return pool;
+}
+
+FramePtr FramePool::acquire(size_t bodySize) {
+    FrameBuffer* frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!freeFrames_.empty()) {
+            frame = freeFrames_.back();
+            freeFrames_.pop_back();
+        }
+    }
+    
+    if (!frame) {
+        frame = new FrameBuffer(this);
+    }
+    frame->resize(bodySize);
+    frame->ingestTime_ = std::chrono::steady_clock::time_point();
+    return FramePtr(frame);
+}
+
+void FramePool::release(FrameBuffer* frame) {
+    if (frame->storage_.capacity() <= MAX_CACHED_CAPACITY) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (freeFrames_.size() < MAX_CACHED_FRAMES) {
+            freeFrames_.push_back(frame);
+            return;
+        }
+    }
+    delete frame;
+}
+
+FramePtr makeFrame(const uint8_t* data, size_t size) {
+    FramePtr frame = FramePool::instance().acquire(size);
+    if (size > 0) {
+        std::memcpy(frame->body(), data, size);
+    }
+    return frame;
+}
+
+void intrusive_ptr_add_ref(const FrameBuffer* frame) {
+    frame->refCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(const FrameBuffer* frame) {
+    if (frame->refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        auto* mutableFrame = const_cast<FrameBuffer*>(frame);
+        mutableFrame->pool_->release(mutableFrame);
+    }
+}
+
+} // namespace voicechat
@@ -0,0 +1,484 @@
+#include "headless_audio_device.hpp"
+#include "audio_device.hpp"
+#include "paired_audio_device.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace voicechat {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+uint16_t loadLittleEndian16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t loadLittleEndian32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+void appendLittleEndian16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value & 0xff));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+void appendLittleEndian32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+bool hasRawExtension(const std::string& path) {
+    auto endsWith = [&path](const char* suffix) {
+        size_t length = std::strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    return endsWith(".raw") || endsWith(".pcm");
+}
+
+// 16 位 PCM、44 字节的标准 WAV 文件头，大小字段在关闭时补全
+std::string wavHeader(int sampleRate, int channels, uint32_t dataBytes) {
+    std::string header = "RIFF";
+    appendLittleEndian32(header, 36 + dataBytes);
+    header += "WAVEfmt ";
+    appendLittleEndian32(header, 16);
+    appendLittleEndian16(header, 1);  // PCM
+    appendLittleEndian16(header, static_cast<uint16_t>(channels));
+    appendLittleEndian32(header, static_cast<uint32_t>(sampleRate));
+    appendLittleEndian32(header, static_cast<uint32_t>(sampleRate * channels * 2));
+    appendLittleEndian16(header, static_cast<uint16_t>(channels * 2));
+    appendLittleEndian16(header, 16);
+    header += "data";
+    appendLittleEndian32(header, dataBytes);
+    return header;
+}
+
+} // namespace
+
+HeadlessAudioDevice::HeadlessAudioDevice(bool isInput, AudioClock clock, std::chrono::microseconds period)
+    : sampleRate_(48000)
+    , channels_(1)
+    , isInput_(isInput)
+    , clock_(clock)
+    , period_(period)
+    , blockSamples_(0)
+    , running_(false)
+    , finished_(false)
+{
+}
+
+HeadlessAudioDevice::~HeadlessAudioDevice() {
+    // 派生类在自己的析构函数中调用 stop()，线程此时已经结束
+    stop();
+}
+
+bool HeadlessAudioDevice::initialize(int sampleRate, int channels) {
+    if (sampleRate <= 0 || channels <= 0) {
+        return false;
+    }
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+    blockSamples_ = static_cast<size_t>(static_cast<int64_t>(sampleRate) * period_.count() / 1000000) *
+                    static_cast<size_t>(channels);
+    return open();
+}
+
+bool HeadlessAudioDevice::start() {
+    if (running_ || blockSamples_ == 0) {
+        return false;
+    }
+    running_ = true;
+    // 尽快运行的输出设备在 write() 中直接输出，不需要线程
+    if (isInput_ || clock_ == AudioClock::RealTime) {
+        thread_ = std::thread([this]() {
+            run();
+        });
+    }
+    return true;
+}
+
+bool HeadlessAudioDevice::stop() {
+    bool wasRunning = running_.exchange(false);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (wasRunning) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 实时输出时把剩余的待播放数据写完
+        if (!isInput_ && !pending_.empty()) {
+            play(pending_.data(), pending_.size());
+            pending_.clear();
+        }
+        flush();
+    }
+    return true;
+}
+
+void HeadlessAudioDevice::setCallback(AudioCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = std::move(callback);
+}
+
+void HeadlessAudioDevice::write(const std::vector<float>& samples) {
+    if (isInput_ || !running_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (clock_ == AudioClock::AsFastAsPossible) {
+        play(samples.data(), samples.size());
+    } else {
+        pending_.insert(pending_.end(), samples.begin(), samples.end());
+    }
+}
+
+bool HeadlessAudioDevice::read(float* samples, size_t count) {
+    std::fill_n(samples, count, 0.0f);
+    return true;
+}
+
+void HeadlessAudioDevice::play(const float*, size_t) {
+}
+
+void HeadlessAudioDevice::run() {
+    std::vector<float> block(blockSamples_);
+    auto next = std::chrono::steady_clock::now();
+    while (running_) {
+        if (isInput_) {
+            if (!finished_ && !read(block.data(), block.size())) {
+                finished_ = true;
+                VC_LOG_INFO("音频输入数据已结束");
+                // 尽快运行时没有需要保持的时钟，直接结束
+                if (clock_ == AudioClock::AsFastAsPossible) {
+                    break;
+                }
+            }
+            if (finished_) {
+                std::fill(block.begin(), block.end(), 0.0f);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (callback_) {
+                callback_(block);
+            }
+        } else {
+            // 与声卡一样，每个周期输出一块，待播放数据不足时补静音
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t available = std::min(pending_.size(), block.size());
+            std::copy_n(pending_.begin(), available, block.begin());
+            std::fill(block.begin() + available, block.end(), 0.0f);
+            pending_.erase(pending_.begin(), pending_.begin() + available);
+            play(block.data(), block.size());
+        }
+
+        if (clock_ == AudioClock::RealTime) {
+            // 按绝对时间推进，处理耗时不会累积为漂移
+            next += period_;
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+FileAudioSource::FileAudioSource(std::string path, AudioClock clock, bool loop)
+    : HeadlessAudioDevice(true, clock)
+    , path_(std::move(path))
+    , loop_(loop)
+    , dataBytes_(0)
+    , dataRemaining_(0)
+    , fileChannels_(1)
+    , fileFloat_(false)
+{
+}
+
+FileAudioSource::~FileAudioSource() {
+    stop();
+}
+
+bool FileAudioSource::open() {
+    file_.open(path_, std::ios::binary);
+    if (!file_) {
+        VC_LOG_ERROR("无法打开音频文件: " << path_);
+        return false;
+    }
+
+    if (hasRawExtension(path_)) {
+        fileChannels_ = channels_;
+        fileFloat_ = false;
+        file_.seekg(0, std::ios::end);
+        dataBytes_ = static_cast<uint64_t>(file_.tellg());
+        dataStart_ = 0;
+    } else {
+        // 依次查找 fmt 和 data 块，跳过 LIST 等其他块
+        uint8_t riff[12];
+        if (!file_.read(reinterpret_cast<char*>(riff), sizeof(riff)) ||
+            std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+            VC_LOG_ERROR("不是有效的 WAV 文件: " << path_);
+            return false;
+        }
+        bool haveFormat = false;
+        while (true) {
+            uint8_t chunk[8];
+            if (!file_.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+                VC_LOG_ERROR("WAV 文件缺少数据块: " << path_);
+                return false;
+            }
+            uint32_t chunkSize = loadLittleEndian32(chunk + 4);
+            if (std::memcmp(chunk, "fmt ", 4) == 0) {
+                std::vector<uint8_t> format(std::max<uint32_t>(chunkSize, 16));
+                if (!file_.read(reinterpret_cast<char*>(format.data()), chunkSize)) {
+                    return false;
+                }
+                uint16_t formatTag = loadLittleEndian16(format.data());
+                fileChannels_ = loadLittleEndian16(format.data() + 2);
+                uint32_t sampleRate = loadLittleEndian32(format.data() + 4);
+                uint16_t bits = loadLittleEndian16(format.data() + 14);
+                // 0xFFFE 为 WAVE_FORMAT_EXTENSIBLE，按位深区分整数和浮点
+                if ((formatTag == 1 || formatTag == 0xFFFE) && bits == 16) {
+                    fileFloat_ = false;
+                } else if ((formatTag == 3 || formatTag == 0xFFFE) && bits == 32) {
+                    fileFloat_ = true;
+                } else {
+                    VC_LOG_ERROR("不支持的 WAV 格式（仅支持 16 位整数或 32 位浮点）: " << path_);
+                    return false;
+                }
+                if (static_cast<int>(sampleRate) != sampleRate_ || fileChannels_ < 1 || fileChannels_ > 2) {
+                    VC_LOG_ERROR("WAV 文件的采样率或通道数不受支持: " << sampleRate << " Hz, "
+                                 << fileChannels_ << " 通道，设备为 " << sampleRate_ << " Hz");
+                    return false;
+                }
+                haveFormat = true;
+                if (chunkSize & 1) {
+                    file_.seekg(1, std::ios::cur);
+                }
+            } else if (std::memcmp(chunk, "data", 4) == 0) {
+                if (!haveFormat) {
+                    VC_LOG_ERROR("WAV 文件的数据块位于格式块之前: " << path_);
+                    return false;
+                }
+                dataBytes_ = chunkSize;
+                dataStart_ = file_.tellg();
+                break;
+            } else {
+                file_.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+            }
+        }
+    }
+    file_.clear();
+    file_.seekg(dataStart_);
+    dataRemaining_ = dataBytes_;
+    return true;
+}
+
+bool FileAudioSource::read(float* samples, size_t count) {
+    size_t frames = count / static_cast<size_t>(channels_);
+    if (readFrames(samples, frames)) {
+        return true;
+    }
+    if (!loop_ || dataBytes_ == 0) {
+        return false;
+    }
+    file_.clear();
+    file_.seekg(dataStart_);
+    dataRemaining_ = dataBytes_;
+    return readFrames(samples, frames);
+}
+
+bool FileAudioSource::readFrames(float* samples, size_t frames) {
+    size_t bytesPerSample = fileFloat_ ? 4 : 2;
+    size_t frameBytes = bytesPerSample * static_cast<size_t>(fileChannels_);
+    size_t available = static_cast<size_t>(std::min<uint64_t>(dataRemaining_ / frameBytes, frames));
+    if (available == 0) {
+        return false;
+    }
+    raw_.resize(available * frameBytes);
+    file_.read(reinterpret_cast<char*>(raw_.data()), static_cast<std::streamsize>(raw_.size()));
+    available = static_cast<size_t>(file_.gcount()) / frameBytes;
+    if (available == 0) {
+        return false;
+    }
+    dataRemaining_ -= available * frameBytes;
+
+    auto sampleAt = [this, bytesPerSample](size_t index) {
+        const uint8_t* data = raw_.data() + index * bytesPerSample;
+        if (fileFloat_) {
+            uint32_t bits = loadLittleEndian32(data);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        return static_cast<int16_t>(loadLittleEndian16(data)) / 32768.0f;
+    };
+    // 单声道和立体声之间转换：立体声转单声道取平均，单声道转立体声复制到两个声道
+    for (size_t frame = 0; frame < available; ++frame) {
+        for (int channel = 0; channel < channels_; ++channel) {
+            float value;
+            if (fileChannels_ == channels_) {
+                value = sampleAt(frame * fileChannels_ + channel);
+            } else if (fileChannels_ == 1) {
+                value = sampleAt(frame);
+            } else {
+                value = 0.5f * (sampleAt(frame * 2) + sampleAt(frame * 2 + 1));
+            }
+            samples[frame * channels_ + channel] = value;
+        }
+    }
+    // 文件末尾不足一个周期时补静音
+    std::fill(samples + available * channels_, samples + frames * channels_, 0.0f);
+    return true;
+}
+
+FileAudioSink::FileAudioSink(std::string path, AudioClock clock)
+    : HeadlessAudioDevice(false, clock)
+    , path_(std::move(path))
+    , wav_(!hasRawExtension(path_))
+    , dataBytes_(0)
+{
+}
+
+FileAudioSink::~FileAudioSink() {
+    stop();
+}
+
+bool FileAudioSink::open() {
+    file_.open(path_, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        VC_LOG_ERROR("无法创建音频文件: " << path_);
+        return false;
+    }
+    dataBytes_ = 0;
+    if (wav_) {
+        std::string header = wavHeader(sampleRate_, channels_, 0);
+        file_.write(header.data(), static_cast<std::streamsize>(header.size()));
+    }
+    return true;
+}
+
+void FileAudioSink::play(const float* samples, size_t count) {
+    if (!file_.is_open()) {
+        return;
+    }
+    // 转换为 16 位小端整数
+    converted_.resize(count * 2);
+    for (size_t i = 0; i < count; ++i) {
+        float clamped = std::max(-1.0f, std::min(1.0f, samples[i]));
+        uint16_t bits = static_cast<uint16_t>(static_cast<int16_t>(std::lrint(clamped * 32767.0f)));
+        converted_[i * 2] = static_cast<uint8_t>(bits & 0xff);
+        converted_[i * 2 + 1] = static_cast<uint8_t>(bits >> 8);
+    }
+    file_.write(reinterpret_cast<const char*>(converted_.data()), static_cast<std::streamsize>(converted_.size()));
+    dataBytes_ += count * 2;
+}
+
+void FileAudioSink::flush() {
+    if (!file_.is_open()) {
+        return;
+    }
+    // 每次停止时补全文件头，之后再次启动时继续追加
+    if (wav_) {
+        std::string header = wavHeader(sampleRate_, channels_, static_cast<uint32_t>(dataBytes_));
+        file_.seekp(0);
+        file_.write(header.data(), static_cast<std::streamsize>(header.size()));
+        file_.seekp(0, std::ios::end);
+    }
+    file_.flush();
+}
+
+SignalGenerator::SignalGenerator(Signal signal, AudioClock clock, double frequency, double amplitude)
+    : HeadlessAudioDevice(true, clock)
+    , signal_(signal)
+    , frequency_(frequency)
+    , amplitude_(amplitude)
+    , position_(0)
+    , noiseState_(0x12345678u)
+    , lowpass_(0.0f)
+{
+}
+
+SignalGenerator::~SignalGenerator() {
+    stop();
+}
+
+float SignalGenerator::nextNoise() {
+    noiseState_ = noiseState_ * 1664525u + 1013904223u;
+    return static_cast<float>(noiseState_ >> 8) / static_cast<float>(1u << 23) - 1.0f;
+}
+
+bool SignalGenerator::read(float* samples, size_t count) {
+    // 类语音信号：1.6 秒发言、0.4 秒停顿交替，发言期间按每秒 4 个音节起伏，
+    // 由 150Hz 的浊音和低通噪声组成，能触发编码器的 DTX 和服务器的发言者选择
+    constexpr double TALK_SECONDS = 1.6;
+    constexpr double CYCLE_SECONDS = 2.0;
+    constexpr double SYLLABLE_RATE = 4.0;
+    constexpr double PITCH = 150.0;
+
+    size_t frames = count / static_cast<size_t>(channels_);
+    for (size_t frame = 0; frame < frames; ++frame, ++position_) {
+        double t = static_cast<double>(position_) / sampleRate_;
+        float value = 0.0f;
+        switch (signal_) {
+            case Signal::Tone:
+                value = static_cast<float>(amplitude_ * std::sin(2.0 * PI * frequency_ * t));
+                break;
+            case Signal::SpeechNoise: {
+                lowpass_ += 0.2f * (nextNoise() - lowpass_);
+                double phase = std::fmod(t, CYCLE_SECONDS);
+                double envelope = phase < TALK_SECONDS ? 0.5 * (1.0 - std::cos(2.0 * PI * SYLLABLE_RATE * phase)) : 0.0;
+                double voiced = 0.6 * std::sin(2.0 * PI * PITCH * t) + 0.3 * std::sin(2.0 * PI * 2.0 * PITCH * t);
+                value = static_cast<float>(amplitude_ * envelope * (voiced + 2.0 * lowpass_));
+                break;
+            }
+            case Signal::Silence:
+                break;
+        }
+        for (int channel = 0; channel < channels_; ++channel) {
+            samples[frame * channels_ + channel] = value;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<IAudioDevice> createAudioDevice(const std::string& spec, bool isInput, AudioClock clock) {
+    std::string kind = spec.substr(0, spec.find(':'));
+    std::string argument = spec.find(':') == std::string::npos ? "" : spec.substr(spec.find(':') + 1);
+
+    if (spec.empty() || spec == "portaudio") {
+        return std::make_unique<PortAudioDevice>(isInput);
+    }
+    if (kind == "file" && !argument.empty()) {
+        if (isInput) {
+            return std::make_unique<FileAudioSource>(argument, clock);
+        }
+        return std::make_unique<FileAudioSink>(argument, clock);
+    }
+    if (isInput && kind == "tone") {
+        double frequency = argument.empty() ? 440.0 : std::stod(argument);
+        return std::make_unique<SignalGenerator>(SignalGenerator::Signal::Tone, clock, frequency);
+    }
+    if (isInput && spec == "noise") {
+        return std::make_unique<SignalGenerator>(SignalGenerator::Signal::SpeechNoise, clock);
+    }
+    if (isInput && spec == "silence") {
+        return std::make_unique<SignalGenerator>(SignalGenerator::Signal::Silence, clock);
+    }
+    if (!isInput && spec == "null") {
+        return std::make_unique<NullAudioSink>(clock);
+    }
+    throw std::invalid_argument("invalid audio " + std::string(isInput ? "input" : "output") + " device: " + spec);
+}
+
+std::unique_ptr<IDuplexAudioDevice> createDuplexAudioDevice(const std::string& inputSpec,
+                                                            const std::string& outputSpec, AudioClock clock) {
+    auto isSoundCard = [](const std::string& spec) {
+        return spec.empty() || spec == "portaudio";
+    };
+    if (isSoundCard(inputSpec) && isSoundCard(outputSpec)) {
+        return std::make_unique<PortAudioDuplexDevice>();
+    }
+    return std::make_unique<PairedAudioDevice>(createAudioDevice(inputSpec, true, clock),
+                                               createAudioDevice(outputSpec, false, clock));
+}
+
+} // namespace voicechat
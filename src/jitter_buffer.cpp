@@ -0,0 +1,220 @@
+#include "jitter_buffer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace voicechat {
+
+JitterBuffer::JitterBuffer(std::chrono::milliseconds minDelay, std::chrono::milliseconds maxDelay)
+    : minDelayMs_(static_cast<double>(minDelay.count()))
+    , maxDelayMs_(static_cast<double>(maxDelay.count()))
+    , buffered_(0)
+    , playing_(false)
+    , started_(false)
+    , playedSequence_(0)
+    , nextSequence_(0)
+    , highestSequence_(0)
+    , concealRun_(0)
+    , frameSamples_(MEDIA_CLOCK_RATE / 50)
+    , hasLast_(false)
+    , lastSequence_(0)
+    , lastTimestamp_(0)
+    , lastArrival_(0.0)
+    , jitter_(0.0)
+    , targetMs_(static_cast<double>(minDelay.count()))
+    , epoch_(Clock::now())
+{
+}
+
+void JitterBuffer::push(const MediaHeader& header, ByteSpan payload, Clock::time_point arrival) {
+    updateJitter(header, arrival);
+
+    uint16_t sequence = header.sequence;
+    if (started_) {
+        int sincePlayed = static_cast<int16_t>(sequence - playedSequence_);
+        if (sincePlayed < 0 && sincePlayed >= -static_cast<int>(SLOTS)) {
+            // 迟到说明目标延迟偏小，立即增加一帧
+            ++stats_.late;
+            targetMs_ = std::min(targetMs_ + frameMillis(), maxDelayMs_);
+            return;
+        }
+    }
+
+    if (buffered_ == 0) {
+        if (!playing_) {
+            nextSequence_ = sequence;
+        }
+        highestSequence_ = sequence;
+    }
+
+    int offset = static_cast<int16_t>(sequence - nextSequence_);
+    if (offset < 0 && !playing_ && offset >= -static_cast<int>(SLOTS) &&
+        static_cast<uint16_t>(highestSequence_ - sequence) < SLOTS) {
+        // 开始播放前收到更早的包，作为新的起点
+        nextSequence_ = sequence;
+        offset = 0;
+    }
+    if (offset < 0 || offset >= static_cast<int>(SLOTS)) {
+        // 序列号跳变（发送端重新开始或长时间中断），丢弃缓冲重新积累
+        clear();
+        nextSequence_ = sequence;
+        highestSequence_ = sequence;
+    }
+
+    Slot& slot = slotFor(sequence);
+    if (slot.filled) {
+        return;  // 重复的包
+    }
+    slot.filled = true;
+    slot.sequence = sequence;
+    slot.audioLevel = header.audioLevel;
+    slot.payload.assign(payload.begin(), payload.end());
+    ++buffered_;
+    if (static_cast<int16_t>(sequence - highestSequence_) > 0) {
+        highestSequence_ = sequence;
+    }
+}
+
+JitterBuffer::Playout JitterBuffer::pop(std::vector<uint8_t>& payload) {
+    if (!playing_) {
+        if (buffered_ == 0 || static_cast<double>(bufferedFrames()) * frameMillis() < targetMs_) {
+            return Playout::Empty;
+        }
+        playing_ = true;
+        started_ = true;
+        concealRun_ = 0;
+    }
+
+    // 缓冲比目标深两个调整步长以上时跳过缺失的帧、丢弃安静的帧以追回延迟，超过最大延迟时不论电平都丢弃；
+    // 服务器抑制静音帧造成的序列号空洞也在这里跳过，而不是逐帧补偿
+    while (buffered_ > 0) {
+        double delay = static_cast<double>(bufferedFrames()) * frameMillis();
+        if (delay <= targetMs_ + 2 * adaptStepMillis()) {
+            break;
+        }
+        Slot& slot = slotFor(nextSequence_);
+        bool present = has(nextSequence_);
+        if (present && (buffered_ == 1 || (slot.audioLevel > QUIET_LEVEL && delay <= maxDelayMs_))) {
+            break;
+        }
+        if (present) {
+            slot.filled = false;
+            --buffered_;
+            ++stats_.discarded;
+        }
+        ++nextSequence_;
+    }
+
+    // 缓冲比目标浅一个调整步长以上时拉伸：补偿一帧但不前进，等待迟到的包或借安静的帧积累延迟
+    bool shallow = static_cast<double>(bufferedFrames()) * frameMillis() + adaptStepMillis() <= targetMs_;
+    uint16_t next = static_cast<uint16_t>(nextSequence_ + 1);
+    if (has(nextSequence_) && !(shallow && slotFor(nextSequence_).audioLevel <= QUIET_LEVEL)) {
+        take(nextSequence_, payload);
+        concealRun_ = 0;
+        ++stats_.packets;
+        ++nextSequence_;
+        playedSequence_ = nextSequence_;
+        return Playout::Packet;
+    }
+    if (buffered_ == 0 && concealRun_ * frameMillis() >= MAX_CONCEAL_MS) {
+        // 发言已结束，回到缓冲状态
+        playing_ = false;
+        return Playout::Empty;
+    }
+    ++concealRun_;
+    if (!has(nextSequence_) && has(next)) {
+        // 下一包还留在缓冲中，到时正常播放
+        const Slot& slot = slotFor(next);
+        payload.assign(slot.payload.begin(), slot.payload.end());
+        ++stats_.fec;
+        ++nextSequence_;
+        playedSequence_ = nextSequence_;
+        return Playout::Fec;
+    }
+    payload.clear();
+    ++stats_.concealed;
+    if (!shallow) {
+        ++nextSequence_;
+        playedSequence_ = nextSequence_;
+    }
+    return Playout::Conceal;
+}
+
+std::chrono::milliseconds JitterBuffer::currentDelay() const {
+    return std::chrono::milliseconds(std::lround(static_cast<double>(bufferedFrames()) * frameMillis()));
+}
+
+std::chrono::milliseconds JitterBuffer::targetDelay() const {
+    return std::chrono::milliseconds(std::lround(targetMs_));
+}
+
+double JitterBuffer::jitterMillis() const {
+    return jitter_ * 1000.0 / MEDIA_CLOCK_RATE;
+}
+
+bool JitterBuffer::has(uint16_t sequence) const {
+    const Slot& slot = slots_[sequence & (SLOTS - 1)];
+    return slot.filled && slot.sequence == sequence;
+}
+
+void JitterBuffer::take(uint16_t sequence, std::vector<uint8_t>& payload) {
+    Slot& slot = slotFor(sequence);
+    payload.swap(slot.payload);
+    slot.filled = false;
+    --buffered_;
+}
+
+void JitterBuffer::clear() {
+    for (Slot& slot : slots_) {
+        slot.filled = false;
+    }
+    buffered_ = 0;
+    playing_ = false;
+}
+
+void JitterBuffer::updateJitter(const MediaHeader& header, Clock::time_point arrival) {
+    double arrivalSamples = std::chrono::duration<double>(arrival - epoch_).count() * MEDIA_CLOCK_RATE;
+    if (hasLast_) {
+        if (static_cast<uint16_t>(header.sequence - lastSequence_) == 1) {
+            uint32_t samples = header.timestamp - lastTimestamp_;
+            // Opus 帧长为 2.5ms 到 60ms
+            if (samples >= MEDIA_CLOCK_RATE / 400 && samples <= MEDIA_CLOCK_RATE * 60 / 1000) {
+                frameSamples_ = samples;
+            }
+        }
+        // 相对传输时间之差 D(i-1, i)，超过最大延迟的跳变（如静音后恢复发送）不计入
+        double difference = (arrivalSamples - lastArrival_) -
+                            static_cast<int32_t>(header.timestamp - lastTimestamp_);
+        if (std::abs(difference) * 1000.0 / MEDIA_CLOCK_RATE <= maxDelayMs_) {
+            jitter_ += (std::abs(difference) - jitter_) / 16.0;
+        }
+    }
+    hasLast_ = true;
+    lastSequence_ = header.sequence;
+    lastTimestamp_ = header.timestamp;
+    lastArrival_ = arrivalSamples;
+
+    // 抖动变大时立即提高目标延迟，变小时缓慢降低，避免频繁调整
+    double wanted = std::clamp(frameMillis() + JITTER_MULTIPLIER * jitterMillis(), minDelayMs_, maxDelayMs_);
+    if (wanted > targetMs_) {
+        targetMs_ = wanted;
+    } else {
+        targetMs_ += (wanted - targetMs_) / 64.0;
+    }
+}
+
+double JitterBuffer::frameMillis() const {
+    return frameSamples_ * 1000.0 / MEDIA_CLOCK_RATE;
+}
+
+double JitterBuffer::adaptStepMillis() const {
+    return std::max(frameMillis(), MIN_ADAPT_STEP_MS);
+}
+
+size_t JitterBuffer::bufferedFrames() const {
+    if (buffered_ == 0) {
+        return 0;
+    }
+    return static_cast<uint16_t>(highestSequence_ - nextSequence_) + 1;
+}
+
+} // namespace voicechat
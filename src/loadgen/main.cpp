@@ -0,0 +1,527 @@
+// 无界面的负载生成器：少量线程模拟大量客户端，使用真实的协议向 voice_server 发送预先编码的
+// Opus 帧，统计端到端的转发延迟、丢包率和吞吐量
+#include "protocol.hpp"
+#include "frame_buffer.hpp"
+#include "metrics.hpp"
+#include "opus_codec.hpp"
+#include "voice_message.pb.h"
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace voicechat;
+using boost::asio::ip::tcp;
+
+namespace {
+
+// 客户端发送间隔与 Opus 帧长一致
+constexpr auto FRAME_INTERVAL = std::chrono::milliseconds(20);
+// 定时器粒度：客户端按下标分散到各个时隙，避免所有客户端在同一时刻发送
+constexpr auto SLOT_INTERVAL = std::chrono::milliseconds(1);
+constexpr size_t SLOTS = FRAME_INTERVAL / SLOT_INTERVAL;
+// 预先编码的帧数，循环发送
+constexpr size_t ENCODED_FRAMES = 50;
+// 每个发送者保留最近的发送时间，按序列号取模存放；超过该窗口仍未收到的包不计延迟
+constexpr size_t SEND_TIME_WINDOW = 256;
+// 停止发送后等待在途数据到达的时间
+constexpr auto DRAIN_TIME = std::chrono::seconds(1);
+// 所有客户端完成加入的最长等待时间
+constexpr auto JOIN_TIMEOUT = std::chrono::seconds(30);
+constexpr double PI = 3.14159265358979323846;
+
+struct Options {
+  std::string host;
+  uint16_t port = 0;
+  size_t clients = 100;
+  size_t rooms = 10;
+  size_t seconds = 30;
+  size_t threads = 2;
+  size_t speakers = 0;  // 每个房间的发言者数，0 表示所有客户端都发言
+};
+
+// 全部客户端共享的统计，Counter 与 Histogram 按线程分片，记录时不加锁
+struct LoadStats {
+  Counter sent;
+  Counter sendSkipped;   // 上一帧尚未写完，客户端本身跟不上时跳过的帧
+  Counter expected;      // 按发送时房间人数计算的应收帧数
+  Counter received;
+  Counter receivedBytes;
+  Counter unknownSource;
+  Counter disconnects;
+  Histogram latency;     // 纳秒
+};
+
+struct SendTimes {
+  std::array<std::atomic<int64_t>, SEND_TIME_WINDOW> nanos{};
+};
+
+int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 预先编码的音频：440Hz 正弦加少量噪声，避免 Opus 把数据当作静音
+struct EncodedAudio {
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<uint8_t> levels;
+
+  void prepare() {
+    OpusCodec codec;
+    if (!codec.initialize(MEDIA_CLOCK_RATE, 1)) {
+      throw std::runtime_error("failed to initialize Opus encoder");
+    }
+    const size_t samplesPerFrame = MEDIA_CLOCK_RATE / 50;
+    std::vector<float> pcm(samplesPerFrame);
+    uint32_t noise = 12345;
+    for (size_t f = 0; f < ENCODED_FRAMES; ++f) {
+      for (size_t i = 0; i < samplesPerFrame; ++i) {
+        double t = static_cast<double>(f * samplesPerFrame + i) / MEDIA_CLOCK_RATE;
+        noise = noise * 1664525u + 1013904223u;
+        pcm[i] = static_cast<float>(0.3 * std::sin(2.0 * PI * 440.0 * t) +
+                                    0.02 * (static_cast<double>(noise >> 8) / (1u << 24) - 0.5));
+      }
+      frames.push_back(codec.encode(pcm));
+      levels.push_back(static_cast<uint8_t>(audioLevelOf(pcm.data(), pcm.size())));
+    }
+  }
+};
+
+// 一个模拟的客户端，只在所属 Worker 的线程上访问
+struct SimClient {
+  SimClient(boost::asio::io_context& context, size_t clientIndex, size_t roomIndex, bool isSpeaker)
+      : socket(context), index(clientIndex), room(roomIndex), speaker(isSpeaker) {}
+
+  tcp::socket socket;
+  size_t index;
+  size_t room;
+  bool speaker;
+  bool open = false;
+  bool joined = false;
+  bool writing = false;
+  uint32_t sourceId = 0;
+  uint16_t sequence = 0;
+  int responses = 0;
+  std::array<uint8_t, FrameBuffer::HEADER_SIZE> header{};
+  std::vector<uint8_t> body;
+  FramePtr outgoing;  // 写完成前保持帧有效
+};
+
+// 每个线程一个 io_context，负责一部分客户端的连接、接收和定时发送，线程之间不共享客户端
+class Worker {
+public:
+  Worker(const EncodedAudio& audio, LoadStats& stats, std::vector<SendTimes>& sendTimes,
+         const std::vector<size_t>& roomSizes)
+      : audio_(audio), stats_(stats), sendTimes_(sendTimes),
+        roomSizes_(roomSizes), timer_(context_), sending_(false) {}
+
+  void addClient(size_t index, size_t room, bool speaker) {
+    clients_.push_back(std::make_unique<SimClient>(context_, index, room, speaker));
+  }
+
+  // 依次连接所有客户端，每个客户端发出 JOIN 后再连接下一个，避免瞬间涌入大量连接
+  void start(const tcp::resolver::results_type& endpoints, std::atomic<size_t>& joined) {
+    endpoints_ = endpoints;
+    joined_ = &joined;
+    boost::asio::post(context_, [this]() { connectNext(0); });
+    thread_ = std::thread([this]() { context_.run(); });
+  }
+
+  // 所有客户端加入后由主线程调用；源ID表此后只读
+  void startSending(const std::unordered_map<uint32_t, size_t>* sources) {
+    boost::asio::post(context_, [this, sources]() {
+      sources_ = sources;
+      sending_ = true;
+      nextTick_ = std::chrono::steady_clock::now();
+      tick(0);
+    });
+  }
+
+  void stopSending() {
+    boost::asio::post(context_, [this]() {
+      sending_ = false;
+      timer_.cancel();
+    });
+  }
+
+  void stop() {
+    boost::asio::post(context_, [this]() {
+      for (auto& client : clients_) {
+        boost::system::error_code ignored;
+        client->open = false;
+        client->socket.close(ignored);
+      }
+    });
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  // 只有发言者参与定时发送，按客户端下标分配时隙
+  void assignSlots() {
+    for (auto& client : clients_) {
+      if (client->speaker) {
+        slots_[client->index % SLOTS].push_back(client.get());
+      }
+    }
+  }
+
+  // 所有客户端的源ID，只在加入完成后调用
+  void collectSources(std::unordered_map<uint32_t, size_t>& sources) const {
+    for (const auto& client : clients_) {
+      if (client->joined) {
+        sources[client->sourceId] = client->index;
+      }
+    }
+  }
+
+private:
+  void connectNext(size_t position) {
+    if (position >= clients_.size()) {
+      return;
+    }
+    SimClient& client = *clients_[position];
+    boost::asio::async_connect(client.socket, endpoints_,
+        [this, &client, position](const boost::system::error_code& error, const tcp::endpoint&) {
+          if (error) {
+            std::cerr << "client " << client.index << " connect failed: " << error.message() << std::endl;
+            stats_.disconnects.add();
+          } else {
+            boost::system::error_code ignored;
+            client.socket.set_option(tcp::no_delay(true), ignored);
+            client.open = true;
+            sendJoin(client);
+            readHeader(client);
+          }
+          connectNext(position + 1);
+        });
+  }
+
+  void sendJoin(SimClient& client) {
+    ControlMessage msg;
+    msg.set_type(ControlMessage::JOIN);
+    msg.set_user_id("load-" + std::to_string(client.index));
+    msg.set_room_id("load-room-" + std::to_string(client.room));
+    msg.set_protocol_version(PROTOCOL_VERSION);
+    write(client, encodeFrame(FRAME_CONTROL, msg));
+  }
+
+  void readHeader(SimClient& client) {
+    boost::asio::async_read(client.socket, boost::asio::buffer(client.header),
+        [this, &client](const boost::system::error_code& error, size_t) {
+          if (error) {
+            close(client);
+            return;
+          }
+          uint32_t size = static_cast<uint32_t>(client.header[0]) | (static_cast<uint32_t>(client.header[1]) << 8) |
+                          (static_cast<uint32_t>(client.header[2]) << 16) |
+                          (static_cast<uint32_t>(client.header[3]) << 24);
+          client.body.resize(size);
+          boost::asio::async_read(client.socket, boost::asio::buffer(client.body),
+              [this, &client](const boost::system::error_code& bodyError, size_t) {
+                if (bodyError) {
+                  close(client);
+                  return;
+                }
+                handleMessage(client);
+                readHeader(client);
+              });
+        });
+  }
+
+  void handleMessage(SimClient& client) {
+    int64_t now = nowNanos();
+    const uint8_t* data = client.body.data();
+    size_t size = client.body.size();
+    switch (frameTypeOf(data, size)) {
+      case FRAME_MEDIA: {
+        MediaView media;
+        if (!parseMediaPacket(data + FRAME_TYPE_SIZE, size - FRAME_TYPE_SIZE, media)) {
+          return;
+        }
+        stats_.received.add();
+        stats_.receivedBytes.add(size);
+        // 开始发送前收到的包（如其他负载进程的数据）没有对应的发送时间
+        auto it = sources_ ? sources_->find(media.header.sourceId) : std::unordered_map<uint32_t, size_t>::const_iterator();
+        if (!sources_ || it == sources_->end()) {
+          stats_.unknownSource.add();
+          return;
+        }
+        int64_t sentAt = sendTimes_[it->second].nanos[media.header.sequence % SEND_TIME_WINDOW]
+                             .load(std::memory_order_relaxed);
+        if (sentAt > 0 && now >= sentAt) {
+          stats_.latency.record(static_cast<uint64_t>(now - sentAt));
+        }
+        return;
+      }
+      case FRAME_RESPONSE: {
+        // 第一条是连接时的欢迎消息，第二条是 JOIN 的确认，其中的源ID用于发送媒体包
+        ServerResponse response;
+        if (!response.ParseFromArray(data + FRAME_TYPE_SIZE, static_cast<int>(size - FRAME_TYPE_SIZE))) {
+          return;
+        }
+        if (++client.responses == 2 && !client.joined) {
+          if (response.status() != ServerResponse::SUCCESS) {
+            std::cerr << "client " << client.index << " join failed: " << response.message() << std::endl;
+            close(client);
+            return;
+          }
+          client.sourceId = response.source_id();
+          client.joined = true;
+          joined_->fetch_add(1);
+        }
+        return;
+      }
+      default:
+        return;
+    }
+  }
+
+  void tick(size_t slot) {
+    if (!sending_) {
+      return;
+    }
+    for (auto& client : slots_[slot]) {
+      sendMedia(*client);
+    }
+
+    nextTick_ += SLOT_INTERVAL;
+    // 落后超过一个发送周期时不再补发，从当前时间重新计时
+    auto now = std::chrono::steady_clock::now();
+    if (now > nextTick_ + FRAME_INTERVAL) {
+      nextTick_ = now;
+    }
+    timer_.expires_at(nextTick_);
+    timer_.async_wait([this, slot](const boost::system::error_code& error) {
+      if (!error) {
+        tick((slot + 1) % SLOTS);
+      }
+    });
+  }
+
+  void sendMedia(SimClient& client) {
+    if (!client.open || !client.joined) {
+      return;
+    }
+    if (client.writing) {
+      stats_.sendSkipped.add();
+      return;
+    }
+    size_t frameIndex = client.sequence % audio_.frames.size();
+    MediaHeader header;
+    header.audioLevel = audio_.levels[frameIndex];
+    header.sequence = client.sequence;
+    header.timestamp = static_cast<uint32_t>(client.sequence) * (MEDIA_CLOCK_RATE / 50);
+    header.sourceId = client.sourceId;
+    const std::vector<uint8_t>& payload = audio_.frames[frameIndex];
+    FramePtr frame = encodeMediaFrame(header, payload.data(), payload.size());
+
+    sendTimes_[client.index].nanos[client.sequence % SEND_TIME_WINDOW].store(nowNanos(), std::memory_order_relaxed);
+    ++client.sequence;
+    stats_.sent.add();
+    stats_.expected.add(roomSizes_[client.room] - 1);
+    write(client, std::move(frame));
+  }
+
+  void write(SimClient& client, FramePtr frame) {
+    client.writing = true;
+    client.outgoing = std::move(frame);
+    boost::asio::async_write(client.socket, boost::asio::buffer(client.outgoing->data(), client.outgoing->size()),
+        [this, &client](const boost::system::error_code& error, size_t) {
+          client.writing = false;
+          client.outgoing.reset();
+          if (error) {
+            close(client);
+          }
+        });
+  }
+
+  void close(SimClient& client) {
+    if (!client.open) {
+      return;
+    }
+    client.open = false;
+    stats_.disconnects.add();
+    boost::system::error_code ignored;
+    client.socket.close(ignored);
+  }
+
+private:
+  const EncodedAudio& audio_;
+  LoadStats& stats_;
+  std::vector<SendTimes>& sendTimes_;
+  const std::vector<size_t>& roomSizes_;
+
+  boost::asio::io_context context_;
+  boost::asio::steady_timer timer_;
+  std::thread thread_;
+  tcp::resolver::results_type endpoints_;
+  std::atomic<size_t>* joined_ = nullptr;
+  std::vector<std::unique_ptr<SimClient>> clients_;
+  std::array<std::vector<SimClient*>, SLOTS> slots_;
+  const std::unordered_map<uint32_t, size_t>* sources_ = nullptr;
+  bool sending_;
+  std::chrono::steady_clock::time_point nextTick_;
+};
+
+double millis(uint64_t nanos) {
+  return static_cast<double>(nanos) / 1e6;
+}
+
+size_t envSize(const char* name, size_t fallback) {
+  const char* value = std::getenv(name);
+  return value ? static_cast<size_t>(std::stoul(value)) : fallback;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 6) {
+    std::cerr << "Usage: " << argv[0] << " <host> <port> [clients] [rooms] [seconds]" << std::endl;
+    std::cerr << "  VOICECHAT_LOADGEN_THREADS   worker threads (default 2)" << std::endl;
+    std::cerr << "  VOICECHAT_LOADGEN_SPEAKERS  speakers per room, 0 = every client (default 0)" << std::endl;
+    return 1;
+  }
+
+  try {
+    Options options;
+    options.host = argv[1];
+    options.port = static_cast<uint16_t>(std::stoi(argv[2]));
+    if (argc >= 4) {
+      options.clients = static_cast<size_t>(std::stoul(argv[3]));
+    }
+    if (argc >= 5) {
+      options.rooms = static_cast<size_t>(std::stoul(argv[4]));
+    }
+    if (argc >= 6) {
+      options.seconds = static_cast<size_t>(std::stoul(argv[5]));
+    }
+    options.threads = envSize("VOICECHAT_LOADGEN_THREADS", options.threads);
+    options.speakers = envSize("VOICECHAT_LOADGEN_SPEAKERS", options.speakers);
+    if (options.clients == 0 || options.rooms == 0 || options.threads == 0) {
+      std::cerr << "clients, rooms and threads must be positive" << std::endl;
+      return 1;
+    }
+
+    EncodedAudio audio;
+    audio.prepare();
+
+    // 客户端 i 加入房间 i % rooms，房间内的前 speakers 个客户端发言
+    std::vector<size_t> roomSizes(options.rooms, 0);
+    for (size_t i = 0; i < options.clients; ++i) {
+      ++roomSizes[i % options.rooms];
+    }
+    // 直方图按线程分片，体积较大，不放在栈上
+    auto stats = std::make_unique<LoadStats>();
+    std::vector<SendTimes> sendTimes(options.clients);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t t = 0; t < options.threads; ++t) {
+      workers.push_back(std::make_unique<Worker>(audio, *stats, sendTimes, roomSizes));
+    }
+    size_t speakers = 0;
+    for (size_t i = 0; i < options.clients; ++i) {
+      bool speaker = options.speakers == 0 || i / options.rooms < options.speakers;
+      speakers += speaker ? 1 : 0;
+      workers[i % options.threads]->addClient(i, i % options.rooms, speaker);
+    }
+
+    boost::asio::io_context resolverContext;
+    tcp::resolver resolver(resolverContext);
+    auto endpoints = resolver.resolve(options.host, std::to_string(options.port));
+
+    std::cout << "Connecting " << options.clients << " clients to " << options.host << ":" << options.port
+              << " (" << options.rooms << " rooms, " << speakers << " speakers, "
+              << options.threads << " threads)" << std::endl;
+    std::atomic<size_t> joined{0};
+    auto joinStart = std::chrono::steady_clock::now();
+    for (auto& worker : workers) {
+      worker->start(endpoints, joined);
+    }
+    while (joined.load() < options.clients && stats->disconnects.value() == 0 &&
+           std::chrono::steady_clock::now() - joinStart < JOIN_TIMEOUT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (joined.load() < options.clients) {
+      std::cerr << "Only " << joined.load() << " of " << options.clients << " clients joined" << std::endl;
+      for (auto& worker : workers) {
+        worker->stop();
+      }
+      return 1;
+    }
+    std::cout << "All clients joined in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - joinStart).count()
+              << " ms, sending for " << options.seconds << " s" << std::endl;
+
+    // 源ID表在开始发送前建好，发送期间各线程只读
+    std::unordered_map<uint32_t, size_t> sources;
+    for (auto& worker : workers) {
+      worker->collectSources(sources);
+      worker->assignSlots();
+    }
+    auto sendStart = std::chrono::steady_clock::now();
+    for (auto& worker : workers) {
+      worker->startSending(&sources);
+    }
+
+    // 每秒输出一次收发速率
+    uint64_t lastSent = 0;
+    uint64_t lastReceived = 0;
+    for (size_t second = 1; second <= options.seconds; ++second) {
+      std::this_thread::sleep_until(sendStart + std::chrono::seconds(second));
+      uint64_t sent = stats->sent.value();
+      uint64_t received = stats->received.value();
+      HistogramSnapshot latency = stats->latency.snapshot();
+      std::cout << std::setw(4) << second << "s  sent " << std::setw(8) << sent - lastSent << "/s  received "
+                << std::setw(9) << received - lastReceived << "/s  p99 " << std::fixed << std::setprecision(2)
+                << millis(latency.quantile(0.99)) << " ms" << std::endl;
+      lastSent = sent;
+      lastReceived = received;
+    }
+    for (auto& worker : workers) {
+      worker->stopSending();
+    }
+    auto sendElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - sendStart).count();
+    std::this_thread::sleep_for(DRAIN_TIME);
+    for (auto& worker : workers) {
+      worker->stop();
+    }
+
+    uint64_t sent = stats->sent.value();
+    uint64_t expected = stats->expected.value();
+    uint64_t received = stats->received.value();
+    HistogramSnapshot latency = stats->latency.snapshot();
+    double loss = expected > received ? 100.0 * static_cast<double>(expected - received) / expected : 0.0;
+    std::cout << std::fixed << std::setprecision(2)
+              << "\n=== Load Summary ===" << std::endl
+              << "Frames sent:      " << sent << " (" << sent / sendElapsed << "/s)" << std::endl
+              << "Frames received:  " << received << " (" << received / sendElapsed << "/s, "
+              << stats->receivedBytes.value() * 8 / sendElapsed / 1e6 << " Mbit/s)" << std::endl
+              << "Frames expected:  " << expected << std::endl
+              << "Loss:             " << loss << "%" << std::endl
+              << "Latency p50:      " << millis(latency.quantile(0.5)) << " ms" << std::endl
+              << "Latency p99:      " << millis(latency.quantile(0.99)) << " ms" << std::endl
+              << "Latency p99.9:    " << millis(latency.quantile(0.999)) << " ms" << std::endl
+              << "Send skipped:     " << stats->sendSkipped.value() << std::endl
+              << "Unknown source:   " << stats->unknownSource.value() << std::endl
+              << "Disconnects:      " << stats->disconnects.value() << std::endl;
+    // 服务器按发言者数限制转发时，被抑制的帧同样计为丢失
+    if (loss > 0.0 && options.speakers == 0) {
+      std::cout << "Note: start voice_server with max_speakers 0 when every client speaks" << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
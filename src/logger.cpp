@@ -0,0 +1,237 @@
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <streambuf>
+#include <string>
+
+namespace voicechat {
+
+namespace {
+
+// 写入固定大小缓冲区的 streambuf，写满后丢弃剩余内容
+class FixedBuffer : public std::streambuf {
+public:
+    void reset(char* begin, size_t size) { setp(begin, begin + size); }
+    size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+protected:
+    int_type overflow(int_type) override { return traits_type::eof(); }
+};
+
+// 每个线程复用同一个输出流，避免每条日志构造 std::ostream
+struct ThreadStream {
+    FixedBuffer buffer;
+    std::ostream stream{&buffer};
+};
+
+ThreadStream& threadStream() {
+    thread_local ThreadStream stream;
+    return stream;
+}
+
+LogLevel levelFromEnvironment() {
+    const char* value = std::getenv("VOICECHAT_LOG_LEVEL");
+    if (!value) {
+        return LogLevel::Info;
+    }
+    std::string name(value);
+    if (name == "trace") return LogLevel::Trace;
+    if (name == "debug") return LogLevel::Debug;
+    if (name == "info") return LogLevel::Info;
+    if (name == "warn") return LogLevel::Warn;
+    if (name == "error") return LogLevel::Error;
+    if (name == "off") return LogLevel::Off;
+    return LogLevel::Info;
+}
+
+const char* levelTag(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace: return "T";
+        case LogLevel::Debug: return "D";
+        case LogLevel::Info: return "I";
+        case LogLevel::Warn: return "W";
+        case LogLevel::Error: return "E";
+        default: return "?";
+    }
+}
+
+} // namespace
+
+Logger::Entry* Logger::Ring::reserve() {
+    uint64_t position = head.load(std::memory_order_relaxed);
+    if (position - tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        return nullptr;
+    }
+    return &entries[position & (RING_CAPACITY - 1)];
+}
+
+void Logger::Ring::commit() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : level_(levelFromEnvironment())
+    , dropped_(0)
+    , stopping_(false)
+{
+    flusher_ = std::thread([this]() {
+        run();
+    });
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+        stopping_ = true;
+    }
+    flushCondition_.notify_one();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    flush();
+}
+
+Logger::Ring* Logger::threadRing() {
+    // 线程退出时只标记环形缓冲，剩余日志仍由后台线程输出
+    struct Holder {
+        std::shared_ptr<Ring> ring;
+        ~Holder() {
+            if (ring) {
+                ring->producerAlive.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Holder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.push_back(holder.ring);
+    }
+    return holder.ring.get();
+}
+
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(flushMutex_);
+    while (!stopping_) {
+        flushCondition_.wait_for(lock, FLUSH_INTERVAL);
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void Logger::flush() {
+    // 同一时间只允许一个消费者
+    static std::mutex consumerMutex;
+    std::lock_guard<std::mutex> consumerLock(consumerMutex);
+
+    struct Pending {
+        Ring* ring;
+        uint64_t end;
+    };
+    std::vector<Pending> pending;
+    std::vector<const Entry*> batch;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        // 清理已退出且没有剩余日志的线程的缓冲区
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<Ring>& ring) {
+            return !ring->producerAlive.load(std::memory_order_acquire) &&
+                   ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+        }), rings_.end());
+
+        for (const auto& ring : rings_) {
+            uint64_t begin = ring->tail.load(std::memory_order_relaxed);
+            uint64_t end = ring->head.load(std::memory_order_acquire);
+            for (uint64_t i = begin; i < end; ++i) {
+                batch.push_back(&ring->entries[i & (RING_CAPACITY - 1)]);
+            }
+            if (end != begin) {
+                pending.push_back(Pending{ring.get(), end});
+            }
+        }
+    }
+
+    static uint64_t reportedDrops = 0;
+    uint64_t drops = dropped_.load(std::memory_order_relaxed);
+    if (batch.empty() && drops == reportedDrops) {
+        return;
+    }
+
+    // 多个线程的日志按时间合并输出
+    std::stable_sort(batch.begin(), batch.end(), [](const Entry* a, const Entry* b) {
+        return a->time < b->time;
+    });
+
+    // 级别不同的日志分别写入 stdout 和 stderr，切换时先刷新，保持两者的相对顺序
+    FILE* current = nullptr;
+    for (const Entry* entry : batch) {
+        std::time_t seconds = std::chrono::system_clock::to_time_t(entry->time);
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            entry->time.time_since_epoch()).count() % 1000;
+        std::tm local{};
+        localtime_r(&seconds, &local);
+
+        char prefix[32];
+        int prefixLength = std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d [%s] ",
+                                         local.tm_hour, local.tm_min, local.tm_sec,
+                                         static_cast<int>(millis), levelTag(entry->level));
+        FILE* out = entry->level >= LogLevel::Warn ? stderr : stdout;
+        if (current && current != out) {
+            std::fflush(current);
+        }
+        current = out;
+        std::fwrite(prefix, 1, static_cast<size_t>(prefixLength), out);
+        std::fwrite(entry->text, 1, entry->length, out);
+        std::fputc('\n', out);
+    }
+    if (current) {
+        std::fflush(current);
+    }
+
+    if (drops != reportedDrops) {
+        std::fprintf(stderr, "[W] 日志缓冲区已满，丢弃了 %llu 条日志\n",
+                     static_cast<unsigned long long>(drops - reportedDrops));
+        reportedDrops = drops;
+    }
+
+    // 输出完成后才释放条目，生产者之后才能复用这些位置
+    for (const Pending& ring : pending) {
+        ring.ring->tail.store(ring.end, std::memory_order_release);
+    }
+}
+
+LogLine::LogLine(LogLevel level)
+    : ring_(Logger::instance().threadRing())
+    , entry_(ring_->reserve())
+{
+    ThreadStream& stream = threadStream();
+    stream.stream.clear();
+    if (entry_) {
+        entry_->time = std::chrono::system_clock::now();
+        entry_->level = level;
+        stream.buffer.reset(entry_->text, Logger::MAX_MESSAGE_SIZE);
+    } else {
+        Logger::instance().dropped_.fetch_add(1, std::memory_order_relaxed);
+        stream.buffer.reset(nullptr, 0);
+    }
+}
+
+LogLine::~LogLine() {
+    if (entry_) {
+        entry_->length = static_cast<uint32_t>(threadStream().buffer.length());
+        ring_->commit();
+    }
+}
+
+std::ostream& LogLine::stream() {
+    return threadStream().stream;
+}
+
+} // namespace voicechat
@@ -0,0 +1,223 @@
+#include "metrics.hpp"
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace voicechat {
+
+size_t metricShard() {
+    static std::atomic<size_t> nextShard{0};
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+namespace {
+
+// 最高置位的位置，value 不为 0
+uint32_t highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+    uint32_t bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+} // namespace
+
+size_t Histogram::bucketIndex(uint64_t value) {
+    // 小于 SUB_BUCKETS 的值每个值一个桶，之后每个2的幂区间分成 SUB_BUCKETS 个等宽子桶
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    uint32_t exponent = highestBit(value);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    uint32_t subBucket = static_cast<uint32_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t Histogram::bucketLowerBound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t exponent = static_cast<uint32_t>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = index % SUB_BUCKETS;
+    return (SUB_BUCKETS + subBucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+void Histogram::record(uint64_t value) {
+    Shard& shard = shards_[metricShard()];
+    shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(BUCKET_COUNT, 0);
+    for (const auto& shard : shards_) {
+        snapshot.count += shard.count.load(std::memory_order_relaxed);
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+uint64_t HistogramSnapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    // 各分片分别读取，count 与桶之和可能略有出入，以桶之和为准
+    uint64_t total = 0;
+    for (uint64_t bucket : buckets) {
+        total += bucket;
+    }
+    uint64_t target = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            // 取桶的中点
+            uint64_t lower = Histogram::bucketLowerBound(i);
+            uint64_t upper = i + 1 < buckets.size() ? Histogram::bucketLowerBound(i + 1) : lower;
+            return lower + (upper - lower) / 2;
+        }
+    }
+    return Histogram::bucketLowerBound(buckets.size() - 1);
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrCreate(const std::string& name, const std::string& help,
+                                                       Type type, const std::string& labels, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(name, Family{type, help, scale, {}}).first;
+    } else if (it->second.type != type) {
+        throw std::logic_error("指标类型冲突: " + name);
+    }
+
+    Family& family = it->second;
+    for (auto& series : family.series) {
+        if (series.labels == labels) {
+            return series;
+        }
+    }
+    family.series.emplace_back();
+    Series& series = family.series.back();
+    series.labels = labels;
+    switch (type) {
+        case Type::Counter: series.counter = std::make_unique<Counter>(); break;
+        case Type::Gauge: series.gauge = std::make_unique<Gauge>(); break;
+        case Type::Histogram: series.histogram = std::make_unique<Histogram>(); break;
+    }
+    return series;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    return *findOrCreate(name, help, Type::Counter, labels, 1.0).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    return *findOrCreate(name, help, Type::Gauge, labels, 1.0).gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, double scale,
+                                      const std::string& labels) {
+    return *findOrCreate(name, help, Type::Histogram, labels, scale).histogram;
+}
+
+namespace {
+
+constexpr double SUMMARY_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+std::string seriesName(const std::string& name, const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) {
+        return name;
+    }
+    std::string result = name + "{" + labels;
+    if (!labels.empty() && !extra.empty()) {
+        result += ",";
+    }
+    return result + extra + "}";
+}
+
+} // namespace
+
+std::string MetricsRegistry::renderPrometheus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    for (const auto& [name, family] : families_) {
+        const char* type = family.type == Type::Counter ? "counter"
+                         : family.type == Type::Gauge ? "gauge" : "summary";
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+        for (const auto& series : family.series) {
+            if (series.counter) {
+                out << seriesName(name, series.labels) << " " << series.counter->value() << "\n";
+            } else if (series.gauge) {
+                out << seriesName(name, series.labels) << " " << series.gauge->value() << "\n";
+            } else if (series.histogram) {
+                HistogramSnapshot snapshot = series.histogram->snapshot();
+                for (double q : SUMMARY_QUANTILES) {
+                    std::ostringstream quantile;
+                    quantile << "quantile=\"" << q << "\"";
+                    out << seriesName(name, series.labels, quantile.str()) << " "
+                        << snapshot.quantile(q) * family.scale << "\n";
+                }
+                out << seriesName(name + "_sum", series.labels) << " " << snapshot.sum * family.scale << "\n";
+                out << seriesName(name + "_count", series.labels) << " " << snapshot.count << "\n";
+            }
+        }
+    }
+    return out.str();
+}
+
+std::string MetricsRegistry::renderSummary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    for (const auto& [name, family] : families_) {
+        for (const auto& series : family.series) {
+            out << seriesName(name, series.labels) << ": ";
+            if (series.counter) {
+                out << series.counter->value();
+            } else if (series.gauge) {
+                out << series.gauge->value();
+            } else if (series.histogram) {
+                HistogramSnapshot snapshot = series.histogram->snapshot();
+                out << "count=" << snapshot.count;
+                if (snapshot.count > 0) {
+                    out << " p50=" << snapshot.quantile(0.5) * family.scale
+                        << " p99=" << snapshot.quantile(0.99) * family.scale
+                        << " p99.9=" << snapshot.quantile(0.999) * family.scale;
+                }
+            }
+            out << "\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace voicechat
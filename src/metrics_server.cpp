@@ -0,0 +1,112 @@
+#include "metrics_server.hpp"
+#include "logger.hpp"
+#include <memory>
+#include <string>
+
+namespace voicechat {
+
+namespace {
+
+// 单次查询：读到请求头结束后回复全部指标并关闭连接
+struct MetricsRequest : std::enable_shared_from_this<MetricsRequest> {
+    // 请求头的长度上限，超过时读取失败并直接关闭连接，不再继续缓存
+    static constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+    MetricsRequest(boost::asio::ip::tcp::socket sock, MetricsRegistry& registry)
+        : socket(std::move(sock)), registry(registry) {}
+
+    void start() {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(socket, request, "\r\n\r\n",
+            [self](const boost::system::error_code& error, std::size_t /*length*/) {
+                if (!error) {
+                    self->respond();
+                }
+            });
+    }
+
+    void respond() {
+        std::string body = registry.renderPrometheus();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                   "Connection: close\r\n\r\n" + body;
+        auto self = shared_from_this();
+        boost::asio::async_write(socket, boost::asio::buffer(response),
+            [self](const boost::system::error_code& /*error*/, std::size_t /*length*/) {
+                boost::system::error_code ec;
+                self->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+                self->socket.close(ec);
+            });
+    }
+
+    boost::asio::ip::tcp::socket socket;
+    MetricsRegistry& registry;
+    boost::asio::streambuf request{MAX_REQUEST_SIZE};
+    std::string response;
+};
+
+} // namespace
+
+MetricsServer::MetricsServer(MetricsRegistry& registry)
+    : registry_(registry)
+    , acceptor_(io_context_)
+    , running_(false)
+{
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(uint16_t port) {
+    try {
+        boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+
+        running_ = true;
+        doAccept();
+        thread_ = std::thread([this]() {
+            io_context_.run();
+        });
+        VC_LOG_INFO("指标查询端口已开启: 127.0.0.1:" << acceptor_.local_endpoint().port());
+        return true;
+    } catch (const std::exception& e) {
+        VC_LOG_ERROR("指标查询端口启动失败: " << e.what());
+        return false;
+    }
+}
+
+uint16_t MetricsServer::port() const {
+    boost::system::error_code ec;
+    auto endpoint = acceptor_.local_endpoint(ec);
+    return ec ? 0 : endpoint.port();
+}
+
+void MetricsServer::stop() {
+    running_ = false;
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+    io_context_.stop();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void MetricsServer::doAccept() {
+    acceptor_.async_accept(
+        [this](const boost::system::error_code& error, boost::asio::ip::tcp::socket socket) {
+            if (!running_) {
+                return;
+            }
+            if (!error) {
+                std::make_shared<MetricsRequest>(std::move(socket), registry_)->start();
+            }
+            doAccept();
+        });
+}
+
+} // namespace voicechat
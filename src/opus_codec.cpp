@@ -9,6 +9,8 @@ OpusCodec::OpusCodec()
     , decoder_(nullptr)
     , sampleRate_(48000)  // Opus推荐采样率
     , channels_(2)
+    , frameDuration_(DEFAULT_FRAME_DURATION)
+    , lastDecodedSize_(0)
 {
 }
 
@@ -43,6 +45,8 @@ bool OpusCodec::initialize(int sampleRate, int channels) {
     opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(64000));  // 64kbps
     opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(8));   // 复杂度 (0-10)
     opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));  // 针对语音优化
+    opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(1));   // 携带上一帧的冗余，接收端可用于恢复丢包
+    opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(10));  // 按约10%的丢包率分配冗余
     
     // 创建解码器
     decoder_ = opus_decoder_create(
@@ -62,23 +66,69 @@ bool OpusCodec::initialize(int sampleRate, int channels) {
     return true;
 }
 
+bool OpusCodec::initializeDecoder(int sampleRate, int channels) {
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+    
+    int error;
+    decoder_ = opus_decoder_create(sampleRate_, channels_, &error);
+    return error == OPUS_OK && decoder_;
+}
+
+void OpusCodec::resetDecoder() {
+    if (decoder_) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
+
+bool OpusCodec::isValidFrameDuration(std::chrono::microseconds duration) {
+    switch (duration.count()) {
+        case 2500:
+        case 5000:
+        case 10000:
+        case 20000:
+        case 40000:
+        case 60000:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool OpusCodec::setFrameDuration(std::chrono::microseconds duration) {
+    if (!isValidFrameDuration(duration)) {
+        return false;
+    }
+    frameDuration_ = duration;
+    return true;
+}
+
+int OpusCodec::frameSize() const {
+    return static_cast<int>(static_cast<int64_t>(sampleRate_) * frameDuration_.count() / 1000000);
+}
+
 std::vector<uint8_t> OpusCodec::encode(const std::vector<float>& pcmData) {
-    if (!encoder_ || pcmData.empty()) {
+    return encode(pcmData.data(), pcmData.size());
+}
+
+std::vector<uint8_t> OpusCodec::encode(const float* pcm, size_t samples) {
+    if (!encoder_ || samples == 0) {
         return {};
     }
     
-    std::vector<uint8_t> encodedData(MAX_PACKET_SIZE);
-    
     // 确保输入数据大小正确
-    if (pcmData.size() != static_cast<size_t>(FRAME_SIZE * channels_)) {
+    int frameSamples = frameSize();
+    if (samples != static_cast<size_t>(frameSamples * channels_)) {
         return {};
     }
     
+    std::vector<uint8_t> encodedData(MAX_PACKET_SIZE);
+    
     // 编码
     opus_int32 encodedBytes = opus_encode_float(
         encoder_,
-        pcmData.data(),
-        FRAME_SIZE,
+        pcm,
+        frameSamples,
         encodedData.data(),
         MAX_PACKET_SIZE
     );
@@ -92,25 +142,50 @@ std::vector<uint8_t> OpusCodec::encode(const std::vector<float>& pcmData) {
 }
 
 std::vector<float> OpusCodec::decode(const std::vector<uint8_t>& encodedData) {
-    if (!decoder_ || encodedData.empty()) {
+    if (encodedData.empty()) {
+        return {};
+    }
+    return decodeFrame(encodedData.data(), encodedData.size(), false);
+}
+
+std::vector<float> OpusCodec::decodeFec(const std::vector<uint8_t>& nextPacket) {
+    if (nextPacket.empty()) {
+        return conceal();
+    }
+    return decodeFrame(nextPacket.data(), nextPacket.size(), true);
+}
+
+std::vector<float> OpusCodec::conceal() {
+    return decodeFrame(nullptr, 0, false);
+}
+
+std::vector<float> OpusCodec::decodeFrame(const uint8_t* data, size_t size, bool fec) {
+    if (!decoder_) {
         return {};
     }
     
-    std::vector<float> pcmData(FRAME_SIZE * channels_);
+    // 正常解码时按最长的包分配；丢包补偿和 FEC 要求帧长等于丢失的帧，按上一个包的帧长
+    bool recover = fec || !data;
+    int frameSamples = recover ? (lastDecodedSize_ > 0 ? lastDecodedSize_ : frameSize())
+                               : sampleRate_ * MAX_DECODE_MILLISECONDS / 1000;
+    std::vector<float> pcmData(static_cast<size_t>(frameSamples) * channels_);
     
-    // 解码
+    // 解码；data 为空时做丢包补偿，fec 为真时解码包内携带的上一帧冗余
     int decodedSamples = opus_decode_float(
         decoder_,
-        encodedData.data(),
-        encodedData.size(),
+        data,
+        static_cast<opus_int32>(size),
         pcmData.data(),
-        FRAME_SIZE,
-        0  // 不使用FEC
+        frameSamples,
+        fec ? 1 : 0
     );
     
     if (decodedSamples < 0) {
         return {};
     }
+    if (!recover) {
+        lastDecodedSize_ = decodedSamples;
+    }
     
     pcmData.resize(decodedSamples * channels_);
     return pcmData;
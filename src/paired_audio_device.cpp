@@ -0,0 +1,73 @@
+#include "paired_audio_device.hpp"
+#include <algorithm>
+
+namespace voicechat {
+
+PairedAudioDevice::PairedAudioDevice(std::unique_ptr<IAudioDevice> captureDevice,
+                                     std::unique_ptr<IAudioDevice> playbackDevice)
+    : captureDevice_(std::move(captureDevice))
+    , playbackDevice_(std::move(playbackDevice))
+    , initialized_(false)
+{
+    captureDevice_->setCallback([this](const std::vector<float>& samples) {
+        onCapture(samples);
+    });
+}
+
+PairedAudioDevice::~PairedAudioDevice() {
+    // 先停止采集线程，它会回调本对象
+    stop();
+}
+
+bool PairedAudioDevice::initialize(int sampleRate, int channels) {
+    if (initialized_) {
+        return true;
+    }
+    initialized_ = captureDevice_->initialize(sampleRate, channels) &&
+                   playbackDevice_->initialize(sampleRate, channels);
+    return initialized_;
+}
+
+bool PairedAudioDevice::start() {
+    // 输出设备先启动，第一块渲染数据写入时已在运行
+    if (!playbackDevice_->start()) {
+        return false;
+    }
+    if (!captureDevice_->start()) {
+        playbackDevice_->stop();
+        return false;
+    }
+    return true;
+}
+
+bool PairedAudioDevice::stop() {
+    bool captureStopped = captureDevice_->stop();
+    bool playbackStopped = playbackDevice_->stop();
+    return captureStopped && playbackStopped;
+}
+
+void PairedAudioDevice::setCaptureCallback(CaptureCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    captureCallback_ = std::move(callback);
+}
+
+void PairedAudioDevice::setRenderCallback(RenderCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    renderCallback_ = std::move(callback);
+}
+
+void PairedAudioDevice::onCapture(const std::vector<float>& samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (captureCallback_) {
+        captureCallback_(samples.data(), samples.size());
+    }
+    rendered_.resize(samples.size());
+    if (renderCallback_) {
+        renderCallback_(rendered_.data(), rendered_.size());
+    } else {
+        std::fill(rendered_.begin(), rendered_.end(), 0.0f);
+    }
+    playbackDevice_->write(rendered_);
+}
+
+} // namespace voicechat
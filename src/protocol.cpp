@@ -0,0 +1,145 @@
+#include "protocol.hpp"
+#include "mix_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace voicechat {
+
+FramePtr encodeFrame(FrameType type, const google::protobuf::MessageLite& message) {
+    size_t messageSize = message.ByteSizeLong();
+    FramePtr frame = FramePool::instance().acquire(FRAME_TYPE_SIZE + messageSize);
+    frame->body()[0] = static_cast<uint8_t>(type);
+    message.SerializeWithCachedSizesToArray(frame->body() + FRAME_TYPE_SIZE);
+    return frame;
+}
+
+FrameType frameTypeOf(const uint8_t* data, size_t size) {
+    if (size < FRAME_TYPE_SIZE || !FrameType_IsValid(data[0])) {
+        return FRAME_UNKNOWN;
+    }
+    return static_cast<FrameType>(data[0]);
+}
+
+namespace {
+
+google::protobuf::ArenaOptions arenaOptions(char* block, size_t size) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = size;
+    return options;
+}
+
+void storeBigEndian16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+}
+
+void storeBigEndian32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+uint16_t loadBigEndian16(const uint8_t* in) {
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+uint32_t loadBigEndian32(const uint8_t* in) {
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+           (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+}
+
+} // namespace
+
+bool parseMediaPacket(const uint8_t* data, size_t size, MediaView& view) {
+    if (size < MEDIA_HEADER_SIZE || (data[0] >> 6) != MEDIA_VERSION) {
+        return false;
+    }
+    view.header.audioLevel = data[1] & 0x7F;
+    view.header.sequence = loadBigEndian16(data + 2);
+    view.header.timestamp = loadBigEndian32(data + 4);
+    view.header.sourceId = loadBigEndian32(data + 8);
+    view.payload = ByteSpan(data + MEDIA_HEADER_SIZE, size - MEDIA_HEADER_SIZE);
+    return true;
+}
+
+FramePtr encodeMediaFrame(const MediaHeader& header, const uint8_t* payload, size_t size) {
+    FramePtr frame = FramePool::instance().acquire(FRAME_TYPE_SIZE + MEDIA_HEADER_SIZE + size);
+    uint8_t* out = frame->body();
+    out[0] = static_cast<uint8_t>(FRAME_MEDIA);
+    uint8_t* packet = out + FRAME_TYPE_SIZE;
+    packet[0] = static_cast<uint8_t>(MEDIA_VERSION << 6);
+    packet[1] = static_cast<uint8_t>(std::min<uint32_t>(header.audioLevel, MAX_AUDIO_LEVEL));
+    storeBigEndian16(packet + 2, header.sequence);
+    storeBigEndian32(packet + 4, header.timestamp);
+    storeBigEndian32(packet + 8, header.sourceId);
+    if (size > 0) {
+        std::memcpy(packet + MEDIA_HEADER_SIZE, payload, size);
+    }
+    return frame;
+}
+
+FramePtr encodeBridgeMediaFrame(uint32_t channel, const uint8_t* packet, size_t size) {
+    FramePtr frame = FramePool::instance().acquire(FRAME_TYPE_SIZE + BRIDGE_CHANNEL_SIZE + size);
+    uint8_t* out = frame->body();
+    out[0] = static_cast<uint8_t>(FRAME_BRIDGE_MEDIA);
+    storeBigEndian32(out + FRAME_TYPE_SIZE, channel);
+    if (size > 0) {
+        std::memcpy(out + FRAME_TYPE_SIZE + BRIDGE_CHANNEL_SIZE, packet, size);
+    }
+    return frame;
+}
+
+bool parseBridgeMedia(const uint8_t* data, size_t size, uint32_t& channel, MediaView& view) {
+    if (size < BRIDGE_CHANNEL_SIZE) {
+        return false;
+    }
+    channel = loadBigEndian32(data);
+    return parseMediaPacket(data + BRIDGE_CHANNEL_SIZE, size - BRIDGE_CHANNEL_SIZE, view);
+}
+
+ParseArena::ParseArena()
+    : arena_(arenaOptions(initialBlock_, INITIAL_BLOCK_SIZE))
+    , depth_(0)
+{
+}
+
+ParseArena& ParseArena::local() {
+    thread_local ParseArena arena;
+    return arena;
+}
+
+ParseArena::Scope::Scope()
+    : owner_(local())
+{
+    ++owner_.depth_;
+}
+
+ParseArena::Scope::~Scope() {
+    // 嵌套的作用域共享同一批消息，只在最外层结束时释放；
+    // 连续多条消息累积在初始块中，占用超过阈值时才整体释放一次，分摊 Reset 的开销
+    if (--owner_.depth_ == 0 && owner_.arena_.SpaceUsed() > RESET_THRESHOLD) {
+        owner_.arena_.Reset();
+    }
+}
+
+uint32_t audioLevelOf(const float* samples, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    float meanSquare = sumOfSquares(samples, count) / static_cast<float>(count);
+    if (meanSquare <= 0.0f) {
+        return 0;
+    }
+    // 10*log10(均方) 即均方根的 dBFS
+    float dbfs = 10.0f * std::log10(meanSquare);
+    float level = static_cast<float>(MAX_AUDIO_LEVEL) + dbfs;
+    if (level <= 0.0f) {
+        return 0;
+    }
+    return level >= MAX_AUDIO_LEVEL ? MAX_AUDIO_LEVEL : static_cast<uint32_t>(std::lround(level));
+}
+
+} // namespace voicechat
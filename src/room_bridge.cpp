@@ -0,0 +1,227 @@
+#include "room_bridge.hpp"
+#include "logger.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace voicechat {
+
+std::vector<BridgePeer> parseBridgePeers(const std::string& spec) {
+    std::vector<BridgePeer> peers;
+    std::istringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t begin = item.find_first_not_of(" \t");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        item = item.substr(begin, item.find_last_not_of(" \t") - begin + 1);
+
+        size_t at = item.find('@');
+        size_t colon = item.rfind(':');
+        if (at == std::string::npos || at == 0 || colon == std::string::npos || colon < at + 2) {
+            throw std::invalid_argument("invalid bridge peer: " + item);
+        }
+        BridgePeer peer;
+        peer.nodeId = item.substr(0, at);
+        peer.host = item.substr(at + 1, colon - at - 1);
+        // 端口只接受 1-65535 的十进制数，不接受符号、空白或多余的字符
+        std::string portText = item.substr(colon + 1);
+        if (portText.empty() || portText.size() > 5 || portText.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::invalid_argument("invalid bridge peer port: " + item);
+        }
+        unsigned long port = std::stoul(portText);
+        if (port == 0 || port > 65535) {
+            throw std::invalid_argument("invalid bridge peer port: " + item);
+        }
+        peer.port = static_cast<uint16_t>(port);
+        peers.push_back(std::move(peer));
+    }
+    return peers;
+}
+
+BridgeLink::BridgeLink(BridgePeer peer)
+    : peer_(std::move(peer))
+    , needsHello_(false)
+{
+}
+
+bool BridgeLink::send(const SharedFrame& frame, SendPriority priority) {
+    std::shared_ptr<AsioConnection> connection = std::atomic_load(&connection_);
+    if (!connection || !connection->isConnected()) {
+        return false;
+    }
+    return connection->send(frame, priority);
+}
+
+bool BridgeLink::isConnected() const {
+    std::shared_ptr<AsioConnection> connection = std::atomic_load(&connection_);
+    return connection && connection->isConnected();
+}
+
+RoomBridge::RoomBridge(std::string nodeId, std::vector<BridgePeer> peers, std::string secret,
+                       RoomListProvider provider)
+    : nodeId_(std::move(nodeId))
+    , secret_(std::move(secret))
+    , provider_(std::move(provider))
+    , running_(false)
+    , timer_(io_context_)
+{
+    // 配置中可以包含本节点，便于所有节点使用同一份列表
+    for (auto& peer : peers) {
+        if (peer.nodeId != nodeId_) {
+            links_.push_back(std::make_shared<BridgeLink>(std::move(peer)));
+        }
+    }
+}
+
+RoomBridge::~RoomBridge() {
+    stop();
+}
+
+void RoomBridge::start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    io_context_.restart();
+    for (auto& link : links_) {
+        createConnection(*link);
+    }
+    announced_.reset();
+    lastAnnounce_ = std::chrono::steady_clock::now();
+    scheduleTick();
+    thread_ = std::thread([this]() {
+        io_context_.run();
+    });
+    VC_LOG_INFO("节点 " << nodeId_ << " 开启桥接，对端节点数: " << links_.size());
+}
+
+void RoomBridge::stop() {
+    running_ = false;
+    if (!thread_.joinable()) {
+        return;
+    }
+    // 在链路线程上取消定时器并关闭所有连接，被取消的操作的回调执行完后 io_context 没有其他工作，
+    // run() 随之返回；之后再销毁连接对象，不会有回调访问已释放的连接
+    boost::asio::post(io_context_, [this]() {
+        timer_.cancel();
+        for (auto& link : links_) {
+            if (link->connection_) {
+                link->connection_->disconnect();
+            }
+        }
+    });
+    thread_.join();
+    for (auto& link : links_) {
+        std::atomic_store(&link->connection_, std::shared_ptr<AsioConnection>());
+    }
+}
+
+std::shared_ptr<BridgeLink> RoomBridge::link(const std::string& nodeId) const {
+    for (const auto& link : links_) {
+        if (link->nodeId() == nodeId) {
+            return link;
+        }
+    }
+    return nullptr;
+}
+
+bool RoomBridge::authenticate(const std::string& nodeId, const std::string& secret) const {
+    if (!link(nodeId)) {
+        return false;
+    }
+    // 比较耗时与密钥内容无关，避免按响应时间逐字节猜测
+    unsigned char difference = secret.size() == secret_.size() ? 0 : 1;
+    for (size_t i = 0; i < secret.size(); ++i) {
+        difference |= static_cast<unsigned char>(secret[i] ^ secret_[i % std::max<size_t>(secret_.size(), 1)]);
+    }
+    return difference == 0;
+}
+
+void RoomBridge::scheduleTick() {
+    timer_.expires_after(TICK_INTERVAL);
+    timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error || !running_) {
+            return;
+        }
+        tick();
+        scheduleTick();
+    });
+}
+
+void RoomBridge::tick() {
+    auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<const BridgeRoomList> rooms = provider_();
+    bool roomsChanged = rooms != announced_;
+    bool periodic = now - lastAnnounce_ >= ANNOUNCE_INTERVAL;
+
+    for (auto& link : links_) {
+        if (!link->isConnected()) {
+            // 重新连接会放弃仍未完成的上一次尝试，因此解析或连接最多等待一个重试间隔
+            if (now - link->lastAttempt_ >= RECONNECT_INTERVAL) {
+                link->lastAttempt_ = now;
+                link->connection_->connect(link->peer_.host, link->peer_.port);
+            }
+            continue;
+        }
+        // 新建立的链路先发送 HELLO，之后与其他链路一样在列表变化或定期重发时发送房间列表
+        if (link->needsHello_.exchange(false)) {
+            BridgeMessage hello;
+            hello.set_type(BridgeMessage::HELLO);
+            hello.set_node_id(nodeId_);
+            hello.set_protocol_version(PROTOCOL_VERSION);
+            hello.set_secret(secret_);
+            link->send(encodeFrame(FRAME_BRIDGE, hello), SendPriority::Control);
+            announce(*link, *rooms);
+        } else if (roomsChanged || periodic) {
+            announce(*link, *rooms);
+        }
+    }
+    announced_ = rooms;
+    if (periodic) {
+        lastAnnounce_ = now;
+    }
+}
+
+void RoomBridge::createConnection(BridgeLink& link) {
+    // 每条链路一个连接对象，运行在链路线程的 io_context 上，断开后用同一个对象重新连接
+    auto connection = std::make_shared<AsioConnection>(io_context_);
+    BridgeLink* target = &link;
+    connection->setConnectedCallback([target]() {
+        target->needsHello_ = true;
+        VC_LOG_INFO("桥接链路已连接: " << target->nodeId());
+    });
+    connection->setDisconnectedCallback([target]() {
+        VC_LOG_WARN("桥接链路断开: " << target->nodeId());
+    });
+    connection->setErrorCallback([target](const std::string& error) {
+        VC_LOG_WARN("桥接节点 " << target->nodeId() << " (" << target->peer_.host << ":" << target->peer_.port
+                    << ") 连接错误: " << error);
+    });
+    // 对端发来的欢迎消息等数据与桥接无关，直接忽略
+    connection->setMessageCallback([](const std::vector<uint8_t>&) {});
+    link.lastAttempt_ = std::chrono::steady_clock::time_point();
+    std::atomic_store(&link.connection_, std::move(connection));
+}
+
+void RoomBridge::announce(BridgeLink& link, const BridgeRoomList& rooms) {
+    // 房间较多时分多条发送，对端收到 last 后整体替换该节点的房间列表
+    size_t offset = 0;
+    do {
+        BridgeMessage message;
+        message.set_type(BridgeMessage::ROOMS);
+        message.set_node_id(nodeId_);
+        size_t end = std::min(rooms.size(), offset + ROOMS_PER_MESSAGE);
+        for (; offset < end; ++offset) {
+            BridgeMessage::Room* room = message.add_rooms();
+            room->set_name(rooms[offset].name);
+            room->set_channel(rooms[offset].channel);
+        }
+        message.set_last(offset >= rooms.size());
+        link.send(encodeFrame(FRAME_BRIDGE, message), SendPriority::Control);
+    } while (offset < rooms.size());
+}
+
+} // namespace voicechat
@@ -0,0 +1,193 @@
+#include "room_mixer.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "mix_kernels.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+
+namespace voicechat {
+
+RoomMixer::RoomMixer(std::string roomName)
+    : roomName_(std::move(roomName))
+    , mixSequence_(0)
+    , sampleClock_(0)
+    , mix_(MIX_FRAME_SAMPLES)
+    , scratch_(MIX_FRAME_SAMPLES)
+    , ticks_(0)
+    , totalNanos_(0)
+    , maxNanos_(0)
+    , activeSpeakers_(0)
+{
+    mixCodec_ = std::make_unique<OpusCodec>();
+    if (!mixCodec_->initialize(MIX_SAMPLE_RATE, 1)) {
+        VC_LOG_ERROR("房间 " << roomName_ << " 混音编码器初始化失败");
+        mixCodec_.reset();
+    }
+}
+
+void RoomMixer::submit(ClientId speaker, ByteSpan payload) {
+    if (payload.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    auto& queue = pending_[speaker];
+    queue.emplace_back(payload.begin(), payload.end());
+    if (queue.size() > MAX_QUEUED_PACKETS) {
+        queue.pop_front();
+    }
+}
+
+void RoomMixer::removeSpeaker(ClientId speaker) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    pending_.erase(speaker);
+    removed_.push_back(speaker);
+}
+
+RoomMixer::Speaker* RoomMixer::findOrCreateSpeaker(ClientId speaker) {
+    auto it = speakers_.find(speaker);
+    if (it != speakers_.end()) {
+        return it->second.get();
+    }
+    auto state = std::make_unique<Speaker>();
+    if (!state->codec.initialize(MIX_SAMPLE_RATE, 1)) {
+        VC_LOG_ERROR("房间 " << roomName_ << " 为发言者 " << speaker << " 创建编解码器失败");
+        return nullptr;
+    }
+    return speakers_.emplace(speaker, std::move(state)).first->second.get();
+}
+
+SharedFrame RoomMixer::encodeMix(OpusCodec& codec, const std::vector<float>& pcm, uint32_t sequence,
+                                 uint32_t sourceId) {
+    std::vector<uint8_t> encoded = codec.encode(pcm);
+    if (encoded.empty()) {
+        return nullptr;
+    }
+    // 时间戳取本周期的采样时钟；完整混音和 mix-minus 是两条独立的流，源ID不同
+    MediaHeader header;
+    header.audioLevel = static_cast<uint8_t>(audioLevelOf(pcm.data(), pcm.size()));
+    header.sequence = static_cast<uint16_t>(sequence);
+    header.timestamp = sampleClock_;
+    header.sourceId = sourceId;
+    return encodeMediaFrame(header, encoded.data(), encoded.size());
+}
+
+void RoomMixer::tick(const std::vector<ClientId>& members, std::vector<MixOutput>& outputs) {
+    auto start = std::chrono::steady_clock::now();
+
+    // 取出IO线程提交的数据，IO线程只在这段时间内可能等待
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        for (ClientId speaker : removed_) {
+            speakers_.erase(speaker);
+            frames_.erase(speaker);
+        }
+        removed_.clear();
+        for (auto& [speaker, queue] : pending_) {
+            auto& frames = frames_[speaker];
+            for (auto& frame : queue) {
+                frames.push_back(std::move(frame));
+            }
+            while (frames.size() > MAX_QUEUED_PACKETS) {
+                frames.pop_front();
+            }
+        }
+        pending_.clear();
+    }
+
+    // 每个发言者取出一个混音帧累加到混音中。客户端的帧长可以是 2.5-60ms，
+    // 解码结果先接到该发言者的采样队列后，凑满 MIX_FRAME_SAMPLES 才参与本周期的混音
+    std::fill(mix_.begin(), mix_.end(), 0.0f);
+    for (auto& [speaker, state] : speakers_) {
+        state->active = false;
+    }
+    size_t activeCount = 0;
+    ClientId lastActive = INVALID_HANDLE;
+    for (auto& [speaker, frames] : frames_) {
+        if (frames.empty() && speakers_.find(speaker) == speakers_.end()) {
+            continue;
+        }
+        Speaker* state = findOrCreateSpeaker(speaker);
+        if (!state) {
+            frames.clear();
+            continue;
+        }
+        for (const auto& frame : frames) {
+            std::vector<float> pcm = state->codec.decode(frame);
+            state->decoded.insert(state->decoded.end(), pcm.begin(), pcm.end());
+        }
+        frames.clear();
+        if (state->decoded.size() < MIX_FRAME_SAMPLES) {
+            continue;
+        }
+        state->pcm.assign(state->decoded.begin(), state->decoded.begin() + MIX_FRAME_SAMPLES);
+        state->decoded.erase(state->decoded.begin(), state->decoded.begin() + MIX_FRAME_SAMPLES);
+        // 积压超过上限（发言者时钟偏快或网络突发）时丢弃最旧的采样，限制延迟
+        constexpr size_t MAX_BACKLOG_SAMPLES = MAX_QUEUED_FRAMES * MIX_FRAME_SAMPLES;
+        if (state->decoded.size() > MAX_BACKLOG_SAMPLES) {
+            state->decoded.erase(state->decoded.begin(), state->decoded.end() - MAX_BACKLOG_SAMPLES);
+        }
+        state->active = true;
+        mixAccumulate(mix_.data(), state->pcm.data(), MIX_FRAME_SAMPLES);
+        ++activeCount;
+        lastActive = speaker;
+    }
+
+    // 无人发言时不发送任何数据
+    if (activeCount > 0) {
+        std::vector<ClientId> listeners;
+        for (ClientId member : members) {
+            auto it = speakers_.find(member);
+            if (it == speakers_.end() || !it->second->active) {
+                listeners.push_back(member);
+                continue;
+            }
+            // 唯一的发言者听不到任何其他人
+            if (activeCount == 1 && member == lastActive) {
+                continue;
+            }
+
+            // 发言者收到减去自己声音的混音，用自己的编码器状态编码
+            Speaker& state = *it->second;
+            mixMinus(scratch_.data(), mix_.data(), state.pcm.data(), MIX_FRAME_SAMPLES);
+            mixClamp(scratch_.data(), MIX_FRAME_SAMPLES);
+            if (SharedFrame frame = encodeMix(state.codec, scratch_, state.sequence++, MIXER_MINUS_SOURCE_ID)) {
+                outputs.push_back(MixOutput{{member}, std::move(frame)});
+            }
+        }
+
+        // 其余听众收到的完整混音只编码一次
+        if (!listeners.empty() && mixCodec_) {
+            std::copy(mix_.begin(), mix_.end(), scratch_.begin());
+            mixClamp(scratch_.data(), MIX_FRAME_SAMPLES);
+            if (SharedFrame frame = encodeMix(*mixCodec_, scratch_, mixSequence_++, MIXER_SOURCE_ID)) {
+                outputs.push_back(MixOutput{std::move(listeners), std::move(frame)});
+            }
+        }
+    }
+    sampleClock_ += static_cast<uint32_t>(MIX_FRAME_SAMPLES);
+
+    uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    ticks_.fetch_add(1, std::memory_order_relaxed);
+    totalNanos_.fetch_add(elapsed, std::memory_order_relaxed);
+    if (elapsed > maxNanos_.load(std::memory_order_relaxed)) {
+        maxNanos_.store(elapsed, std::memory_order_relaxed);
+    }
+    activeSpeakers_.store(activeCount, std::memory_order_relaxed);
+
+    // 所有房间共用一个分布，不按房间名打标签
+    static Histogram& tickHistogram = MetricsRegistry::instance().histogram(
+        "voicechat_mixer_tick_seconds", "Time spent mixing one room per 20 ms tick", 1e-9);
+    tickHistogram.record(elapsed);
+}
+
+MixerStats RoomMixer::stats() const {
+    MixerStats stats;
+    stats.ticks = ticks_.load(std::memory_order_relaxed);
+    stats.totalNanos = totalNanos_.load(std::memory_order_relaxed);
+    stats.maxNanos = maxNanos_.load(std::memory_order_relaxed);
+    stats.speakers = activeSpeakers_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace voicechat
@@ -1,4 +1,8 @@
 #include "voice_server.hpp"
+#include "metrics_server.hpp"
+#ifdef VOICECHAT_HAVE_IO_URING
+#include "uring_network.hpp"
+#endif
 #include <iostream>
 #include <string>
 #include <csignal>
@@ -33,21 +37,73 @@ void printServerStats(const VoiceServer& server) {
     std::cout << std::setw(20) << roomId << std::setw(15) << count << std::endl;
   }
   
+  std::cout << "\nMetrics:" << std::endl;
+  std::cout << MetricsRegistry::instance().renderSummary();
+  
   std::cout << "\nPress Ctrl+C to stop the server" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+  if (argc < 2 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " <port> [io_threads] [max_speakers]" << std::endl;
     return 1;
   }
 
   try {
     uint16_t port = static_cast<uint16_t>(std::stoi(argv[1]));
+    // IO线程数，默认使用硬件并发数
+    size_t ioThreads = argc >= 3 ? static_cast<size_t>(std::stoul(argv[2])) : 0;
+    
+    // 客户端单条消息体的上限（字节），由 VOICECHAT_MAX_FRAME_SIZE 设置
+    size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE;
+    if (const char* value = std::getenv("VOICECHAT_MAX_FRAME_SIZE")) {
+      maxFrameSize = static_cast<size_t>(std::stoul(value));
+    }
+    
+    // 网络后端由 VOICECHAT_NETWORK_BACKEND 选择：asio（默认）或 io_uring
+    std::unique_ptr<INetworkServer> network;
+    const char* backend = std::getenv("VOICECHAT_NETWORK_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+#ifdef VOICECHAT_HAVE_IO_URING
+      if (UringServer::isSupported()) {
+        network = std::make_unique<UringServer>(ioThreads, UringServer::DEFAULT_MAX_CLIENTS, maxFrameSize);
+      } else {
+        std::cerr << "io_uring is not supported by this kernel, using Boost.Asio" << std::endl;
+      }
+#else
+      std::cerr << "Built without io_uring support, using Boost.Asio" << std::endl;
+#endif
+    }
+    if (!network) {
+      network = std::make_unique<AsioServer>(ioThreads, AsioServer::DEFAULT_MAX_CLIENTS, maxFrameSize);
+    }
     
     // 创建服务器实例
-    VoiceServer server(port);
+    VoiceServer server(port, std::move(network));
     serverPtr = &server;
+    
+    // 每个房间同时转发的发言者数，0 表示不限制
+    if (argc == 4) {
+      server.setMaxForwardedSpeakers(static_cast<size_t>(std::stoul(argv[3])));
+    }
+
+    // 设置 VOICECHAT_PEERS（"节点ID@主机:端口,..."）时与这些节点桥接同名房间，
+    // 所有节点可以使用同一份列表；本节点ID由 VOICECHAT_NODE_ID 设置，默认为 node-<端口>。
+    // VOICECHAT_BRIDGE_SECRET 为各节点共用的链路密钥，随 HELLO 明文发送，节点之间应使用内网或加密隧道
+    if (const char* peers = std::getenv("VOICECHAT_PEERS")) {
+      std::string nodeId = "node-" + std::to_string(port);
+      if (const char* id = std::getenv("VOICECHAT_NODE_ID")) {
+        nodeId = id;
+      }
+      std::string secret;
+      if (const char* value = std::getenv("VOICECHAT_BRIDGE_SECRET")) {
+        secret = value;
+      }
+      if (secret.empty()) {
+        std::cerr << "警告: 未设置 VOICECHAT_BRIDGE_SECRET，只按节点ID校验桥接链路" << std::endl;
+      }
+      server.enableBridge(nodeId, parseBridgePeers(peers), secret);
+    }
 
     // 注册信号处理
     std::signal(SIGINT, signalHandler);
@@ -60,14 +116,30 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "Server is running on port " << port << std::endl;
 
+    // 设置 VOICECHAT_METRICS_PORT 时在本机该端口提供 Prometheus 格式的指标
+    MetricsServer metricsServer;
+    if (const char* metricsPort = std::getenv("VOICECHAT_METRICS_PORT")) {
+      metricsServer.start(static_cast<uint16_t>(std::stoi(metricsPort)));
+    }
+
+    // 定期输出统计信息的间隔（秒），由 VOICECHAT_STATS_INTERVAL 设置，0 表示只在启动时输出
+    int statsInterval = 10;
+    if (const char* interval = std::getenv("VOICECHAT_STATS_INTERVAL")) {
+      statsInterval = std::stoi(interval);
+    }
+
     printServerStats(server);
     // 主循环
+    int elapsed = 0;
     while (running) {
-      // printServerStats(server);
       std::this_thread::sleep_for(std::chrono::seconds(1));
+      if (statsInterval > 0 && ++elapsed % statsInterval == 0 && running) {
+        printServerStats(server);
+      }
     }
 
     std::cout << "\nShutting down server..." << std::endl;
+    metricsServer.stop();
     server.stop();
     serverPtr = nullptr;
 
@@ -0,0 +1,96 @@
+#include "speaker_selector.hpp"
+#include <algorithm>
+
+namespace voicechat {
+
+namespace {
+// 电平平滑系数，每个20ms数据包更新一次，时间常数约100ms
+constexpr float SCORE_SMOOTHING = 0.2f;
+}
+
+SpeakerSelector::SpeakerSelector(size_t maxSpeakers)
+    : maxSpeakers_(maxSpeakers)
+{
+}
+
+bool SpeakerSelector::shouldForward(ClientId speaker, uint32_t level, Clock::time_point now) {
+    size_t maxSpeakers = maxSpeakers_.load(std::memory_order_relaxed);
+    if (maxSpeakers == 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    SpeakerState& state = speakers_[speaker];
+    state.score += (static_cast<float>(level) - state.score) * SCORE_SMOOTHING;
+    bool active = level >= ACTIVE_LEVEL;
+    if (active) {
+        state.lastActive = now;
+    }
+
+    // 已选中的发言者一直转发（包括其静音帧），直到被替换或离开
+    if (state.selected) {
+        return true;
+    }
+    if (!active) {
+        return false;
+    }
+
+    auto select = [&]() {
+        state.selected = true;
+        state.selectedSince = now;
+        selected_.push_back(speaker);
+    };
+    if (selected_.size() < maxSpeakers) {
+        select();
+        return true;
+    }
+
+    // 找出可被替换的最弱发言者：已长时间不说话的优先，
+    // 其次是超过最短保持时间且电平最低的
+    auto weakest = selected_.end();
+    bool weakestStale = false;
+    float weakestScore = 0.0f;
+    for (auto it = selected_.begin(); it != selected_.end(); ++it) {
+        const SpeakerState& candidate = speakers_[*it];
+        bool stale = now - candidate.lastActive > SPEAKER_TIMEOUT;
+        if (!stale && now - candidate.selectedSince < MIN_HOLD) {
+            continue;
+        }
+        if (weakest == selected_.end() || (stale && !weakestStale) ||
+            (stale == weakestStale && candidate.score < weakestScore)) {
+            weakest = it;
+            weakestStale = stale;
+            weakestScore = candidate.score;
+        }
+    }
+    if (weakest == selected_.end()) {
+        return false;
+    }
+    if (!weakestStale && state.score < weakestScore + LEVEL_HYSTERESIS) {
+        return false;
+    }
+
+    speakers_[*weakest].selected = false;
+    selected_.erase(weakest);
+    select();
+    return true;
+}
+
+void SpeakerSelector::removeSpeaker(ClientId speaker) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    speakers_.erase(speaker);
+    selected_.erase(std::remove(selected_.begin(), selected_.end(), speaker), selected_.end());
+}
+
+void SpeakerSelector::setMaxSpeakers(size_t maxSpeakers) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxSpeakers_.store(maxSpeakers, std::memory_order_relaxed);
+
+    // 数量减少时从最近选中的开始让出名额
+    while (maxSpeakers > 0 && selected_.size() > maxSpeakers) {
+        speakers_[selected_.back()].selected = false;
+        selected_.pop_back();
+    }
+}
+
+} // namespace voicechat
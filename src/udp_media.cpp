@@ -0,0 +1,90 @@
+#include "udp_media.hpp"
+#include "logger.hpp"
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <sstream>
+
+namespace voicechat {
+
+namespace {
+
+double randomUnit() {
+    thread_local std::mt19937 generator{std::random_device{}()};
+    return std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+}
+
+} // namespace
+
+UdpImpairment::UdpImpairment()
+    : lossRate_(0.0)
+    , duplicateRate_(0.0)
+    , delayMs_(0)
+    , jitterMs_(0)
+{
+}
+
+UdpImpairment UdpImpairment::fromEnvironment() {
+    const char* spec = std::getenv("VOICECHAT_UDP_IMPAIR");
+    if (!spec) {
+        return UdpImpairment();
+    }
+    
+    UdpImpairment impairment = parse(spec);
+    VC_LOG_INFO("UDP损伤模拟已启用: " << spec);
+    return impairment;
+}
+
+UdpImpairment UdpImpairment::parse(const std::string& spec) {
+    UdpImpairment impairment;
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        size_t pos = item.find('=');
+        if (pos == std::string::npos) {
+            continue;
+        }
+        std::string key = item.substr(0, pos);
+        double value = std::atof(item.c_str() + pos + 1);
+        if (key == "loss") {
+            impairment.lossRate_ = value;
+        } else if (key == "dup") {
+            impairment.duplicateRate_ = value;
+        } else if (key == "delay") {
+            impairment.delayMs_ = static_cast<int>(value);
+        } else if (key == "jitter") {
+            impairment.jitterMs_ = static_cast<int>(value);
+        } else {
+            VC_LOG_WARN("未知的UDP损伤参数: " << key);
+        }
+    }
+    return impairment;
+}
+
+bool UdpImpairment::enabled() const {
+    return lossRate_ > 0.0 || duplicateRate_ > 0.0 || delayMs_ > 0 || jitterMs_ > 0;
+}
+
+void UdpImpairment::submit(const boost::asio::any_io_executor& executor, std::function<void()> send) const {
+    if (randomUnit() < lossRate_) {
+        return;
+    }
+    
+    int copies = randomUnit() < duplicateRate_ ? 2 : 1;
+    for (int i = 0; i < copies; ++i) {
+        int delay = delayMs_ + static_cast<int>(randomUnit() * jitterMs_);
+        if (delay <= 0) {
+            send();
+            continue;
+        }
+        
+        auto timer = std::make_shared<boost::asio::steady_timer>(executor, std::chrono::milliseconds(delay));
+        timer->async_wait([timer, send](const boost::system::error_code& error) {
+            if (!error) {
+                send();
+            }
+        });
+    }
+}
+
+} // namespace voicechat
@@ -0,0 +1,816 @@
+#include "uring_network.hpp"
+#include "asio_network.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace voicechat {
+
+namespace {
+
+// 直接使用内核接口，不依赖 liburing
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned argCount) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+}
+
+// 与内核共享的环形队列指针需要按获取/释放语义访问
+template <typename T>
+T loadAcquire(const T* p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void storeRelease(T* p, T value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+// user_data：低3位为操作类型，其余位为连接指针（连接对象至少8字节对齐）
+enum OpType : uint64_t {
+  OP_ACCEPT = 1,
+  OP_RECV = 2,
+  OP_SEND = 3,
+  OP_WAKE = 4,
+};
+constexpr uint64_t OP_MASK = 7;
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+
+// io_uring 实例的最小封装。只由所属的工作线程提交，提交队列不需要加锁
+class Ring {
+public:
+  Ring() = default;
+  ~Ring() {
+    if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != MAP_FAILED) ::munmap(sqRing_, sqRingSize_);
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  bool init(unsigned entries) {
+    // 完成队列放大，multishot 操作在一轮中可能产生大量完成事件
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * 4;
+    fd_ = ioUringSetup(entries, &params);
+    if (fd_ < 0 && errno == EINVAL) {
+      params = io_uring_params{};
+      params.flags = IORING_SETUP_CQSIZE;
+      params.cq_entries = entries * 4;
+      fd_ = ioUringSetup(entries, &params);
+    }
+    if (fd_ < 0) {
+      return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+      sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      return false;
+    }
+    cqRing_ = singleMmap ? sqRing_
+                         : ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  fd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED) {
+      return false;
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    auto* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  // 取一个空闲的提交项；队列已满时先把已准备的提交给内核
+  io_uring_sqe* nextSqe() {
+    if (sqeTail_ - loadAcquire(sqHead_) >= sqEntries_) {
+      submit(0);
+    }
+    unsigned index = sqeTail_ & sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+  }
+
+  // 提交所有已准备的操作，并等待至少 waitCount 个完成事件
+  void submit(unsigned waitCount) {
+    storeRelease(sqTail_, sqeTail_);
+    for (;;) {
+      unsigned pending = sqeTail_ - loadAcquire(sqHead_);
+      if (pending == 0 && waitCount == 0) {
+        return;
+      }
+      int result = ioUringEnter(fd_, pending, waitCount, waitCount > 0 ? IORING_ENTER_GETEVENTS : 0);
+      if (result >= 0) {
+        return;
+      }
+      // 被信号打断时重试；完成队列溢出时先返回让调用者处理完成事件
+      if (errno != EINTR) {
+        if (errno != EBUSY && errno != EAGAIN) {
+          VC_LOG_ERROR("io_uring_enter 失败: " << std::strerror(errno));
+        }
+        return;
+      }
+    }
+  }
+
+  // 处理本轮开始时已完成的事件；处理期间新到的留到下一轮，避免持续的接收饿死发送
+  template <typename Func>
+  void drain(Func handle) {
+    unsigned head = *cqHead_;
+    unsigned tail = loadAcquire(cqTail_);
+    while (head != tail) {
+      io_uring_cqe cqe = cqes_[head & cqMask_];
+      ++head;
+      storeRelease(cqHead_, head);
+      handle(cqe);
+    }
+  }
+
+  int fd() const { return fd_; }
+
+private:
+  int fd_ = -1;
+  void* sqRing_ = MAP_FAILED;
+  size_t sqRingSize_ = 0;
+  void* cqRing_ = MAP_FAILED;
+  size_t cqRingSize_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqesSize_ = 0;
+
+  unsigned* sqHead_ = nullptr;
+  unsigned* sqTail_ = nullptr;
+  unsigned* sqArray_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned sqEntries_ = 0;
+  unsigned sqeTail_ = 0;  // 已准备但可能尚未发布给内核的尾部
+
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+// 分配并注册接收缓冲区环（Linux 5.19+），失败时返回 MAP_FAILED
+void* mapBufferRing(Ring& ring, unsigned entries) {
+  size_t size = entries * sizeof(io_uring_buf);
+  void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<uint64_t>(memory);
+  reg.ring_entries = entries;
+  reg.bgid = RECV_BUFFER_GROUP;
+  if (ioUringRegister(ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    ::munmap(memory, size);
+    return MAP_FAILED;
+  }
+  return memory;
+}
+
+// 传输层指标，与 AsioServer 使用相同的名称，发送统计由 OutboundQueue 记录
+struct UringMetrics {
+  Counter& packetsIn;
+  Counter& bytesIn;
+  Gauge& clients;
+
+  static UringMetrics& instance() {
+    static UringMetrics metrics(MetricsRegistry::instance());
+    return metrics;
+  }
+
+private:
+  explicit UringMetrics(MetricsRegistry& r)
+    : packetsIn(r.counter("voicechat_packets_received_total", "Frames received", "transport=\"tcp\""))
+    , bytesIn(r.counter("voicechat_bytes_received_total", "Bytes received", "transport=\"tcp\""))
+    , clients(r.gauge("voicechat_connected_clients", "Connected TCP clients"))
+  {
+  }
+};
+
+} // namespace
+
+// 单个客户端连接。除发送队列和 closing 外，其余状态只在所属工作线程上访问
+struct alignas(8) UringServer::Connection {
+  Connection(int socketFd, Worker& worker) : fd(socketFd), owner(worker) {}
+
+  int fd;
+  Worker& owner;
+  ClientId id = INVALID_HANDLE;
+  OutboundQueue writeQueue;
+  std::atomic<bool> closing{false};  // 发送队列写完后关闭
+
+  std::vector<boost::asio::const_buffer> batch;
+  std::vector<iovec> iov;
+  size_t iovIndex = 0;  // 部分写出后从该项继续
+  msghdr message{};
+  bool writeActive = false;
+  bool closed = false;
+  unsigned pendingOps = 0;
+  std::vector<uint8_t> input;  // 尚未组成完整帧的数据，消息体直接以视图交给上层
+};
+
+struct UringServer::Worker {
+  explicit Worker(UringServer& owner) : server(owner) {}
+
+  ~Worker() {
+    if (bufferRing != MAP_FAILED) ::munmap(bufferRing, bufferRingSize);
+    if (eventFd >= 0) ::close(eventFd);
+  }
+
+  bool init() {
+    if (!ring.init(RING_ENTRIES)) {
+      return false;
+    }
+    eventFd = ::eventfd(0, EFD_CLOEXEC);
+    if (eventFd < 0) {
+      return false;
+    }
+
+    // 注册接收缓冲区环，multishot recv 完成时由内核从中选取缓冲区
+    bufferRingSize = RECV_BUFFER_COUNT * sizeof(io_uring_buf);
+    bufferRing = mapBufferRing(ring, RECV_BUFFER_COUNT);
+    if (bufferRing == MAP_FAILED) {
+      return false;
+    }
+    bufferStorage.resize(RECV_BUFFER_COUNT * RECV_BUFFER_SIZE);
+    for (unsigned i = 0; i < RECV_BUFFER_COUNT; ++i) {
+      recycleBuffer(static_cast<uint16_t>(i));
+    }
+    return true;
+  }
+
+  void run() {
+    threadId.store(std::this_thread::get_id(), std::memory_order_release);
+    while (server.running_) {
+      ring.submit(1);
+      ring.drain([this](const io_uring_cqe& cqe) {
+        handleCompletion(cqe);
+      });
+      processReady();
+    }
+  }
+
+  // 由任意线程调用：把连接加入待处理列表，必要时唤醒工作线程
+  void post(std::shared_ptr<Connection> connection) {
+    if (std::this_thread::get_id() == threadId.load(std::memory_order_acquire)) {
+      localReady.push_back(std::move(connection));
+      return;
+    }
+    bool wasEmpty;
+    {
+      std::lock_guard<std::mutex> lock(readyMutex);
+      wasEmpty = ready.empty();
+      ready.push_back(std::move(connection));
+    }
+    if (wasEmpty) {
+      wake();
+    }
+  }
+
+  void wake() {
+    uint64_t one = 1;
+    ssize_t written = ::write(eventFd, &one, sizeof(one));
+    (void)written;
+  }
+
+  void prepareAccept() {
+    io_uring_sqe* sqe = ring.nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server.listenFd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = OP_ACCEPT;
+  }
+
+  void prepareWake() {
+    io_uring_sqe* sqe = ring.nextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = eventFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&eventValue);
+    sqe->len = sizeof(eventValue);
+    sqe->user_data = OP_WAKE;
+  }
+
+  void prepareRecv(Connection& connection) {
+    io_uring_sqe* sqe = ring.nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = reinterpret_cast<uint64_t>(&connection) | OP_RECV;
+    addOp(connection);
+  }
+
+  void prepareSend(Connection& connection) {
+    connection.message.msg_iov = connection.iov.data() + connection.iovIndex;
+    connection.message.msg_iovlen = connection.iov.size() - connection.iovIndex;
+    io_uring_sqe* sqe = ring.nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&connection.message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(&connection) | OP_SEND;
+    addOp(connection);
+  }
+
+  void recycleBuffer(uint16_t bufferId) {
+    auto* bufs = static_cast<io_uring_buf*>(bufferRing);
+    io_uring_buf& buf = bufs[bufferTail & (RECV_BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(bufferStorage.data() + static_cast<size_t>(bufferId) * RECV_BUFFER_SIZE);
+    buf.len = RECV_BUFFER_SIZE;
+    buf.bid = bufferId;
+    ++bufferTail;
+    // 环的尾指针与第一个缓冲区描述的保留字段重叠
+    storeRelease(&static_cast<io_uring_buf_ring*>(bufferRing)->tail, bufferTail);
+  }
+
+  void addOp(Connection& connection) {
+    ++connection.pendingOps;
+  }
+
+  // 已关闭的连接在最后一个操作完成后关闭描述符并释放，调用者之后不能再访问该连接
+  void releaseOp(Connection& connection) {
+    if (--connection.pendingOps == 0 && connection.closed) {
+      ::close(connection.fd);
+      connections.erase(&connection);
+    }
+  }
+
+  void handleCompletion(const io_uring_cqe& cqe) {
+    uint64_t op = cqe.user_data & OP_MASK;
+    auto* connection = reinterpret_cast<Connection*>(cqe.user_data & ~OP_MASK);
+    switch (op) {
+      case OP_ACCEPT:
+        onAccept(cqe.res, cqe.flags);
+        break;
+      case OP_RECV:
+        onRecv(*connection, cqe.res, cqe.flags);
+        break;
+      case OP_SEND:
+        onSend(*connection, cqe.res);
+        break;
+      case OP_WAKE:
+        if (server.running_) {
+          prepareWake();
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  void onAccept(int result, uint32_t flags) {
+    if (result >= 0) {
+      auto connection = server.addClient(result, *this);
+      if (!connection) {
+        ::close(result);
+      } else {
+        connections.emplace(connection.get(), connection);
+        if (server.clientConnectedCallback_) {
+          server.clientConnectedCallback_(connection->id);
+        }
+        prepareRecv(*connection);
+      }
+    }
+    // multishot 结束（如出错）后重新发起
+    if (!(flags & IORING_CQE_F_MORE) && server.running_) {
+      prepareAccept();
+    }
+  }
+
+  void onRecv(Connection& connection, int result, uint32_t flags) {
+    if (result > 0) {
+      auto bufferId = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+      const uint8_t* data = bufferStorage.data() + static_cast<size_t>(bufferId) * RECV_BUFFER_SIZE;
+      if (!connection.closed) {
+        connection.input.insert(connection.input.end(), data, data + result);
+        deliverFrames(connection);
+      }
+      recycleBuffer(bufferId);
+    }
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+      // 缓冲区暂时用尽（-ENOBUFS）时重新发起，已归还的缓冲区可以继续使用
+      if (!connection.closed && (result > 0 || result == -ENOBUFS)) {
+        prepareRecv(connection);
+      } else if (!connection.closed) {
+        closeConnection(connection);
+      }
+      releaseOp(connection);
+    }
+  }
+
+  // 从累积的数据中切出完整的帧交给上层
+  void deliverFrames(Connection& connection) {
+    auto& metrics = UringMetrics::instance();
+    size_t offset = 0;
+    while (!connection.closed && connection.input.size() - offset >= FrameBuffer::HEADER_SIZE) {
+      uint32_t dataSize = 0;
+      for (size_t i = 0; i < FrameBuffer::HEADER_SIZE; ++i) {
+        dataSize |= (static_cast<uint32_t>(connection.input[offset + i]) << (8 * i));
+      }
+      // 长度头来自不可信的客户端，超过上限时断开，不等待也不缓存该帧
+      if (dataSize > server.maxFrameSize_) {
+        VC_LOG_WARN("客户端 " << connection.id << " 的消息长度 " << dataSize << " 超过上限 "
+                    << server.maxFrameSize_ << "，断开连接");
+        closeConnection(connection);
+        return;
+      }
+      size_t frameSize = FrameBuffer::HEADER_SIZE + dataSize;
+      if (connection.input.size() - offset < frameSize) {
+        break;
+      }
+      const uint8_t* body = connection.input.data() + offset + FrameBuffer::HEADER_SIZE;
+      offset += frameSize;
+      metrics.packetsIn.add();
+      metrics.bytesIn.add(frameSize);
+      if (server.messageCallback_) {
+        server.messageCallback_(connection.id, ByteSpan(body, dataSize));
+      }
+    }
+    connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+  }
+
+  // 处理其他线程交来的连接：发起写操作，或在队列写完后关闭
+  void processReady() {
+    {
+      std::lock_guard<std::mutex> lock(readyMutex);
+      if (!ready.empty()) {
+        localReady.insert(localReady.end(), std::make_move_iterator(ready.begin()),
+                          std::make_move_iterator(ready.end()));
+        ready.clear();
+      }
+    }
+    // 逐个处理期间可能有新的连接加入 localReady
+    for (size_t i = 0; i < localReady.size(); ++i) {
+      auto connection = std::move(localReady[i]);
+      if (!connection->closed && !connection->writeActive) {
+        startWrite(*connection);
+      }
+    }
+    localReady.clear();
+  }
+
+  void startWrite(Connection& connection) {
+    // 把积压的消息合并为一次 scatter-gather 写
+    if (!connection.writeQueue.takeBatch(connection.batch)) {
+      if (connection.closing) {
+        closeConnection(connection);
+      }
+      return;
+    }
+    connection.iov.clear();
+    for (const auto& buffer : connection.batch) {
+      connection.iov.push_back(iovec{const_cast<void*>(buffer.data()), buffer.size()});
+    }
+    connection.iovIndex = 0;
+    connection.writeActive = true;
+    prepareSend(connection);
+  }
+
+  void onSend(Connection& connection, int result) {
+    if (result < 0 || connection.closed) {
+      connection.writeActive = false;
+      connection.writeQueue.completeBatch();
+      if (!connection.closed) {
+        closeConnection(connection);
+      }
+      releaseOp(connection);
+      return;
+    }
+
+    // 部分写出时跳过已写完的部分继续发送
+    auto remaining = static_cast<size_t>(result);
+    while (connection.iovIndex < connection.iov.size() && remaining >= connection.iov[connection.iovIndex].iov_len) {
+      remaining -= connection.iov[connection.iovIndex].iov_len;
+      ++connection.iovIndex;
+    }
+    if (connection.iovIndex < connection.iov.size()) {
+      iovec& partial = connection.iov[connection.iovIndex];
+      partial.iov_base = static_cast<uint8_t*>(partial.iov_base) + remaining;
+      partial.iov_len -= remaining;
+      prepareSend(connection);
+    } else {
+      connection.writeActive = false;
+      connection.writeQueue.completeBatch();
+      startWrite(connection);
+    }
+    releaseOp(connection);
+  }
+
+  // 关闭连接：shutdown 使未完成的接收和发送结束，最后一个操作完成后关闭描述符
+  void closeConnection(Connection& connection) {
+    connection.closed = true;
+    ::shutdown(connection.fd, SHUT_RDWR);
+    ClientId clientId = connection.id;
+    if (connection.pendingOps == 0) {
+      ::close(connection.fd);
+      connections.erase(&connection);
+    }
+    server.removeClient(clientId);
+  }
+
+  UringServer& server;
+  Ring ring;
+  int eventFd = -1;
+  uint64_t eventValue = 0;
+  void* bufferRing = MAP_FAILED;
+  size_t bufferRingSize = 0;
+  uint16_t bufferTail = 0;
+  std::vector<uint8_t> bufferStorage;
+
+  // 本线程负责的连接，连接关闭且没有未完成的操作后移除；完成事件中的连接指针在此期间有效
+  std::unordered_map<Connection*, std::shared_ptr<Connection>> connections;
+
+  std::mutex readyMutex;
+  std::vector<std::shared_ptr<Connection>> ready;       // 其他线程交来的连接
+  std::vector<std::shared_ptr<Connection>> localReady;  // 仅工作线程访问
+  std::thread thread;
+  // 由 run() 记录，post() 据此判断调用者是否为本工作线程；先启动的工作线程可能在 start()
+  // 为后面的工作线程赋值 thread 时向其投递，因此不能读取 thread.get_id()
+  std::atomic<std::thread::id> threadId{};
+};
+
+UringServer::UringServer(size_t workerThreads, size_t maxClients, size_t maxFrameSize)
+  : workerCount_(workerThreads > 0 ? workerThreads : std::max(1u, std::thread::hardware_concurrency()))
+  , maxFrameSize_(maxFrameSize)
+  , listenFd_(-1)
+  , clients_(maxClients)
+  , connectionTable_(clients_.capacity())
+  , running_(false)
+{
+}
+
+UringServer::~UringServer() {
+  stop();
+}
+
+bool UringServer::isSupported() {
+  // multishot recv 需要 Linux 6.0
+  utsname name{};
+  int major = 0;
+  int minor = 0;
+  if (::uname(&name) != 0 || std::sscanf(name.release, "%d.%d", &major, &minor) != 2 || major < 6) {
+    return false;
+  }
+  Ring ring;
+  if (!ring.init(8)) {
+    return false;
+  }
+  void* bufferRing = mapBufferRing(ring, 8);
+  if (bufferRing == MAP_FAILED) {
+    return false;
+  }
+  ::munmap(bufferRing, 8 * sizeof(io_uring_buf));
+  return true;
+}
+
+bool UringServer::start(uint16_t port) {
+  listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0) {
+    VC_LOG_ERROR("Server start error: " << std::strerror(errno));
+    return false;
+  }
+  int reuse = 1;
+  ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      ::listen(listenFd_, SOMAXCONN) < 0) {
+    VC_LOG_ERROR("Server start error: " << std::strerror(errno));
+    ::close(listenFd_);
+    listenFd_ = -1;
+    return false;
+  }
+
+  for (size_t i = 0; i < workerCount_; ++i) {
+    auto worker = std::make_unique<Worker>(*this);
+    if (!worker->init()) {
+      VC_LOG_ERROR("io_uring 初始化失败: " << std::strerror(errno));
+      workers_.clear();
+      ::close(listenFd_);
+      listenFd_ = -1;
+      return false;
+    }
+    workers_.push_back(std::move(worker));
+  }
+
+  // 每个工作线程都在监听 socket 上发起 multishot accept，新连接由内核分配给其中一个
+  running_ = true;
+  for (auto& worker : workers_) {
+    worker->prepareAccept();
+    worker->prepareWake();
+    Worker* w = worker.get();
+    worker->thread = std::thread([w]() {
+      w->run();
+    });
+  }
+  VC_LOG_INFO("io_uring 网络后端已启动，工作线程数: " << workerCount_);
+  return true;
+}
+
+void UringServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  ::shutdown(listenFd_, SHUT_RDWR);
+  for (auto& worker : workers_) {
+    worker->wake();
+  }
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+
+  // 工作线程已退出，关闭所有连接；关闭 ring 时内核取消未完成的操作
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    clients_.forEach([this](ClientId clientId, std::shared_ptr<Connection>&) {
+      std::atomic_store(&connectionTable_[handleIndex(clientId)], std::shared_ptr<Connection>());
+    });
+    clients_.clear();
+  }
+  for (auto& worker : workers_) {
+    for (auto& entry : worker->connections) {
+      ::close(entry.second->fd);
+    }
+  }
+  workers_.clear();
+  ::close(listenFd_);
+  listenFd_ = -1;
+}
+
+void UringServer::broadcast(const std::vector<uint8_t>& data) {
+  std::vector<ClientId> clientIds;
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    clientIds.reserve(clients_.size());
+    clients_.forEach([&clientIds](ClientId clientId, const std::shared_ptr<Connection>&) {
+      clientIds.push_back(clientId);
+    });
+  }
+  multicastFrame(clientIds, makeFrame(data.data(), data.size()), SendPriority::Control);
+}
+
+bool UringServer::sendTo(ClientId clientId, const std::vector<uint8_t>& data, SendPriority priority) {
+  return sendFrame(clientId, makeFrame(data.data(), data.size()), priority);
+}
+
+bool UringServer::sendFrame(ClientId clientId, SharedFrame frame, SendPriority priority) {
+  auto connection = findClient(clientId);
+  if (!connection) {
+    return false;
+  }
+  if (connection->writeQueue.push(std::move(frame), priority)) {
+    scheduleWrite(connection);
+  }
+  return true;
+}
+
+void UringServer::multicastFrame(const std::vector<ClientId>& clientIds, SharedFrame frame,
+                                 SendPriority priority) {
+  // 各连接的写操作由其工作线程在下一轮事件处理中一次性提交
+  for (ClientId clientId : clientIds) {
+    auto connection = findClient(clientId);
+    if (connection && connection->writeQueue.push(frame, priority)) {
+      scheduleWrite(connection);
+    }
+  }
+}
+
+uint32_t UringServer::getMediaToken(ClientId /*clientId*/) {
+  return 0;
+}
+
+size_t UringServer::maxClients() const {
+  return connectionTable_.size();
+}
+
+void UringServer::disconnectClient(ClientId clientId) {
+  auto connection = findClient(clientId);
+  if (!connection) {
+    return;
+  }
+  // 有写操作进行中时由写链在队列清空后关闭
+  connection->closing = true;
+  scheduleWrite(connection);
+}
+
+void UringServer::setClientConnectedCallback(ClientCallback callback) {
+  clientConnectedCallback_ = std::move(callback);
+}
+
+void UringServer::setClientDisconnectedCallback(ClientCallback callback) {
+  clientDisconnectedCallback_ = std::move(callback);
+}
+
+void UringServer::setMessageCallback(ClientMessageCallback callback) {
+  messageCallback_ = std::move(callback);
+}
+
+std::shared_ptr<UringServer::Connection> UringServer::findClient(ClientId clientId) {
+  size_t index = handleIndex(clientId);
+  if (clientId == INVALID_HANDLE || index >= connectionTable_.size()) {
+    return nullptr;
+  }
+  auto connection = std::atomic_load(&connectionTable_[index]);
+  if (!connection || connection->id != clientId) {
+    return nullptr;
+  }
+  return connection;
+}
+
+void UringServer::scheduleWrite(const std::shared_ptr<Connection>& connection) {
+  connection->owner.post(connection);
+}
+
+std::shared_ptr<UringServer::Connection> UringServer::addClient(int fd, Worker& worker) {
+  auto connection = std::make_shared<Connection>(fd, worker);
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    connection->id = clients_.insert(connection);
+    if (connection->id != INVALID_HANDLE) {
+      std::atomic_store(&connectionTable_[handleIndex(connection->id)], connection);
+    }
+  }
+  if (connection->id == INVALID_HANDLE) {
+    VC_LOG_WARN("客户端数量已达上限 " << clients_.capacity() << "，拒绝新连接");
+    return nullptr;
+  }
+  UringMetrics::instance().clients.add();
+  return connection;
+}
+
+void UringServer::removeClient(ClientId clientId) {
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    if (!clients_.find(clientId)) {
+      return;
+    }
+    clients_.erase(clientId);
+    std::atomic_store(&connectionTable_[handleIndex(clientId)], std::shared_ptr<Connection>());
+  }
+  UringMetrics::instance().clients.sub();
+
+  // 在锁外回调，避免与上层的锁形成顺序反转
+  if (clientDisconnectedCallback_) {
+    clientDisconnectedCallback_(clientId);
+  }
+}
+
+} // namespace voicechat
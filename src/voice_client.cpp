@@ -1,33 +1,95 @@
 #include "voice_client.hpp"
-#include <iostream>
-#include <cstring>
+#include "logger.hpp"
+#include "protocol.hpp"
+#include "metrics.hpp"
+#include "mix_kernels.hpp"
 #include <unordered_map>
 #include <sstream>
-#include <iomanip>
 
 namespace voicechat {
 
-VoiceClient::VoiceClient(const std::string& userId)
+namespace {
+
+struct PlayoutMetrics {
+    Counter& packets;
+    Counter& fec;
+    Counter& concealed;
+    Counter& late;
+    Histogram& delay;
+    Gauge& speakers;
+    Counter& captureXruns;
+
+    static PlayoutMetrics& instance() {
+        static PlayoutMetrics metrics(MetricsRegistry::instance());
+        return metrics;
+    }
+
+private:
+    explicit PlayoutMetrics(MetricsRegistry& r)
+        : packets(r.counter("voicechat_playout_frames_total", "Played frames by jitter buffer outcome",
+                            "result=\"packet\""))
+        , fec(r.counter("voicechat_playout_frames_total", "Played frames by jitter buffer outcome",
+                        "result=\"fec\""))
+        , concealed(r.counter("voicechat_playout_frames_total", "Played frames by jitter buffer outcome",
+                              "result=\"conceal\""))
+        , late(r.counter("voicechat_playout_late_packets_total", "Packets that arrived after their playout time"))
+        , delay(r.histogram("voicechat_jitter_buffer_delay_seconds",
+                            "Jitter buffer delay when a packet is played", 1e-3))
+        , speakers(r.gauge("voicechat_playout_speakers", "Remote speakers mixed into the last rendered block"))
+        // 采集环形缓冲溢出与声卡的采集溢出计入同一指标
+        , captureXruns(r.counter("voicechat_audio_xruns_total",
+                                 "Audio buffer overflows (capture) and underruns (playback)", "stream=\"capture\""))
+    {
+    }
+};
+
+} // namespace
+
+VoiceClient::VoiceClient(const std::string& userId, std::unique_ptr<IDuplexAudioDevice> audioDevice)
     : userId_(userId)
+    , inRoom_(false)
     , muted_(false)
     , running_(false)
+    , audioOpen_(false)
+    , sourceId_(0)
+    , mediaSequence_(0)
+    , mediaTimestamp_(0)
+    , playbackGain_(1.0f)
+    , captureRing_(std::make_unique<SpscRing<float>>(48000 * AUDIO_RING_MILLISECONDS / 1000))
+    , playoutRing_(std::make_unique<SpscRing<float>>(48000 * AUDIO_RING_MILLISECONDS / 1000))
+    , captureOverflow_(0)
+    , renderBlock_(0)
+    , mediaRunning_(false)
 {
-    // 初始化音频设备（作为输入设备）
-    audioDevice_ = std::make_unique<PortAudioDevice>(true);
-    audioDevice_->setCallback([this](const std::vector<float>& data) {
-        // 将float数据转换为uint8_t
-        std::vector<uint8_t> audioData(data.size() * sizeof(float));
-        std::memcpy(audioData.data(), data.data(), audioData.size());
-        onAudioData(audioData);
+    // 未指定音频设备时使用声卡，流在第一次加入房间时打开
+    audioDevice_ = audioDevice ? std::move(audioDevice) : std::make_unique<PortAudioDuplexDevice>();
+    // 两个回调都在设备的音频线程中执行，渲染回调只读取媒体线程解码、混音好的数据。
+    // 实时回调中不能编码和发送，采集数据交给媒体线程；其他设备的音频线程直接编码发送
+    if (audioDevice_->realtimeCallbacks()) {
+        audioDevice_->setCaptureCallback([this](const float* samples, size_t count) {
+            queueCapture(samples, count);
+        });
+    } else {
+        audioDevice_->setCaptureCallback([this](const float* samples, size_t count) {
+            onAudioData(samples, count);
+        });
+    }
+    audioDevice_->setRenderCallback([this](float* output, size_t samples) {
+        renderAudio(output, samples);
     });
 
-    // 初始化音频编解码器
+    // 初始化发送端的编码器，接收端每个远端发言者使用单独的解码器
     audioCodec_ = std::make_unique<OpusCodec>();
     audioCodec_->initialize(48000, 1); // 48kHz, 单声道
+    frameBlocker_.setFrameSamples(static_cast<size_t>(audioCodec_->frameSize()));
 }
 
 VoiceClient::~VoiceClient() {
     disconnect();
+    // 回调引用本对象，设备先于其他成员停止
+    audioDevice_->stop();
+    stopMedia();
+    resetPlayout();
 }
 
 bool VoiceClient::connect(const std::string& host, uint16_t port) {
@@ -38,7 +100,7 @@ bool VoiceClient::connect(const std::string& host, uint16_t port) {
         });
         
         if (!connection_->connect(host, port)) {
-            std::cerr << "Failed to connect to server" << std::endl;
+            VC_LOG_ERROR("Failed to connect to server");
             return false;
         }
 
@@ -46,45 +108,45 @@ bool VoiceClient::connect(const std::string& host, uint16_t port) {
         ControlMessage msg;
         msg.set_type(ControlMessage::JOIN);
         msg.set_user_id(userId_);
+        msg.set_protocol_version(PROTOCOL_VERSION);
         
-        std::vector<uint8_t> data(msg.ByteSizeLong());
-        msg.SerializeToArray(data.data(), data.size());
-        connection_->send(data);
+        connection_->send(encodeFrame(FRAME_CONTROL, msg));
 
         running_ = true;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Exception in connect: " << e.what() << std::endl;
+        VC_LOG_ERROR("Exception in connect: " << e.what());
         return false;
     }
 }
 
 void VoiceClient::disconnect() {
+    // 先停止音频设备，音频线程不再使用连接后才能释放它
+    if (!currentRoomId_.empty()) {
+        leaveRoom();
+    }
+    
     if (connection_) {
         try {
             ControlMessage msg;
             msg.set_type(ControlMessage::LEAVE);
             msg.set_user_id(userId_);
+            msg.set_protocol_version(PROTOCOL_VERSION);
             
-            std::vector<uint8_t> data(msg.ByteSizeLong());
-            msg.SerializeToArray(data.data(), data.size());
-            connection_->send(data);
+            connection_->send(encodeFrame(FRAME_CONTROL, msg));
         } catch (const std::exception& e) {
-            std::cerr << "Exception in disconnect: " << e.what() << std::endl;
+            VC_LOG_ERROR("Exception in disconnect: " << e.what());
         }
 
         connection_.reset();
     }
     
     running_ = false;
-    if (!currentRoomId_.empty()) {
-        leaveRoom();
-    }
 }
 
 bool VoiceClient::joinRoom(const std::string& roomId) {
     if (!connection_) {
-        std::cerr << "Not connected to server" << std::endl;
+        VC_LOG_ERROR("Not connected to server");
         return false;
     }
 
@@ -92,23 +154,35 @@ bool VoiceClient::joinRoom(const std::string& roomId) {
         ControlMessage msg;
         msg.set_type(ControlMessage::JOIN);
         msg.set_user_id(userId_);
+        msg.set_protocol_version(PROTOCOL_VERSION);
         msg.set_room_id(roomId);
         
-        std::vector<uint8_t> data(msg.ByteSizeLong());
-        msg.SerializeToArray(data.data(), data.size());
-        connection_->send(data);
+        connection_->send(encodeFrame(FRAME_CONTROL, msg));
 
+        bool wasInRoom = !currentRoomId_.empty();
         currentRoomId_ = roomId;
-        
-        // 启动音频设备
-        if (!audioDevice_->start()) {
-            std::cerr << "Failed to start audio device" << std::endl;
-            return false;
+        inRoom_.store(true, std::memory_order_release);
+        
+        // 启动音频设备，切换房间时设备已在运行；设备只打开一次，之后离开和加入房间只停止和启动流
+        if (!wasInRoom) {
+            if (!audioOpen_) {
+                audioOpen_ = audioDevice_->initialize(48000, 1);
+                if (!audioOpen_) {
+                    VC_LOG_ERROR("Failed to open audio device");
+                    return false;
+                }
+            }
+            startMedia();
+            if (!audioDevice_->start()) {
+                stopMedia();
+                VC_LOG_ERROR("Failed to start audio device");
+                return false;
+            }
         }
 
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Exception in joinRoom: " << e.what() << std::endl;
+        VC_LOG_ERROR("Exception in joinRoom: " << e.what());
         return false;
     }
 }
@@ -118,182 +192,361 @@ bool VoiceClient::leaveRoom() {
         return false;
     }
 
+    // 先停止音频设备，设备保持打开；stop() 返回后音频线程不再发送
+    inRoom_.store(false, std::memory_order_release);
+    audioDevice_->stop();
+    stopMedia();
+    resetPlayout();
+
     try {
         ControlMessage msg;
         msg.set_type(ControlMessage::LEAVE);
         msg.set_user_id(userId_);
+        msg.set_protocol_version(PROTOCOL_VERSION);
         msg.set_room_id(currentRoomId_);
-        
-        std::vector<uint8_t> data(msg.ByteSizeLong());
-        msg.SerializeToArray(data.data(), data.size());
-        connection_->send(data);
-
         currentRoomId_.clear();
         
-        // 停止音频设备
-        audioDevice_->stop();
+        connection_->send(encodeFrame(FRAME_CONTROL, msg));
 
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Exception in leaveRoom: " << e.what() << std::endl;
+        VC_LOG_ERROR("Exception in leaveRoom: " << e.what());
         return false;
     }
 }
 
 void VoiceClient::setMuted(bool muted) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    muted_ = muted;
+    muted_.store(muted, std::memory_order_relaxed);
 }
 
 bool VoiceClient::isMuted() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return muted_;
+    return muted_.load(std::memory_order_relaxed);
 }
 
 void VoiceClient::onMessage(const std::vector<uint8_t>& data) {
     try {
-        std::cout << "收到服务器消息，大小: " << data.size() << " 字节" << std::endl;
-        
-        // 检查消息大小是否至少包含头部
-        if (data.size() < 4) {
-            std::cerr << "消息太短，无法包含头部" << std::endl;
-            return;
+        VC_LOG_TRACE("收到服务器消息，大小: " << data.size() << " 字节");
+        
+        // 按类型字节分发，每条消息只解析一次
+        // 长度头已由传输层去除，data 即为消息体
+        const uint8_t* payload = data.data() + FRAME_TYPE_SIZE;
+        int payloadSize = static_cast<int>(data.size() - FRAME_TYPE_SIZE);
+        switch (frameTypeOf(data.data(), data.size())) {
+            case FRAME_RESPONSE: {
+                ParseArena::Scope arena;
+                ServerResponse& response = *arena.create<ServerResponse>();
+                if (!response.ParseFromArray(payload, payloadSize)) {
+                    VC_LOG_WARN("服务器响应解析失败");
+                    return;
+                }
+                VC_LOG_DEBUG("状态: " << (response.status() == ServerResponse::SUCCESS ? "成功" : "失败"));
+                VC_LOG_DEBUG("消息内容: " << response.message());
+                handleServerResponse(response);
+                return;
+            }
+            case FRAME_MEDIA: {
+                MediaView audioData;
+                if (!parseMediaPacket(payload, data.size() - FRAME_TYPE_SIZE, audioData)) {
+                    VC_LOG_WARN("媒体包解析失败");
+                    return;
+                }
+                VC_LOG_TRACE("收到媒体包，源ID: " << audioData.header.sourceId);
+                handleAudioData(audioData);
+                return;
+            }
+            default:
+                VC_LOG_WARN("无法识别的服务器消息类型");
+                return;
         }
-        
-        // 解析消息长度（4字节，小端序）
-        uint32_t messageSize = 0;
-        for (int i = 0; i < 4; ++i) {
-            messageSize |= (static_cast<uint32_t>(data[i]) << (i * 8));
+    } catch (const std::exception& e) {
+        VC_LOG_ERROR("处理服务器消息时发生错误: " << e.what());
+    }
+}
+
+void VoiceClient::handleAudioData(const MediaView& audioData) {
+    uint32_t sourceId = audioData.header.sourceId;
+    if (!isMixerSourceId(sourceId) && sourceId == sourceId_.load(std::memory_order_relaxed)) {
+        return; // 忽略自己的音频
+    }
+
+    // 放入该发言者的抖动缓冲，由媒体线程按渲染回调取用的进度取出解码
+    std::lock_guard<std::mutex> lock(playoutMutex_);
+    RemoteSpeaker& speaker = speakers_[sourceId];
+    if (!speaker.decoder) {
+        if (!decoderPool_.empty()) {
+            speaker.decoder = std::move(decoderPool_.back());
+            decoderPool_.pop_back();
+        } else {
+            speaker.decoder = std::make_unique<OpusCodec>();
+            if (!speaker.decoder->initializeDecoder(48000, 1)) {
+                VC_LOG_ERROR("Failed to create decoder for source " << sourceId);
+                speakers_.erase(sourceId);
+                return;
+            }
         }
-        
-        std::cout << "消息头指示的数据大小: " << messageSize << " 字节" << std::endl;
-        
-        // 检查消息大小是否合理
-        if (data.size() != messageSize + 4) {
-            std::cerr << "消息大小不匹配，期望: " << (messageSize + 4) << "，实际: " << data.size() << std::endl;
-            return;
+    }
+    speaker.lastPacket = std::chrono::steady_clock::now();
+    uint64_t late = speaker.jitter.stats().late;
+    speaker.jitter.push(audioData.header, audioData.payload, speaker.lastPacket);
+    if (speaker.jitter.stats().late != late) {
+        PlayoutMetrics::instance().late.add();
+    }
+}
+
+void VoiceClient::setPlaybackGain(float gain) {
+    playbackGain_.store(gain, std::memory_order_relaxed);
+}
+
+void VoiceClient::resetPlayout() {
+    std::lock_guard<std::mutex> lock(playoutMutex_);
+    speakers_.clear();
+    decoderPool_.clear();
+}
+
+void VoiceClient::evictIdleSpeakers(std::chrono::steady_clock::time_point now) {
+    for (auto it = speakers_.begin(); it != speakers_.end();) {
+        RemoteSpeaker& speaker = it->second;
+        if (speaker.jitter.playing() || now - speaker.lastPacket < SPEAKER_IDLE_TIMEOUT) {
+            ++it;
+            continue;
         }
-        
-        // 获取实际消息数据
-        std::vector<uint8_t> messageData(data.begin() + 4, data.end());
-        
-        // 尝试解析为服务器响应
-        ServerResponse response;
-        if (response.ParseFromArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            std::cout << "成功解析为服务器响应消息" << std::endl;
-            std::cout << "状态: " << (response.status() == ServerResponse::SUCCESS ? "成功" : "失败") << std::endl;
-            std::cout << "消息内容: " << response.message() << std::endl;
-            handleServerResponse(response);
-            return;
+        if (decoderPool_.size() < MAX_POOLED_DECODERS) {
+            speaker.decoder->resetDecoder();
+            decoderPool_.push_back(std::move(speaker.decoder));
         }
-        std::cout << "不是服务器响应消息，尝试解析为音频消息" << std::endl;
+        it = speakers_.erase(it);
+    }
+}
 
-        // 尝试解析为音频数据
-        AudioData audioData;
-        if (audioData.ParseFromArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            std::cout << "成功解析为音频消息，来自用户: " << audioData.user_id() << std::endl;
-            handleAudioData(audioData);
-            return;
+bool VoiceClient::decodeNext(RemoteSpeaker& speaker) {
+    PlayoutMetrics& metrics = PlayoutMetrics::instance();
+    std::chrono::milliseconds delay = speaker.jitter.currentDelay();
+    speaker.pcmOffset = 0;
+    try {
+        switch (speaker.jitter.pop(speaker.payload)) {
+            case JitterBuffer::Playout::Empty:
+                speaker.pcm.clear();
+                return false;
+            case JitterBuffer::Playout::Packet:
+                metrics.packets.add();
+                metrics.delay.record(static_cast<uint64_t>(delay.count()));
+                speaker.pcm = speaker.decoder->decode(speaker.payload);
+                break;
+            case JitterBuffer::Playout::Fec:
+                metrics.fec.add();
+                speaker.pcm = speaker.decoder->decodeFec(speaker.payload);
+                break;
+            case JitterBuffer::Playout::Conceal:
+                metrics.concealed.add();
+                speaker.pcm = speaker.decoder->conceal();
+                break;
         }
+    } catch (const std::exception& e) {
+        VC_LOG_ERROR("Exception in playout: " << e.what());
+        speaker.pcm.clear();
+    }
+    return !speaker.pcm.empty();
+}
 
-        // 如果都解析失败，打印消息内容以便调试
-        std::cout << "无法解析消息内容，十六进制dump: ";
-        for (const auto& byte : messageData) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte) << " ";
+size_t VoiceClient::renderPlayout(float* output, size_t samples) {
+    std::fill_n(output, samples, 0.0f);
+    float gain = playbackGain_.load(std::memory_order_relaxed);
+    size_t active = 0;
+    std::lock_guard<std::mutex> lock(playoutMutex_);
+    // 只有正在播放的发言者需要解码，空闲的发言者只占用抖动缓冲。
+    // 发送端的帧长可以与输出长度不同，解码后未用完的部分留到下次
+    for (auto& [sourceId, speaker] : speakers_) {
+        size_t written = 0;
+        while (written < samples) {
+            if (speaker.pcmOffset >= speaker.pcm.size() && !decodeNext(speaker)) {
+                break;
+            }
+            size_t count = std::min(samples - written, speaker.pcm.size() - speaker.pcmOffset);
+            mixAccumulateGain(output + written, speaker.pcm.data() + speaker.pcmOffset, gain, count);
+            speaker.pcmOffset += count;
+            written += count;
         }
-        std::cout << std::dec << std::endl;
-        
-        std::cerr << "无法解析服务器消息类型" << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << "处理服务器消息时发生错误: " << e.what() << std::endl;
+        if (written > 0) {
+            ++active;
+        }
+    }
+    if (active > 0) {
+        mixSoftClip(output, samples);
     }
+    return active;
 }
 
-void VoiceClient::handleAudioData(const AudioData& audioData) {
-    if (audioData.user_id() == userId_) {
-        return; // 忽略自己的音频
+void VoiceClient::renderAudio(float* output, size_t samples) {
+    // 不加锁、不解码也不分配内存，媒体线程没有及时混好的部分补静音
+    if (samples > renderBlock_.load(std::memory_order_relaxed)) {
+        renderBlock_.store(samples, std::memory_order_relaxed);
     }
+    size_t copied = playoutRing_->read(output, samples);
+    std::fill_n(output + copied, samples - copied, 0.0f);
+}
 
-    try {
-        // 获取音频数据
-        const std::string& payload = audioData.audio_payload();
-        std::vector<uint8_t> encodedData(payload.begin(), payload.end());
-        
-        // 解码音频数据
-        std::vector<float> decodedData = audioCodec_->decode(encodedData);
-        
-        // 设置回调以播放音频
-        audioDevice_->setCallback([](const std::vector<float>& data) {
-            // 这里不需要做任何事情，因为我们是在播放模式
-        });
-        
-        // 初始化音频设备（作为输出设备）
-        if (!audioDevice_->initialize(48000, 1)) {
-            std::cerr << "Failed to initialize audio device for playback" << std::endl;
-            return;
+void VoiceClient::queueCapture(const float* samples, size_t count) {
+    // 运行在实时音频回调中，只写入环形缓冲和原子计数；媒体线程来不及取出时丢弃放不下的部分
+    size_t written = captureRing_->write(samples, count);
+    if (written < count) {
+        captureOverflow_.fetch_add(static_cast<uint32_t>(count - written), std::memory_order_relaxed);
+        PlayoutMetrics::instance().captureXruns.add();
+    }
+}
+
+void VoiceClient::mediaLoop() {
+    std::vector<float> captured(captureRing_->capacity());
+    std::vector<float> block(PLAYOUT_BLOCK_SAMPLES);
+    SpscRing<float>& ring = *playoutRing_;
+    while (mediaRunning_.load(std::memory_order_acquire)) {
+        // 先编码发送已采集的数据（只有实时回调的设备使用 captureRing_）；
+        // 丢弃的采样同样推进采集时钟，未凑满的帧不再与之后的数据拼接
+        size_t count = captureRing_->read(captured.data(), captured.size());
+        if (count > 0) {
+            onAudioData(captured.data(), count);
         }
-        
-        // 启动音频设备进行播放
-        if (!audioDevice_->start()) {
-            std::cerr << "Failed to start audio device for playback" << std::endl;
-            return;
+        if (uint32_t dropped = captureOverflow_.exchange(0, std::memory_order_relaxed)) {
+            mediaTimestamp_ += dropped;
+            frameBlocker_.reset();
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Exception in handleAudioData: " << e.what() << std::endl;
+
+        // 渲染回调按设备的时钟取用数据，这里只补足到目标深度，抖动缓冲因此仍按设备的时钟出队
+        size_t target = std::min(renderBlock_.load(std::memory_order_relaxed) + PLAYOUT_BLOCK_SAMPLES,
+                                 ring.capacity());
+        while (ring.capacity() - ring.writeAvailable() < target) {
+            size_t active = renderPlayout(block.data(), block.size());
+            PlayoutMetrics::instance().speakers.set(static_cast<int64_t>(active));
+            ring.write(block.data(), block.size());
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextEviction_) {
+            std::lock_guard<std::mutex> lock(playoutMutex_);
+            evictIdleSpeakers(now);
+            nextEviction_ = now + SPEAKER_IDLE_TIMEOUT;
+        }
+        std::this_thread::sleep_for(MEDIA_POLL_INTERVAL);
+    }
+}
+
+void VoiceClient::startMedia() {
+    // 音频设备和媒体线程都已停止，没有其他线程访问环形缓冲，可以重新创建
+    captureRing_ = std::make_unique<SpscRing<float>>(48000 * AUDIO_RING_MILLISECONDS / 1000);
+    playoutRing_ = std::make_unique<SpscRing<float>>(48000 * AUDIO_RING_MILLISECONDS / 1000);
+    captureOverflow_.store(0, std::memory_order_relaxed);
+    renderBlock_.store(0, std::memory_order_relaxed);
+    nextEviction_ = std::chrono::steady_clock::now() + SPEAKER_IDLE_TIMEOUT;
+    mediaRunning_.store(true, std::memory_order_release);
+    mediaThread_ = std::thread([this] { mediaLoop(); });
+}
+
+void VoiceClient::stopMedia() {
+    mediaRunning_.store(false, std::memory_order_release);
+    if (mediaThread_.joinable()) {
+        mediaThread_.join();
     }
 }
 
+std::unordered_map<uint32_t, std::chrono::milliseconds> VoiceClient::getPlayoutDelays() const {
+    std::unordered_map<uint32_t, std::chrono::milliseconds> delays;
+    std::lock_guard<std::mutex> lock(playoutMutex_);
+    for (const auto& [sourceId, speaker] : speakers_) {
+        delays[sourceId] = speaker.jitter.currentDelay();
+    }
+    return delays;
+}
+
 void VoiceClient::handleServerResponse(const ServerResponse& response) {
+    // 服务器分配了媒体令牌时启用UDP媒体通道，UDP不通时自动使用TCP
+    if (response.media_token() != 0 && connection_) {
+        connection_->enableMedia(response.media_token());
+    }
+    // 进入房间后使用新分配的源ID
+    if (response.source_id() != 0) {
+        sourceId_.store(response.source_id(), std::memory_order_relaxed);
+    }
+    
     std::lock_guard<std::mutex> lock(responseMutex_);
     if (responsePromise_) {
+        // response 分配在解析 arena 上，交给等待方的是一份独立的副本
         responsePromise_->set_value(response);
+        responsePromise_.reset();
+    }
+}
+
+bool VoiceClient::setFrameDuration(std::chrono::microseconds duration) {
+    if (!currentRoomId_.empty()) {
+        VC_LOG_ERROR("Frame duration can only be changed outside a room");
+        return false;
+    }
+    if (!audioCodec_->setFrameDuration(duration)) {
+        VC_LOG_ERROR("Unsupported Opus frame duration: " << duration.count() << " us");
+        return false;
     }
+    frameBlocker_.setFrameSamples(static_cast<size_t>(audioCodec_->frameSize()));
+    return true;
 }
 
-void VoiceClient::onAudioData(const std::vector<uint8_t>& audioData) {
-    if (!connection_ || currentRoomId_.empty() || muted_) {
+void VoiceClient::onAudioData(const float* samples, size_t count) {
+    // 采集时钟按每次采集到的采样数推进，静音、未进入房间或编码失败的帧同样计入，
+    // 接收端由时间戳的跳变得知中间经过了多长时间
+    uint32_t frameStart = mediaTimestamp_ - static_cast<uint32_t>(frameBlocker_.pending());
+    mediaTimestamp_ += static_cast<uint32_t>(count);
+
+    uint32_t sourceId = sourceId_.load(std::memory_order_relaxed);
+    if (!inRoom_.load(std::memory_order_acquire) || muted_.load(std::memory_order_relaxed) || sourceId == 0) {
+        frameBlocker_.reset();
         return;
     }
 
+    // 设备缓冲的长度任意，凑满一个编码帧再编码发送，每帧的时间戳为其第一个采样的采集时刻
+    frameBlocker_.push(samples, count,
+        [this, sourceId, &frameStart](const float* frame, size_t samples) {
+            sendAudioFrame(sourceId, frameStart, frame, samples);
+            frameStart += static_cast<uint32_t>(samples);
+        });
+}
+
+void VoiceClient::sendAudioFrame(uint32_t sourceId, uint32_t timestamp, const float* pcm, size_t samples) {
     try {
-        // 将uint8_t数据转换为float
-        std::vector<float> floatData(audioData.size() / sizeof(float));
-        std::memcpy(floatData.data(), audioData.data(), audioData.size());
-        
         // 编码音频数据
-        std::vector<uint8_t> encodedData = audioCodec_->encode(floatData);
-        
-        // 创建音频消息
-        AudioData msg;
-        msg.set_user_id(userId_);
-        msg.set_audio_payload(std::string(encodedData.begin(), encodedData.end()));
-        msg.set_timestamp(std::chrono::system_clock::now().time_since_epoch().count());
-        msg.set_sequence_number(0); // TODO: 实现序列号
-        
-        // 序列化音频消息
-        std::vector<uint8_t> messageData(msg.ByteSizeLong());
-        if (!msg.SerializeToArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            std::cerr << "序列化音频消息失败" << std::endl;
+        std::vector<uint8_t> encodedData = audioCodec_->encode(pcm, samples);
+        if (encodedData.empty()) {
             return;
         }
         
-        // 准备完整的消息（4字节头 + 数据）
-        std::vector<uint8_t> packet;
-        packet.reserve(4 + messageData.size());
+        // 填写媒体包头，序列号只对发出的包递增
+        MediaHeader header;
+        header.audioLevel = static_cast<uint8_t>(audioLevelOf(pcm, samples));
+        header.sequence = mediaSequence_++;
+        header.timestamp = timestamp;
+        header.sourceId = sourceId;
         
-        // 添加长度头（4字节，小端序）
-        uint32_t size = static_cast<uint32_t>(messageData.size());
-        for (int i = 0; i < 4; ++i) {
-            packet.push_back(static_cast<uint8_t>((size >> (i * 8)) & 0xFF));
-        }
-        
-        // 添加数据
-        packet.insert(packet.end(), messageData.begin(), messageData.end());
+        // 包头和编码数据直接写入帧缓冲后发送
+        connection_->send(encodeMediaFrame(header, encodedData.data(), encodedData.size()), SendPriority::Media);
+    } catch (const std::exception& e) {
+        VC_LOG_ERROR("处理音频数据时发生错误: " << e.what());
+    }
+}
+
+bool VoiceClient::setRoomMixing(bool enabled) {
+    if (!connection_) {
+        VC_LOG_ERROR("Not connected to server");
+        return false;
+    }
+
+    try {
+        ControlMessage request;
+        request.set_type(ControlMessage::SET_ROOM_MODE);
+        request.set_user_id(userId_);
+        request.set_protocol_version(PROTOCOL_VERSION);
+        request.set_room_mode(enabled ? ControlMessage::MIX : ControlMessage::FORWARD);
         
-        // 发送数据
-        connection_->send(packet);
+        ServerResponse response;
+        return sendRequest(request, response) && response.status() == ServerResponse::SUCCESS;
     } catch (const std::exception& e) {
-        std::cerr << "处理音频数据时发生错误: " << e.what() << std::endl;
+        VC_LOG_ERROR("Exception in setRoomMixing: " << e.what());
+        return false;
     }
 }
 
@@ -301,17 +554,18 @@ std::unordered_map<std::string, size_t> VoiceClient::getAvailableRooms() {
     std::unordered_map<std::string, size_t> rooms;
     
     try {
-        std::cout << "正在获取可用房间列表..." << std::endl;
+        VC_LOG_DEBUG("正在获取可用房间列表...");
         
         // 创建请求消息
         ControlMessage request;
         request.set_type(ControlMessage::LIST_ROOMS);
         request.set_user_id(userId_);
+        request.set_protocol_version(PROTOCOL_VERSION);
         
         // 发送请求并等待响应
         ServerResponse response;
         if (sendRequest(request, response)) {
-            std::cout << "收到服务器响应: " << response.message() << std::endl;
+            VC_LOG_DEBUG("收到服务器响应: " << response.message());
             
             // 解析响应消息中的房间信息
             std::istringstream iss(response.message());
@@ -322,14 +576,14 @@ std::unordered_map<std::string, size_t> VoiceClient::getAvailableRooms() {
                     std::string roomId = line.substr(0, pos);
                     size_t count = std::stoull(line.substr(pos + 1));
                     rooms[roomId] = count;
-                    std::cout << "解析到房间: " << roomId << " (在线人数: " << count << ")" << std::endl;
+                    VC_LOG_DEBUG("解析到房间: " << roomId << " (在线人数: " << count << ")");
                 }
             }
         } else {
-            std::cout << "获取房间列表请求超时或失败" << std::endl;
+            VC_LOG_WARN("获取房间列表请求超时或失败");
         }
     } catch (const std::exception& e) {
-        std::cerr << "获取房间列表失败: " << e.what() << std::endl;
+        VC_LOG_ERROR("获取房间列表失败: " << e.what());
     }
     
     return rooms;
@@ -341,50 +595,35 @@ bool VoiceClient::sendRequest(const ControlMessage& request, ServerResponse& res
     }
 
     try {
-        std::cout << "准备发送请求，类型: " << request.type() << std::endl;
-        
-        // 序列化控制消息
-        std::vector<uint8_t> messageData(request.ByteSizeLong());
-        if (!request.SerializeToArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            throw std::runtime_error("序列化控制消息失败");
-        }
-        
-        // 准备完整的消息（4字节头 + 数据）
-        std::vector<uint8_t> packet;
-        packet.reserve(4 + messageData.size());
-        
-        // 添加长度头（4字节，小端序）
-        uint32_t size = static_cast<uint32_t>(messageData.size());
-        for (int i = 0; i < 4; ++i) {
-            packet.push_back(static_cast<uint8_t>((size >> (i * 8)) & 0xFF));
-        }
+        VC_LOG_DEBUG("准备发送请求，类型: " << request.type());
         
-        // 添加数据
-        packet.insert(packet.end(), messageData.begin(), messageData.end());
+        // 直接序列化进帧缓冲
+        SharedFrame frame = encodeFrame(FRAME_CONTROL, request);
         
-        // 设置新的 Promise
+        // 设置新的 Promise（响应到达后会被重置，future 需在锁内取出）
+        std::future<ServerResponse> future;
         {
             std::unique_lock<std::mutex> lock(responseMutex_);
             responsePromise_ = std::make_shared<std::promise<ServerResponse>>();
+            future = responsePromise_->get_future();
         }
-        auto future = responsePromise_->get_future();
         
         // 发送请求
-        if (!connection_->send(packet)) {
-            std::cout << "发送请求失败" << std::endl;
+        if (!connection_->send(frame)) {
+            VC_LOG_WARN("发送请求失败");
             return false;
         }
-        std::cout << "请求已发送，数据大小: " << messageData.size() << " 字节，等待响应..." << std::endl;
+        VC_LOG_DEBUG("请求已发送，数据大小: " << frame->bodySize() << " 字节，等待响应...");
         
         // 等待响应（设置5秒超时）
         if (future.wait_for(std::chrono::seconds(5)) == std::future_status::ready) {
             response = future.get();
-            std::cout << "成功接收到响应: " << response.message() << std::endl;
+            VC_LOG_DEBUG("成功接收到响应: " << response.message());
             return true;
         }
-        std::cout << "等待响应超时（5秒）" << std::endl;
+        VC_LOG_WARN("等待响应超时（5秒）");
     } catch (const std::exception& e) {
-        std::cerr << "发送请求时发生错误: " << e.what() << std::endl;
+        VC_LOG_ERROR("发送请求时发生错误: " << e.what());
     }
     
     return false;
@@ -1,36 +1,72 @@
 #include "voice_server.hpp"
-#include <iostream>
-#include <iomanip>
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "protocol.hpp"
+#include <random>
 #include <sstream>
 
 namespace voicechat {
 
 const std::string MAIN_CHANNEL = "main";  // 定义主频道ID
 
-// 添加辅助函数，用于发送带消息头的数据
-void sendWithHeader(AsioServer* server, const std::string& clientId, const std::vector<uint8_t>& data) {
-    // 准备完整的消息（4字节头 + 数据）
-    std::vector<uint8_t> packet;
-    packet.reserve(4 + data.size());
-    
-    // 添加长度头（4字节，小端序）
-    uint32_t size = static_cast<uint32_t>(data.size());
-    for (int i = 0; i < 4; ++i) {
-        packet.push_back(static_cast<uint8_t>((size >> (i * 8)) & 0xFF));
+namespace {
+
+// 服务器层指标，传输层的收发统计见 asio_network.cpp
+struct ServerMetrics {
+    Counter& parseFailures;
+    Counter& rejectedClients;
+    Counter& audioForwarded;
+    Counter& audioSuppressed;
+    Counter& audioRejected;
+    Counter& bridgeIn;
+    Counter& bridgeOut;
+    Gauge& rooms;
+
+    static ServerMetrics& instance() {
+        static ServerMetrics metrics(MetricsRegistry::instance());
+        return metrics;
     }
-    
-    // 添加数据
-    packet.insert(packet.end(), data.begin(), data.end());
-    
-    // 发送数据
-    server->sendTo(clientId, packet);
+
+private:
+    explicit ServerMetrics(MetricsRegistry& r)
+        : parseFailures(r.counter("voicechat_parse_failures_total", "Messages that failed to parse"))
+        , rejectedClients(r.counter("voicechat_rejected_clients_total", "Clients rejected for protocol errors"))
+        , audioForwarded(r.counter("voicechat_audio_frames_total", "Audio frames by routing decision",
+                                   "result=\"forwarded\""))
+        , audioSuppressed(r.counter("voicechat_audio_frames_total", "Audio frames by routing decision",
+                                    "result=\"suppressed\""))
+        , audioRejected(r.counter("voicechat_audio_frames_total", "Audio frames by routing decision",
+                                  "result=\"rejected\""))
+        , bridgeIn(r.counter("voicechat_bridge_packets_total", "Media packets exchanged with peer nodes",
+                             "direction=\"in\""))
+        , bridgeOut(r.counter("voicechat_bridge_packets_total", "Media packets exchanged with peer nodes",
+                              "direction=\"out\""))
+        , rooms(r.gauge("voicechat_rooms", "Open rooms including the main channel"))
+    {
+    }
+};
+
+} // namespace
+
+VoiceServer::VoiceServer(uint16_t port, size_t ioThreads)
+    : VoiceServer(port, std::make_unique<AsioServer>(ioThreads)) {
 }
 
-VoiceServer::VoiceServer(uint16_t port)
-    : port_(port), running_(false), server_(std::make_unique<AsioServer>()) {
+VoiceServer::VoiceServer(uint16_t port, std::unique_ptr<INetworkServer> server)
+    : port_(port), running_(false), server_(std::move(server))
+    , clientCount_(0), routes_(server_->maxClients()), sourceIds_(server_->maxClients())
+    , nextSourceId_(std::random_device{}()), rooms_(MAX_ROOMS), roomChannels_(MAX_ROOMS)
+    , maxForwardedSpeakers_(SpeakerSelector::DEFAULT_MAX_SPEAKERS)
+    , mixingRooms_(std::make_shared<const std::vector<std::shared_ptr<RoomChannel>>>())
+    , mixerRunning_(false), bridgePeers_(server_->maxClients())
+    , bridgeRooms_(std::make_shared<const BridgeRoomList>()), bridgeRoomsDirty_(false) {
+    // 源ID从随机值开始递增，与RTP的SSRC一样，桥接的多个节点之间不需要协调也几乎不会冲突
+    while (isMixerSourceId(nextSourceId_)) {
+        ++nextSourceId_;
+    }
     // 创建主频道
-    rooms_[MAIN_CHANNEL] = std::unordered_set<std::string>();
-    std::cout << "创建主频道: " << MAIN_CHANNEL << std::endl;
+    mainRoom_ = findOrCreateRoomLocked(MAIN_CHANNEL);
+    VC_LOG_INFO("创建主频道: " << MAIN_CHANNEL);
 }
 
 VoiceServer::~VoiceServer() {
@@ -49,27 +85,38 @@ bool VoiceServer::start() {
     
     try {
         // 设置消息回调
-        server_->setMessageCallback([this](const std::string& clientId, const std::vector<uint8_t>& data) {
+        server_->setMessageCallback([this](ClientId clientId, ByteSpan data) {
             onMessage(clientId, data);
         });
 
         // 设置客户端连接回调
-        server_->setClientConnectedCallback([this](const std::string& clientId) {
+        server_->setClientConnectedCallback([this](ClientId clientId) {
             onClientConnected(clientId);
         });
 
         // 设置客户端断开连接回调
-        server_->setClientDisconnectedCallback([this](const std::string& clientId) {
+        server_->setClientDisconnectedCallback([this](ClientId clientId) {
             onClientDisconnected(clientId);
         });
 
-        server_->start(port_);
+        if (!server_->start(port_)) {
+            return false;
+        }
         running_ = true;
-        std::cout << "服务器启动成功，监听端口: " << port_ << std::endl;
-        std::cout << "主频道已开启，等待客户端连接..." << std::endl;
+        
+        if (bridge_) {
+            bridge_->start();
+        }
+        
+        mixerRunning_ = true;
+        mixerThread_ = std::thread([this]() {
+            runMixer();
+        });
+        VC_LOG_INFO("服务器启动成功，监听端口: " << port_);
+        VC_LOG_INFO("主频道已开启，等待客户端连接...");
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Failed to start server: " << e.what() << std::endl;
+        VC_LOG_ERROR("Failed to start server: " << e.what());
         return false;
     }
 }
@@ -79,23 +126,34 @@ void VoiceServer::stop() {
         return;
     }
     
+    mixerRunning_ = false;
+    if (mixerThread_.joinable()) {
+        mixerThread_.join();
+    }
+    
+    if (bridge_) {
+        bridge_->stop();
+    }
+    
     try {
         server_->stop();
     } catch (const std::exception& e) {
-        std::cerr << "Error while stopping server: " << e.what() << std::endl;
+        VC_LOG_ERROR("Error while stopping server: " << e.what());
     }
     running_ = false;
 }
 
 size_t VoiceServer::getConnectedClientsCount() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    return clientRooms_.size();
+    return clientCount_;
 }
 
 size_t VoiceServer::getRoomParticipantsCount(const std::string& roomId) const {
     std::lock_guard<std::mutex> lock(mutex_);
-    if (auto it = rooms_.find(roomId); it != rooms_.end()) {
-        return it->second.size();
+    if (auto it = roomNames_.find(roomId); it != roomNames_.end()) {
+        if (const Room* room = rooms_.find(it->second)) {
+            return room->channel->snapshot()->size();
+        }
     }
     return 0;
 }
@@ -103,119 +161,373 @@ size_t VoiceServer::getRoomParticipantsCount(const std::string& roomId) const {
 std::unordered_map<std::string, size_t> VoiceServer::getRoomParticipantCounts() const {
     std::lock_guard<std::mutex> lock(mutex_);
     std::unordered_map<std::string, size_t> counts;
-    for (const auto& [roomId, participants] : rooms_) {
-        counts[roomId] = participants.size();
-    }
+    rooms_.forEach([&counts](RoomId, const Room& room) {
+        counts[room.name] = room.channel->snapshot()->size();
+    });
     return counts;
 }
 
-void VoiceServer::onClientConnected(const std::string& clientId) {
+void VoiceServer::setMaxForwardedSpeakers(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxForwardedSpeakers_ = count;
+    rooms_.forEach([count](RoomId, Room& room) {
+        room.channel->selector.setMaxSpeakers(count);
+    });
+}
+
+bool VoiceServer::setRoomMixing(const std::string& roomId, bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = roomNames_.find(roomId);
+    if (it == roomNames_.end()) {
+        return false;
+    }
+    return setRoomMixingLocked(it->second, enabled);
+}
+
+std::unordered_map<std::string, MixerStats> VoiceServer::getMixerStats() const {
+    std::unordered_map<std::string, MixerStats> stats;
+    for (const auto& room : *std::atomic_load(&mixingRooms_)) {
+        if (auto mixer = room->currentMixer()) {
+            stats[room->name] = mixer->stats();
+        }
+    }
+    return stats;
+}
+
+void VoiceServer::enableBridge(const std::string& nodeId, std::vector<BridgePeer> peers, const std::string& secret) {
+    bridge_ = std::make_unique<RoomBridge>(nodeId, std::move(peers), secret, [this]() {
+        return bridgeRoomsSnapshot();
+    });
+}
+
+bool VoiceServer::setRoomMixingLocked(RoomId roomId, bool enabled) {
+    Room* room = rooms_.find(roomId);
+    if (!room) {
+        return false;
+    }
+    if ((room->channel->currentMixer() != nullptr) == enabled) {
+        return true;
+    }
+    
+    std::shared_ptr<RoomMixer> mixer;
+    if (enabled) {
+        mixer = std::make_shared<RoomMixer>(room->name);
+    }
+    std::atomic_store(&room->channel->mixer, std::move(mixer));
+    publishMixingRoomsLocked();
+    bridgeRoomsDirty_ = true;
+    VC_LOG_INFO("房间 " << room->name << (enabled ? " 切换为服务器混音模式" : " 切换为转发模式"));
+    return true;
+}
+
+void VoiceServer::publishMixingRoomsLocked() {
+    auto mixingRooms = std::make_shared<std::vector<std::shared_ptr<RoomChannel>>>();
+    rooms_.forEach([&mixingRooms](RoomId, const Room& room) {
+        if (room.channel->currentMixer()) {
+            mixingRooms->push_back(room.channel);
+        }
+    });
+    std::atomic_store(&mixingRooms_, std::shared_ptr<const std::vector<std::shared_ptr<RoomChannel>>>(std::move(mixingRooms)));
+}
+
+void VoiceServer::runMixer() {
+    // 每 MIXER_REPORT_TICKS 个周期（5秒）输出一次各房间的混音耗时
+    constexpr uint64_t MIXER_REPORT_TICKS = 250;
+    
+    std::vector<MixOutput> outputs;
+    uint64_t tickCount = 0;
+    auto next = std::chrono::steady_clock::now();
+    while (mixerRunning_) {
+        next += MIX_INTERVAL;
+        
+        auto rooms = std::atomic_load(&mixingRooms_);
+        for (const auto& room : *rooms) {
+            auto mixer = room->currentMixer();
+            if (!mixer) {
+                continue;
+            }
+            outputs.clear();
+            mixer->tick(*room->snapshot(), outputs);
+            for (const auto& output : outputs) {
+                try {
+                    server_->multicastFrame(output.recipients, output.frame, SendPriority::Media);
+                } catch (const std::exception& e) {
+                    VC_LOG_ERROR("Failed to send mix to room " << room->name << ": " << e.what());
+                }
+            }
+        }
+        
+        if (++tickCount % MIXER_REPORT_TICKS == 0) {
+            for (const auto& room : *rooms) {
+                if (auto mixer = room->currentMixer()) {
+                    MixerStats stats = mixer->stats();
+                    VC_LOG_INFO("房间 " << room->name << " 混音: 发言者 " << stats.speakers
+                                << "，平均 " << (stats.ticks ? stats.totalNanos / stats.ticks / 1000 : 0) << " us/周期"
+                                << "，最大 " << stats.maxNanos / 1000 << " us"
+                                << "，CPU占用 " << stats.load() * 100.0 << "%");
+                }
+            }
+        }
+        
+        // 处理落后超过一个周期时不再补发，从当前时间重新计时
+        auto now = std::chrono::steady_clock::now();
+        if (now > next + MIX_INTERVAL) {
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+ClientInfo* VoiceServer::findClientLocked(ClientId clientId) {
+    size_t index = handleIndex(clientId);
+    if (clientId == INVALID_HANDLE || index >= clients_.size() || clients_[index].id != clientId) {
+        return nullptr;
+    }
+    return &clients_[index];
+}
+
+RoomId VoiceServer::findOrCreateRoomLocked(const std::string& name) {
+    if (auto it = roomNames_.find(name); it != roomNames_.end()) {
+        return it->second;
+    }
+    RoomId roomId = rooms_.insert(Room{name, std::make_shared<RoomChannel>(name, maxForwardedSpeakers_)});
+    if (roomId != INVALID_HANDLE) {
+        roomNames_[name] = roomId;
+        Room* room = rooms_.find(roomId);
+        room->channel->id = roomId;
+        std::atomic_store(&roomChannels_[handleIndex(roomId)], room->channel);
+        updateBridgeTargetsLocked(*room->channel);
+        ServerMetrics::instance().rooms.set(static_cast<int64_t>(rooms_.size()));
+    }
+    return roomId;
+}
+
+bool VoiceServer::addToRoomLocked(ClientInfo& client, RoomId roomId) {
+    Room* room = rooms_.find(roomId);
+    if (!room) {
+        return false;
+    }
+    
+    // 复制当前快照并修改，再原子替换；正在广播的读者继续使用旧快照
+    auto members = std::make_shared<MemberList>(*room->channel->snapshot());
+    members->push_back(client.id);
+    if (members->size() == 1) {
+        bridgeRoomsDirty_ = true;
+    }
+    std::atomic_store(&room->channel->members, std::shared_ptr<const MemberList>(std::move(members)));
+    
+    // 每次进入房间分配新的源ID，接收方据此区分同一客户端前后两次的音频流
+    client.sourceId = nextSourceId_++;
+    while (isMixerSourceId(nextSourceId_)) {
+        ++nextSourceId_;
+    }
+    size_t index = handleIndex(client.id);
+    if (index < sourceIds_.size()) {
+        sourceIds_[index].store(client.sourceId, std::memory_order_relaxed);
+    }
+    
+    client.roomId = roomId;
+    publishRouteLocked(client.id, room->channel);
+    return true;
+}
+
+void VoiceServer::publishRouteLocked(ClientId clientId, std::shared_ptr<RoomChannel> channel) {
+    size_t index = handleIndex(clientId);
+    if (index < routes_.size()) {
+        std::atomic_store(&routes_[index], std::move(channel));
+    }
+}
+
+void VoiceServer::removeFromRoomLocked(ClientInfo& client) {
+    RoomId roomId = client.roomId;
+    Room* room = rooms_.find(roomId);
+    client.roomId = INVALID_HANDLE;
+    publishRouteLocked(client.id, nullptr);
+    if (!room) {
+        return;
+    }
+    room->channel->selector.removeSpeaker(client.id);
+    auto mixer = room->channel->currentMixer();
+    if (mixer) {
+        mixer->removeSpeaker(client.id);
+    }
+    
+    // 成员顺序无关紧要，与末尾交换后删除
+    auto members = std::make_shared<MemberList>(*room->channel->snapshot());
+    for (size_t i = 0; i < members->size(); ++i) {
+        if ((*members)[i] == client.id) {
+            (*members)[i] = members->back();
+            members->pop_back();
+            break;
+        }
+    }
+    bool empty = members->empty();
+    std::atomic_store(&room->channel->members, std::shared_ptr<const MemberList>(std::move(members)));
+    if (empty) {
+        bridgeRoomsDirty_ = true;
+    }
+    
+    if (empty && room->name != MAIN_CHANNEL) {  // 不删除主频道
+        std::atomic_store(&roomChannels_[handleIndex(roomId)], std::shared_ptr<RoomChannel>());
+        roomNames_.erase(room->name);
+        rooms_.erase(roomId);
+        ServerMetrics::instance().rooms.set(static_cast<int64_t>(rooms_.size()));
+        if (mixer) {
+            publishMixingRoomsLocked();
+        }
+    }
+}
+
+void VoiceServer::onClientConnected(ClientId clientId) {
     std::lock_guard<std::mutex> lock(mutex_);
     
+    // 客户端句柄的槽位下标是稠密的，按需扩展
+    size_t index = handleIndex(clientId);
+    if (index >= clients_.size()) {
+        clients_.resize(index + 1);
+    }
+    ClientInfo& client = clients_[index];
+    client = ClientInfo();
+    client.id = clientId;
+    ++clientCount_;
+    
     // 将客户端加入主频道
-    clientRooms_[clientId] = MAIN_CHANNEL;
-    rooms_[MAIN_CHANNEL].insert(clientId);
+    addToRoomLocked(client, mainRoom_);
     
-    std::cout << "客户端已连接: " << clientId << " (自动加入主频道)" << std::endl;
+    VC_LOG_INFO("客户端已连接: " << clientId << " (自动加入主频道)");
 
     // 发送欢迎消息
     try {
         ServerResponse response;
         response.set_status(ServerResponse::SUCCESS);
         response.set_message("欢迎来到语音聊天服务器！已自动加入主频道");
+        response.set_media_token(server_->getMediaToken(clientId));
+        response.set_source_id(client.sourceId);
         
-        std::vector<uint8_t> data(response.ByteSizeLong());
-        response.SerializeToArray(data.data(), static_cast<int>(data.size()));
-        sendWithHeader(server_.get(), clientId, data);
+        server_->sendFrame(clientId, encodeFrame(FRAME_RESPONSE, response));
     } catch (const std::exception& e) {
-        std::cerr << "发送欢迎消息失败: " << e.what() << std::endl;
+        VC_LOG_ERROR("发送欢迎消息失败: " << e.what());
     }
 }
 
-void VoiceServer::onClientDisconnected(const std::string& clientId) {
+void VoiceServer::onClientDisconnected(ClientId clientId) {
     std::lock_guard<std::mutex> lock(mutex_);
-    if (auto it = clientRooms_.find(clientId); it != clientRooms_.end()) {
-        auto roomId = it->second;
-        rooms_[roomId].erase(clientId);
-        if (rooms_[roomId].empty() && roomId != MAIN_CHANNEL) {  // 不删除主频道
-            rooms_.erase(roomId);
+    if (ClientInfo* client = findClientLocked(clientId)) {
+        if (!client->bridgeNode.empty()) {
+            // 桥接链路在 HELLO 时已离开房间并从客户端计数中扣除
+            if (handleIndex(clientId) < bridgePeers_.size()) {
+                bridgePeers_[handleIndex(clientId)].store(false, std::memory_order_relaxed);
+            }
+            auto it = peerNodes_.find(client->bridgeNode);
+            if (it != peerNodes_.end() && it->second.clientId == clientId) {
+                VC_LOG_WARN("桥接节点 " << client->bridgeNode << " 的链路断开");
+                std::unordered_map<std::string, uint32_t> rooms = std::move(it->second.rooms);
+                peerNodes_.erase(it);
+                for (const auto& entry : rooms) {
+                    if (auto name = roomNames_.find(entry.first); name != roomNames_.end()) {
+                        updateBridgeTargetsLocked(*rooms_.find(name->second)->channel);
+                    }
+                }
+            }
+        } else {
+            removeFromRoomLocked(*client);
+            --clientCount_;
         }
-        clientRooms_.erase(it);
+        *client = ClientInfo();
     }
-    std::cout << "客户端断开连接: " << clientId << std::endl;
+    VC_LOG_INFO("客户端断开连接: " << clientId);
 }
 
-void VoiceServer::onMessage(const std::string& clientId, const std::vector<uint8_t>& data) {
+void VoiceServer::onMessage(ClientId clientId, ByteSpan data) {
     try {
-        std::cout << "收到来自客户端 " << clientId << " 的消息，大小: " << data.size() << " 字节" << std::endl;
-        
-        // 检查消息大小是否至少包含头部
-        if (data.size() < 4) {
-            std::cerr << "消息太短，无法包含头部" << std::endl;
-            return;
-        }
-        
-        // 解析消息长度（4字节，小端序）
-        uint32_t messageSize = 0;
-        for (int i = 0; i < 4; ++i) {
-            messageSize |= (static_cast<uint32_t>(data[i]) << (i * 8));
-        }
-        
-        std::cout << "消息头指示的数据大小: " << messageSize << " 字节" << std::endl;
-        
-        // 检查消息大小是否合理
-        if (data.size() != messageSize + 4) {
-            std::cerr << "消息大小不匹配，期望: " << (messageSize + 4) << "，实际: " << data.size() << std::endl;
-            return;
-        }
+        VC_LOG_TRACE("收到来自客户端 " << clientId << " 的消息，大小: " << data.size() << " 字节");
         
-        // 获取实际消息数据
-        std::vector<uint8_t> messageData(data.begin() + 4, data.end());
-        
-        // 尝试解析为控制消息
-        voicechat::ControlMessage controlMsg;
-        if (controlMsg.ParseFromArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            std::cout << "成功解析为控制消息，类型: " << controlMsg.type() 
-                     << "，用户ID: " << controlMsg.user_id() << std::endl;
-            handleControlMessage(clientId, controlMsg);
-            return;
-        }
-        std::cout << "不是控制消息，尝试解析为音频消息" << std::endl;
-
-        // 尝试解析为音频消息
-        voicechat::AudioData audioMsg;
-        if (audioMsg.ParseFromArray(messageData.data(), static_cast<int>(messageData.size()))) {
-            std::cout << "成功解析为音频消息，来自用户: " << audioMsg.user_id() << std::endl;
-            handleAudioData(clientId, audioMsg);
-            return;
-        }
-
-        // 如果都解析失败，打印消息内容以便调试
-        std::cout << "消息内容（十六进制）: ";
-        for (size_t i = 0; i < messageData.size(); ++i) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') 
-                     << static_cast<int>(messageData[i]) << " ";
+        // 按类型字节分发，每条消息只解析一次
+        // 长度头已由传输层去除，data 即为消息体
+        const uint8_t* payload = data.data() + FRAME_TYPE_SIZE;
+        int payloadSize = static_cast<int>(data.size() - FRAME_TYPE_SIZE);
+        switch (frameTypeOf(data.data(), data.size())) {
+            case FRAME_CONTROL: {
+                // 控制消息解析在线程的 arena 上，处理完成后整体释放
+                ParseArena::Scope arena;
+                voicechat::ControlMessage& controlMsg = *arena.create<voicechat::ControlMessage>();
+                if (!controlMsg.ParseFromArray(payload, payloadSize)) {
+                    VC_LOG_WARN("控制消息解析失败，来自客户端: " << clientId);
+                    ServerMetrics::instance().parseFailures.add();
+                    return;
+                }
+                if (controlMsg.protocol_version() != PROTOCOL_VERSION) {
+                    rejectClient(clientId, "协议版本不匹配，服务器版本: " + std::to_string(PROTOCOL_VERSION) +
+                                           "，客户端版本: " + std::to_string(controlMsg.protocol_version()));
+                    return;
+                }
+                VC_LOG_DEBUG("成功解析为控制消息，类型: " << controlMsg.type() 
+                             << "，用户ID: " << controlMsg.user_id());
+                handleControlMessage(clientId, controlMsg);
+                return;
+            }
+            case FRAME_MEDIA: {
+                // 媒体包只读取定长头，音频数据不复制
+                MediaView audio;
+                if (!parseMediaPacket(payload, data.size() - FRAME_TYPE_SIZE, audio)) {
+                    VC_LOG_WARN("媒体包解析失败，来自客户端: " << clientId);
+                    ServerMetrics::instance().parseFailures.add();
+                    return;
+                }
+                VC_LOG_TRACE("收到媒体包，源ID: " << audio.header.sourceId << "，序列号: " << audio.header.sequence);
+                handleAudioData(clientId, audio, data);
+                return;
+            }
+            case FRAME_BRIDGE: {
+                ParseArena::Scope arena;
+                BridgeMessage& bridgeMsg = *arena.create<BridgeMessage>();
+                if (!bridgeMsg.ParseFromArray(payload, payloadSize)) {
+                    VC_LOG_WARN("桥接消息解析失败，来自客户端: " << clientId);
+                    ServerMetrics::instance().parseFailures.add();
+                    return;
+                }
+                handleBridgeMessage(clientId, bridgeMsg);
+                return;
+            }
+            case FRAME_BRIDGE_MEDIA:
+                handleBridgeMedia(clientId, data);
+                return;
+            default:
+                // 旧版本客户端的消息没有类型字节，无法识别
+                rejectClient(clientId, "无法识别的消息类型，请升级客户端");
+                return;
         }
-        std::cout << std::dec << std::endl;
-
-        std::cerr << "无法解析消息类型，来自客户端: " << clientId << std::endl;
     } catch (const std::exception& e) {
-        std::cerr << "处理客户端 " << clientId << " 的消息时发生错误: " << e.what() << std::endl;
+        VC_LOG_ERROR("处理客户端 " << clientId << " 的消息时发生错误: " << e.what());
     }
 }
 
-void VoiceServer::handleControlMessage(const std::string& clientId, const voicechat::ControlMessage& msg) {
+void VoiceServer::rejectClient(ClientId clientId, const std::string& reason) {
+    VC_LOG_WARN("拒绝客户端 " << clientId << ": " << reason);
+    ServerMetrics::instance().rejectedClients.add();
+    
+    ServerResponse response;
+    response.set_status(ServerResponse::ERROR);
+    response.set_message(reason);
+    server_->sendFrame(clientId, encodeFrame(FRAME_RESPONSE, response));
+    
+    // 错误响应发送完毕后断开连接
+    server_->disconnectClient(clientId);
+}
+
+void VoiceServer::handleControlMessage(ClientId clientId, const voicechat::ControlMessage& msg) {
     std::lock_guard<std::mutex> lock(mutex_);
     switch (msg.type()) {
         case ControlMessage::LIST_ROOMS: {
-            std::cout << "收到获取房间列表请求，来自客户端: " << clientId << std::endl;
+            VC_LOG_DEBUG("收到获取房间列表请求，来自客户端: " << clientId);
             
             // 构建房间列表响应
             std::ostringstream oss;
-            for (const auto& [roomId, participants] : rooms_) {
-                oss << roomId << ":" << participants.size() << "\n";
-                std::cout << "添加房间到列表: " << roomId << " (在线人数: " << participants.size() << ")" << std::endl;
-            }
+            rooms_.forEach([&oss](RoomId, const Room& room) {
+                size_t count = room.channel->snapshot()->size();
+                oss << room.name << ":" << count << "\n";
+                VC_LOG_DEBUG("添加房间到列表: " << room.name << " (在线人数: " << count << ")");
+            });
             
             // 发送响应
             try {
@@ -223,107 +535,325 @@ void VoiceServer::handleControlMessage(const std::string& clientId, const voicec
                 response.set_status(ServerResponse::SUCCESS);
                 response.set_message(oss.str());
                 
-                std::vector<uint8_t> data(response.ByteSizeLong());
-                response.SerializeToArray(data.data(), static_cast<int>(data.size()));
-                sendWithHeader(server_.get(), clientId, data);
-                std::cout << "已发送房间列表响应，数据大小: " << data.size() << " 字节" << std::endl;
+                SharedFrame frame = encodeFrame(FRAME_RESPONSE, response);
+                server_->sendFrame(clientId, frame);
+                VC_LOG_DEBUG("已发送房间列表响应，数据大小: " << frame->bodySize() << " 字节");
             } catch (const std::exception& e) {
-                std::cerr << "发送房间列表失败: " << e.what() << std::endl;
+                VC_LOG_ERROR("发送房间列表失败: " << e.what());
             }
             break;
         }
         case ControlMessage::JOIN: {
-            std::string roomId = msg.room_id();
-            if (roomId.empty()) {
-                roomId = MAIN_CHANNEL;  // 如果没有指定房间，使用主频道
+            std::string roomName = msg.room_id();
+            if (roomName.empty()) {
+                roomName = MAIN_CHANNEL;  // 如果没有指定房间，使用主频道
             }
             
-            // 如果客户端已在某个房间，先离开该房间
-            if (auto it = clientRooms_.find(clientId); it != clientRooms_.end()) {
-                rooms_[it->second].erase(clientId);
-                if (rooms_[it->second].empty() && it->second != MAIN_CHANNEL) {  // 不删除主频道
-                    rooms_.erase(it->second);
-                }
+            ClientInfo* client = findClientLocked(clientId);
+            if (!client) {
+                break;
             }
+            client->userId = msg.user_id();
+            
+            // 如果客户端已在某个房间，先离开该房间
+            removeFromRoomLocked(*client);
             
             // 加入新房间
-            clientRooms_[clientId] = roomId;
-            rooms_[roomId].insert(clientId);
-            std::cout << "客户端 " << clientId << " 加入房间: " << roomId << std::endl;
+            RoomId roomId = findOrCreateRoomLocked(roomName);
+            if (!addToRoomLocked(*client, roomId)) {
+                VC_LOG_WARN("房间数量已达上限，客户端 " << clientId << " 回到主频道");
+                addToRoomLocked(*client, mainRoom_);
+                roomName = MAIN_CHANNEL;
+            }
+            VC_LOG_INFO("客户端 " << clientId << " 加入房间: " << roomName);
             
             // 发送确认消息
             try {
                 ServerResponse response;
                 response.set_status(ServerResponse::SUCCESS);
-                response.set_message("成功加入房间: " + roomId);
+                response.set_message("成功加入房间: " + roomName);
+                response.set_media_token(server_->getMediaToken(clientId));
+                response.set_source_id(client->sourceId);
                 
-                std::vector<uint8_t> data(response.ByteSizeLong());
-                response.SerializeToArray(data.data(), static_cast<int>(data.size()));
-                sendWithHeader(server_.get(), clientId, data);
+                server_->sendFrame(clientId, encodeFrame(FRAME_RESPONSE, response));
             } catch (const std::exception& e) {
-                std::cerr << "发送房间加入确认消息失败: " << e.what() << std::endl;
+                VC_LOG_ERROR("发送房间加入确认消息失败: " << e.what());
             }
             break;
         }
         case ControlMessage::LEAVE: {
-            if (auto it = clientRooms_.find(clientId); it != clientRooms_.end()) {
-                std::string oldRoom = it->second;
-                rooms_[oldRoom].erase(clientId);
-                if (rooms_[oldRoom].empty() && oldRoom != MAIN_CHANNEL) {  // 不删除主频道
-                    rooms_.erase(oldRoom);
-                }
+            ClientInfo* client = findClientLocked(clientId);
+            if (client && client->roomId != INVALID_HANDLE) {
+                const Room* room = rooms_.find(client->roomId);
+                std::string oldRoom = room ? room->name : MAIN_CHANNEL;
+                removeFromRoomLocked(*client);
                 
                 // 离开当前房间后自动回到主频道
-                clientRooms_[clientId] = MAIN_CHANNEL;
-                rooms_[MAIN_CHANNEL].insert(clientId);
+                addToRoomLocked(*client, mainRoom_);
                 
-                std::cout << "客户端 " << clientId << " 离开房间: " << oldRoom << " (自动回到主频道)" << std::endl;
+                VC_LOG_INFO("客户端 " << clientId << " 离开房间: " << oldRoom << " (自动回到主频道)");
                 
                 // 发送确认消息
                 try {
                     ServerResponse response;
                     response.set_status(ServerResponse::SUCCESS);
                     response.set_message("已离开房间: " + oldRoom + "，回到主频道");
+                    response.set_source_id(client->sourceId);
                     
-                    std::vector<uint8_t> data(response.ByteSizeLong());
-                    response.SerializeToArray(data.data(), static_cast<int>(data.size()));
-                    sendWithHeader(server_.get(), clientId, data);
+                    server_->sendFrame(clientId, encodeFrame(FRAME_RESPONSE, response));
                 } catch (const std::exception& e) {
-                    std::cerr << "发送房间离开确认消息失败: " << e.what() << std::endl;
+                    VC_LOG_ERROR("发送房间离开确认消息失败: " << e.what());
                 }
             }
             break;
         }
+        case ControlMessage::SET_ROOM_MODE: {
+            ClientInfo* client = findClientLocked(clientId);
+            const Room* room = client ? rooms_.find(client->roomId) : nullptr;
+            if (!room) {
+                break;
+            }
+            bool mixing = msg.room_mode() == ControlMessage::MIX;
+            std::string roomName = room->name;
+            bool ok = setRoomMixingLocked(client->roomId, mixing);
+            
+            try {
+                ServerResponse response;
+                response.set_status(ok ? ServerResponse::SUCCESS : ServerResponse::ERROR);
+                response.set_message("房间 " + roomName + (mixing ? " 已切换为服务器混音模式" : " 已切换为转发模式"));
+                
+                server_->sendFrame(clientId, encodeFrame(FRAME_RESPONSE, response));
+            } catch (const std::exception& e) {
+                VC_LOG_ERROR("发送房间模式确认消息失败: " << e.what());
+            }
+            break;
+        }
         default:
-            std::cerr << "未知的控制消息类型，来自客户端: " << clientId << std::endl;
+            VC_LOG_WARN("未知的控制消息类型，来自客户端: " << clientId);
             break;
     }
 }
 
-void VoiceServer::handleAudioData(const std::string& clientId, const voicechat::AudioData& audioData) {
+void VoiceServer::handleAudioData(ClientId clientId, const MediaView& audio, ByteSpan packet) {
+    // 音频路径不获取 mutex_：通过原子读取拿到发送者所在房间及其成员快照，
+    // 加入、离开等控制操作只会替换快照，不会阻塞转发
+    size_t index = handleIndex(clientId);
+    if (index >= routes_.size()) {
+        return;
+    }
+    std::shared_ptr<RoomChannel> room = std::atomic_load(&routes_[index]);
+    if (!room) {
+        return;
+    }
+    
+    // 源ID必须是服务器分配给该客户端的，切换房间前发出的包和伪造的源ID都被丢弃
+    if (audio.header.sourceId != sourceIds_[index].load(std::memory_order_relaxed)) {
+        ServerMetrics::instance().audioRejected.add();
+        return;
+    }
+    
+    // 混音模式下由混音线程解码、混音后统一发送
+    if (auto mixer = room->currentMixer()) {
+        mixer->submit(clientId, audio.payload);
+        return;
+    }
+    
+    // 只转发房间内最响的几个发言者，电平由发送端提供，DTX静音帧按静音处理
+    uint32_t level = isOpusSilence(audio.payload) ? 0 : audio.header.audioLevel;
+    if (!room->selector.shouldForward(clientId, level)) {
+        ServerMetrics::instance().audioSuppressed.add();
+        return;
+    }
+    ServerMetrics::instance().audioForwarded.add();
+    
+    // 收到的字节就是要转发的媒体包，包头中已有源ID，无需改写；
+    // 每个数据包只复制进一个池化的帧，房间内所有接收者共享该缓冲区。
+    // 记录接收时间，传输层在写出完成时统计转发延迟
+    FramePtr frame = makeFrame(packet.data(), packet.size());
+    frame->setIngestTime(std::chrono::steady_clock::now());
+    broadcastToRoom(*room, frame, clientId);
+    forwardToBridge(*room, packet);
+}
+
+void VoiceServer::broadcastToRoom(const RoomChannel& room, const SharedFrame& frame, ClientId excludeClientId) {
+    std::shared_ptr<const MemberList> members = room.snapshot();
+    // 接收者列表按线程复用，稳定运行时不分配内存
+    thread_local std::vector<ClientId> recipients;
+    recipients.clear();
+    bool senderPresent = excludeClientId == INVALID_HANDLE;
+    for (ClientId clientId : *members) {
+        if (clientId != excludeClientId) {
+            recipients.push_back(clientId);
+        } else {
+            senderPresent = true;
+        }
+    }
+    
+    // 槽位已被新客户端复用时，旧句柄不在快照中，丢弃该数据
+    if (!senderPresent) {
+        return;
+    }
+    
+    try {
+        // 使用UDP媒体通道的接收者由传输层批量发送
+        server_->multicastFrame(recipients, frame, SendPriority::Media);
+    } catch (const std::exception& e) {
+        VC_LOG_ERROR("Failed to send data to room " << room.name << ": " << e.what());
+    }
+}
+
+void VoiceServer::handleBridgeMessage(ClientId clientId, const BridgeMessage& msg) {
     std::lock_guard<std::mutex> lock(mutex_);
-    if (auto it = clientRooms_.find(clientId); it != clientRooms_.end()) {
-        std::vector<uint8_t> serializedData(audioData.ByteSizeLong());
-        if (!audioData.SerializeToArray(serializedData.data(), static_cast<int>(serializedData.size()))) {
-            std::cerr << "Failed to serialize audio data from client: " << clientId << std::endl;
+    ClientInfo* client = findClientLocked(clientId);
+    if (!client) {
+        return;
+    }
+    
+    if (msg.type() == BridgeMessage::HELLO) {
+        // 未开启桥接、不在对端列表中或密钥不一致的连接不能成为桥接链路，否则可以接管对端的链路、
+        // 向任意房间注入媒体包
+        if (!bridge_ || !client->bridgeNode.empty() || handleIndex(clientId) >= bridgePeers_.size() ||
+            !bridge_->authenticate(msg.node_id(), msg.secret())) {
+            VC_LOG_WARN("拒绝客户端 " << clientId << " 的桥接握手，节点: " << msg.node_id());
+            server_->disconnectClient(clientId);
+            return;
+        }
+        if (msg.protocol_version() != PROTOCOL_VERSION) {
+            VC_LOG_WARN("桥接节点 " << msg.node_id() << " 协议版本不匹配: " << msg.protocol_version());
+            server_->disconnectClient(clientId);
             return;
         }
-        broadcastToRoom(it->second, serializedData, clientId);
+        // 桥接链路不是房间成员，也不计入客户端数
+        removeFromRoomLocked(*client);
+        --clientCount_;
+        client->bridgeNode = msg.node_id();
+        bridgePeers_[handleIndex(clientId)].store(true, std::memory_order_relaxed);
+        
+        // 对端重连后旧链路可能尚未断开，以新链路为准，房间列表等待对端重新公布
+        PeerNode& peer = peerNodes_[client->bridgeNode];
+        peer.clientId = clientId;
+        peer.pending.clear();
+        VC_LOG_INFO("桥接节点已连接: " << client->bridgeNode << " (客户端 " << clientId << ")");
+        return;
+    }
+    
+    // 只接受当前链路上的房间列表
+    auto it = peerNodes_.find(client->bridgeNode);
+    if (client->bridgeNode.empty() || it == peerNodes_.end() || it->second.clientId != clientId) {
+        return;
+    }
+    PeerNode& peer = it->second;
+    for (const auto& room : msg.rooms()) {
+        peer.pending[room.name()] = room.channel();
+    }
+    if (!msg.last()) {
+        return;
+    }
+    
+    // 整个列表收齐后替换，只更新新增、删除或通道号变化的本地房间
+    std::unordered_map<std::string, uint32_t> previous = std::move(peer.rooms);
+    peer.rooms = std::move(peer.pending);
+    peer.pending.clear();
+    auto refresh = [this](const std::string& name) {
+        if (auto local = roomNames_.find(name); local != roomNames_.end()) {
+            updateBridgeTargetsLocked(*rooms_.find(local->second)->channel);
+        }
+    };
+    for (const auto& entry : peer.rooms) {
+        auto old = previous.find(entry.first);
+        if (old == previous.end() || old->second != entry.second) {
+            refresh(entry.first);
+        }
+    }
+    for (const auto& entry : previous) {
+        if (peer.rooms.find(entry.first) == peer.rooms.end()) {
+            refresh(entry.first);
+        }
     }
 }
 
-void VoiceServer::broadcastToRoom(const std::string& roomId, const std::vector<uint8_t>& data, const std::string& excludeClientId) {
-    if (auto it = rooms_.find(roomId); it != rooms_.end()) {
-        for (const auto& clientId : it->second) {
-            if (clientId != excludeClientId) {
-                try {
-                    server_->sendTo(clientId, data);
-                } catch (const std::exception& e) {
-                    std::cerr << "Failed to send data to client " << clientId << ": " << e.what() << std::endl;
-                }
+void VoiceServer::handleBridgeMedia(ClientId clientId, ByteSpan data) {
+    // 与本地媒体包一样不获取 mutex_，通道号即本节点的房间句柄，按槽位下标无锁查找
+    size_t index = handleIndex(clientId);
+    if (index >= bridgePeers_.size() || !bridgePeers_[index].load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint32_t channel = 0;
+    MediaView audio;
+    if (!parseBridgeMedia(data.data() + FRAME_TYPE_SIZE, data.size() - FRAME_TYPE_SIZE, channel, audio)) {
+        ServerMetrics::instance().parseFailures.add();
+        return;
+    }
+    size_t roomIndex = handleIndex(channel);
+    if (roomIndex >= roomChannels_.size()) {
+        return;
+    }
+    // 房间已删除或槽位被新房间复用时丢弃，等待对端收到新的房间列表
+    std::shared_ptr<RoomChannel> room = std::atomic_load(&roomChannels_[roomIndex]);
+    if (!room || room->id != channel || room->currentMixer()) {
+        return;
+    }
+    // 桥接的房间只转发客户端的媒体，不会有混音器的源ID
+    if (isMixerSourceId(audio.header.sourceId)) {
+        return;
+    }
+    ServerMetrics::instance().bridgeIn.add();
+    
+    // 发送节点已经做过发言者选择，这里直接发给所有本地成员，不再转发给其他节点
+    FramePtr frame = encodeMediaFrame(audio.header, audio.payload.data(), audio.payload.size());
+    frame->setIngestTime(std::chrono::steady_clock::now());
+    broadcastToRoom(*room, frame);
+}
+
+void VoiceServer::forwardToBridge(const RoomChannel& room, ByteSpan packet) {
+    std::shared_ptr<const BridgeTargets> targets = room.currentBridgeTargets();
+    if (!targets || targets->empty()) {
+        return;
+    }
+    // 每个对端的通道号不同，各自封装一个帧
+    for (const BridgeTarget& target : *targets) {
+        FramePtr frame = encodeBridgeMediaFrame(target.channel, packet.data() + FRAME_TYPE_SIZE,
+                                                packet.size() - FRAME_TYPE_SIZE);
+        if (target.link->send(frame, SendPriority::Media)) {
+            ServerMetrics::instance().bridgeOut.add();
+        }
+    }
+}
+
+void VoiceServer::updateBridgeTargetsLocked(RoomChannel& channel) {
+    std::shared_ptr<const BridgeTargets> targets;
+    if (bridge_) {
+        auto list = std::make_shared<BridgeTargets>();
+        for (const auto& entry : peerNodes_) {
+            auto room = entry.second.rooms.find(channel.name);
+            if (room == entry.second.rooms.end()) {
+                continue;
+            }
+            if (auto link = bridge_->link(entry.first)) {
+                list->push_back(BridgeTarget{std::move(link), room->second});
             }
         }
+        if (!list->empty()) {
+            targets = std::move(list);
+        }
+    }
+    std::atomic_store(&channel.bridgeTargets, std::move(targets));
+}
+
+std::shared_ptr<const BridgeRoomList> VoiceServer::bridgeRoomsSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bridgeRoomsDirty_) {
+        // 混音房间不参与桥接
+        auto rooms = std::make_shared<BridgeRoomList>();
+        rooms_.forEach([&rooms](RoomId roomId, const Room& room) {
+            if (!room.channel->snapshot()->empty() && !room.channel->currentMixer()) {
+                rooms->push_back(BridgeRoom{room.name, roomId});
+            }
+        });
+        bridgeRooms_ = std::move(rooms);
+        bridgeRoomsDirty_ = false;
     }
+    return bridgeRooms_;
 }
 
-} // namespace voicechat 
\ No newline at end of file
+} // namespace voicechat
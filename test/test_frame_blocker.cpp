@@ -0,0 +1,97 @@
+// FrameBlocker：任意长度的输入被切分为固定长度的帧，顺序不变
+#include "frame_blocker.hpp"
+#include "test_util.hpp"
+#include <functional>
+#include <numeric>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+struct Collected {
+    std::vector<std::vector<float>> frames;
+    std::vector<const float*> pointers;
+
+    void operator()(const float* frame, size_t samples) {
+        frames.emplace_back(frame, frame + samples);
+        pointers.push_back(frame);
+    }
+};
+
+std::vector<float> ramp(size_t count, float start) {
+    std::vector<float> samples(count);
+    std::iota(samples.begin(), samples.end(), start);
+    return samples;
+}
+
+void testPartialFrames() {
+    FrameBlocker blocker(4);
+    Collected collected;
+
+    std::vector<float> first = ramp(3, 0.0f);
+    blocker.push(first.data(), first.size(), std::ref(collected));
+    CHECK(collected.frames.empty());
+    CHECK_EQ(blocker.pending(), 3u);
+
+    // 先补满上次剩下的半帧，再直接输出输入中完整的一帧，剩余 1 个采样
+    std::vector<float> second = ramp(6, 3.0f);
+    blocker.push(second.data(), second.size(), std::ref(collected));
+    CHECK_EQ(collected.frames.size(), 2u);
+    CHECK(collected.frames[0] == ramp(4, 0.0f));
+    CHECK(collected.frames[1] == ramp(4, 4.0f));
+    CHECK(collected.pointers[1] == second.data() + 1);
+    CHECK_EQ(blocker.pending(), 1u);
+
+    std::vector<float> third = ramp(3, 9.0f);
+    blocker.push(third.data(), third.size(), std::ref(collected));
+    CHECK_EQ(collected.frames.size(), 3u);
+    CHECK(collected.frames[2] == ramp(4, 8.0f));
+    CHECK_EQ(blocker.pending(), 0u);
+}
+
+void testWholeFramesAreNotCopied() {
+    FrameBlocker blocker(960);
+    Collected collected;
+    std::vector<float> input = ramp(960 * 3, 0.0f);
+    blocker.push(input.data(), input.size(), std::ref(collected));
+    CHECK_EQ(collected.frames.size(), 3u);
+    for (size_t i = 0; i < collected.pointers.size(); ++i) {
+        CHECK(collected.pointers[i] == input.data() + i * 960);
+    }
+    CHECK_EQ(blocker.pending(), 0u);
+}
+
+void testResetAndResize() {
+    FrameBlocker blocker(4);
+    Collected collected;
+    std::vector<float> input = ramp(3, 0.0f);
+    blocker.push(input.data(), input.size(), std::ref(collected));
+    blocker.reset();
+    CHECK_EQ(blocker.pending(), 0u);
+
+    // 修改帧长丢弃未凑满的数据
+    blocker.push(input.data(), input.size(), std::ref(collected));
+    blocker.setFrameSamples(2);
+    CHECK_EQ(blocker.frameSamples(), 2u);
+    CHECK_EQ(blocker.pending(), 0u);
+    blocker.push(input.data(), input.size(), std::ref(collected));
+    CHECK_EQ(collected.frames.size(), 1u);
+    CHECK(collected.frames[0] == ramp(2, 0.0f));
+    CHECK_EQ(blocker.pending(), 1u);
+
+    // 帧长为 0 时不输出任何帧
+    FrameBlocker empty;
+    empty.push(input.data(), input.size(), std::ref(collected));
+    CHECK_EQ(collected.frames.size(), 1u);
+    CHECK_EQ(empty.pending(), 0u);
+}
+
+} // namespace
+
+int main() {
+    testPartialFrames();
+    testWholeFramesAreNotCopied();
+    testResetAndResize();
+    return test::result("frame_blocker");
+}
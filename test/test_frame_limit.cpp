@@ -0,0 +1,159 @@
+// AsioServer：长度头超过 maxFrameSize 的客户端被断开，服务端不按该长度分配内存；
+// 上限以内的消息照常交给上层
+#include "asio_network.hpp"
+#include "test_util.hpp"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+// 打开时记录进程内最大的一次分配
+std::atomic<bool> trackAllocations{false};
+std::atomic<size_t> largestAllocation{0};
+
+} // namespace
+
+// 替换全局 operator new/delete 时以 malloc/free 实现是合法的，GCC 在内联后会误报不匹配
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    if (trackAllocations.load(std::memory_order_relaxed)) {
+        size_t largest = largestAllocation.load(std::memory_order_relaxed);
+        while (size > largest && !largestAllocation.compare_exchange_weak(largest, size)) {
+        }
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t /*size*/) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+constexpr size_t MAX_FRAME_SIZE = 1024;
+
+// 等待条件成立，最多 5 秒
+template <typename Predicate>
+bool waitFor(Predicate predicate) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// 系统分配的空闲端口，TCP 和 UDP 都绑定在该端口上
+uint16_t freePort() {
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor(io, {boost::asio::ip::tcp::v4(), 0});
+    return acceptor.local_endpoint().port();
+}
+
+// 小端的 4 字节长度头
+std::vector<uint8_t> header(uint32_t size) {
+    return {static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+            static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24)};
+}
+
+void testOversizedHeaderDisconnects() {
+    AsioServer server(1, 16, MAX_FRAME_SIZE);
+    std::atomic<int> connected{0};
+    std::atomic<int> disconnected{0};
+    std::atomic<size_t> received{0};
+    server.setClientConnectedCallback([&](ClientId) { ++connected; });
+    server.setClientDisconnectedCallback([&](ClientId) { ++disconnected; });
+    server.setMessageCallback([&](ClientId, ByteSpan message) { received = message.size(); });
+    uint16_t port = freePort();
+    CHECK(server.start(port));
+
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+
+    // 正好等于上限的消息照常交给上层
+    boost::asio::ip::tcp::socket good(io);
+    good.connect(endpoint);
+    CHECK(waitFor([&] { return connected == 1; }));
+    std::vector<uint8_t> frame = header(MAX_FRAME_SIZE);
+    frame.resize(frame.size() + MAX_FRAME_SIZE, 0x5A);
+    boost::asio::write(good, boost::asio::buffer(frame));
+    CHECK(waitFor([&] { return received == MAX_FRAME_SIZE; }));
+    CHECK_EQ(disconnected.load(), 0);
+
+    // 声称约 2GB 的长度头：连接被断开，期间没有任何接近该长度的分配
+    // （IO线程首次写日志时会分配固定大小的日志缓冲，约 256KB）
+    boost::asio::ip::tcp::socket bad(io);
+    bad.connect(endpoint);
+    CHECK(waitFor([&] { return connected == 2; }));
+    largestAllocation = 0;
+    trackAllocations = true;
+    boost::asio::write(bad, boost::asio::buffer(header(0x7FFFFFFF)));
+    bool dropped = waitFor([&] { return disconnected == 1; });
+    trackAllocations = false;
+    CHECK(dropped);
+    CHECK(largestAllocation.load() < 1024 * 1024);
+
+    // 服务端关闭了该连接，另一个连接不受影响
+    if (dropped) {
+        boost::system::error_code ec;
+        uint8_t byte = 0;
+        boost::asio::read(bad, boost::asio::buffer(&byte, 1), ec);
+        CHECK(ec);
+    }
+    frame = header(1);
+    frame.push_back(0x01);
+    boost::asio::write(good, boost::asio::buffer(frame));
+    CHECK(waitFor([&] { return received == 1; }));
+    CHECK_EQ(disconnected.load(), 1);
+
+    server.stop();
+}
+
+void testOneByteOverLimit() {
+    AsioServer server(1, 16, MAX_FRAME_SIZE);
+    std::atomic<int> disconnected{0};
+    std::atomic<int> messages{0};
+    server.setClientDisconnectedCallback([&](ClientId) { ++disconnected; });
+    server.setMessageCallback([&](ClientId, ByteSpan) { ++messages; });
+    uint16_t port = freePort();
+    CHECK(server.start(port));
+
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::socket client(io);
+    client.connect({boost::asio::ip::address_v4::loopback(), port});
+    std::vector<uint8_t> frame = header(MAX_FRAME_SIZE + 1);
+    frame.resize(frame.size() + MAX_FRAME_SIZE + 1, 0x5A);
+    boost::system::error_code ec;
+    boost::asio::write(client, boost::asio::buffer(frame), ec);
+    CHECK(waitFor([&] { return disconnected == 1; }));
+    CHECK_EQ(messages.load(), 0);
+
+    server.stop();
+}
+
+} // namespace
+
+int main() {
+    testOversizedHeaderDisconnects();
+    testOneByteOverLimit();
+    return test::result("frame_limit");
+}
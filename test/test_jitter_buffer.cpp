@@ -0,0 +1,226 @@
+// JitterBuffer：按给定的到达时间送入包序列，逐个周期检查 pop() 的结果和统计。
+// 到达时间都由测试指定，结果不依赖运行时的时钟
+#include "jitter_buffer.hpp"
+#include "test_util.hpp"
+#include <cstdint>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+using Playout = JitterBuffer::Playout;
+
+const char* playoutName(Playout playout) {
+    switch (playout) {
+        case Playout::Empty: return "Empty";
+        case Playout::Packet: return "Packet";
+        case Playout::Fec: return "Fec";
+        case Playout::Conceal: return "Conceal";
+    }
+    return "?";
+}
+
+std::ostream& operator<<(std::ostream& out, Playout playout) {
+    return out << playoutName(playout);
+}
+
+// 20ms 帧的发送端，包的负载为序列号的低字节，便于检查取出的是哪个包
+struct Stream {
+    static constexpr uint32_t FRAME_SAMPLES = 960;
+    static constexpr uint8_t LOUD = 100;
+
+    explicit Stream(std::chrono::milliseconds minDelay = JitterBuffer::MIN_DELAY) : buffer(minDelay) {}
+
+    JitterBuffer buffer;
+    JitterBuffer::Clock::time_point start = JitterBuffer::Clock::now();
+    std::vector<uint8_t> payload;
+
+    void push(uint16_t sequence, double arrivalMs, uint8_t audioLevel = LOUD) {
+        MediaHeader header;
+        header.audioLevel = audioLevel;
+        header.sequence = sequence;
+        header.timestamp = sequence * FRAME_SAMPLES;
+        header.sourceId = 42;
+        uint8_t data = static_cast<uint8_t>(sequence);
+        auto arrival = start + std::chrono::duration_cast<JitterBuffer::Clock::duration>(
+            std::chrono::duration<double, std::milli>(arrivalMs));
+        buffer.push(header, ByteSpan(&data, 1), arrival);
+    }
+
+    Playout pop() {
+        return buffer.pop(payload);
+    }
+
+    // 最近一次取出的包的序列号（低字节）
+    int played() const {
+        return payload.size() == 1 ? payload[0] : -1;
+    }
+};
+
+void testSteadyStream() {
+    // 每 20ms 准时到达一个包，缓冲到最小延迟后逐帧播放
+    Stream stream;
+    for (uint16_t sequence = 0; sequence < 50; ++sequence) {
+        stream.push(sequence, sequence * 20.0);
+        CHECK_EQ(stream.pop(), Playout::Packet);
+        CHECK_EQ(stream.played(), sequence);
+    }
+    const JitterStats& stats = stream.buffer.stats();
+    CHECK_EQ(stats.packets, 50u);
+    CHECK_EQ(stats.fec, 0u);
+    CHECK_EQ(stats.concealed, 0u);
+    CHECK_EQ(stats.late, 0u);
+    CHECK_EQ(stats.discarded, 0u);
+    CHECK(stream.buffer.jitterMillis() < 0.01);
+    CHECK_EQ(stream.buffer.targetDelay().count(), 20);
+}
+
+void testLossRecoveredWithFec() {
+    // 包 3 丢失：该周期补偿一帧，包 4 到达后用其中的 FEC 恢复包 3，之后落后一帧继续播放
+    Stream stream;
+    std::vector<Playout> results;
+    std::vector<int> played;
+    for (uint16_t tick = 0; tick < 8; ++tick) {
+        if (tick != 3) {
+            stream.push(tick, tick * 20.0);
+        }
+        results.push_back(stream.pop());
+        played.push_back(stream.played());
+    }
+    std::vector<Playout> expected = {Playout::Packet, Playout::Packet, Playout::Packet, Playout::Conceal,
+                                     Playout::Fec, Playout::Packet, Playout::Packet, Playout::Packet};
+    CHECK(results == expected);
+    CHECK_EQ(played[4], 4);  // FEC 解码使用的是下一个包
+    CHECK_EQ(played[5], 4);
+    CHECK_EQ(played[7], 6);
+
+    const JitterStats& stats = stream.buffer.stats();
+    CHECK_EQ(stats.packets, 6u);
+    CHECK_EQ(stats.fec, 1u);
+    CHECK_EQ(stats.concealed, 1u);
+    CHECK_EQ(stats.late, 0u);
+}
+
+void testReorderedPackets() {
+    // 包 2 和 3 交换顺序到达，缓冲按序列号重排，不需要任何补偿
+    Stream stream;
+    stream.push(0, 0.0);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    stream.push(1, 20.0);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    stream.push(3, 40.0);
+    stream.push(2, 45.0);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    CHECK_EQ(stream.played(), 2);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    CHECK_EQ(stream.played(), 3);
+    CHECK_EQ(stream.buffer.stats().concealed, 0u);
+    CHECK_EQ(stream.buffer.stats().packets, 4u);
+}
+
+void testLatePacketRaisesTarget() {
+    // 已经用 FEC 恢复过的包迟到时丢弃，并把目标延迟提高一帧
+    Stream stream;
+    for (uint16_t sequence = 0; sequence < 3; ++sequence) {
+        stream.push(sequence, sequence * 20.0);
+        CHECK_EQ(stream.pop(), Playout::Packet);
+    }
+    CHECK_EQ(stream.buffer.targetDelay().count(), 20);
+    stream.push(4, 80.0);
+    CHECK_EQ(stream.pop(), Playout::Fec);  // 包 3 未到，用包 4 的 FEC 恢复
+    // 包 3 比包 4 晚 20ms 到达，抖动估计为 960/16 个采样（1.25ms），目标延迟先升到 25ms，迟到再加一帧
+    stream.push(3, 80.0);
+    CHECK_EQ(stream.buffer.stats().late, 1u);
+    CHECK_EQ(stream.buffer.targetDelay().count(), 45);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    CHECK_EQ(stream.played(), 4);
+}
+
+void testJitterRaisesTargetDelay() {
+    // 奇数包晚到 10ms，RFC 3550 的抖动估计收敛到 10ms，目标延迟为一帧加四倍抖动
+    Stream stream;
+    for (uint16_t sequence = 0; sequence < 200; ++sequence) {
+        stream.push(sequence, sequence * 20.0 + (sequence % 2 ? 10.0 : 0.0));
+        stream.pop();
+    }
+    CHECK(stream.buffer.jitterMillis() > 9.9);
+    CHECK(stream.buffer.jitterMillis() < 10.01);
+    CHECK_EQ(stream.buffer.targetDelay().count(), 60);
+    CHECK_EQ(stream.buffer.stats().late, 0u);
+}
+
+void testWaitsForTargetDelay() {
+    // 开始播放前先积累到目标延迟（这里为 60ms，即 3 帧）
+    Stream stream(std::chrono::milliseconds(60));
+    stream.push(0, 0.0);
+    CHECK_EQ(stream.pop(), Playout::Empty);
+    stream.push(1, 20.0);
+    CHECK_EQ(stream.pop(), Playout::Empty);
+    CHECK(!stream.buffer.playing());
+    stream.push(2, 40.0);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    CHECK_EQ(stream.played(), 0);
+    CHECK(stream.buffer.playing());
+    CHECK_EQ(stream.buffer.currentDelay().count(), 40);
+}
+
+void testTalkSpurtEnds() {
+    // 发言停止后补偿约 100ms，然后回到缓冲状态；下次发言从新的序列号重新开始
+    Stream stream;
+    for (uint16_t sequence = 0; sequence < 5; ++sequence) {
+        stream.push(sequence, sequence * 20.0);
+        CHECK_EQ(stream.pop(), Playout::Packet);
+    }
+    for (int tick = 0; tick < 5; ++tick) {
+        CHECK_EQ(stream.pop(), Playout::Conceal);
+    }
+    CHECK_EQ(stream.pop(), Playout::Empty);
+    CHECK(!stream.buffer.playing());
+    CHECK_EQ(stream.pop(), Playout::Empty);
+    CHECK_EQ(stream.buffer.stats().concealed, 5u);
+
+    // 重新积累到目标延迟后播放，序列号的跳变不算迟到
+    stream.push(200, 1000.0);
+    stream.push(201, 1020.0);
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    CHECK_EQ(stream.played(), 200);
+    CHECK_EQ(stream.buffer.stats().late, 0u);
+}
+
+void testDeepBufferDropsQuietFrames() {
+    // 10 个安静帧同时到达，缓冲深度 200ms 远超目标延迟，丢弃最早的帧直到不超过目标加两个调整步长
+    Stream stream;
+    for (uint16_t sequence = 0; sequence < 10; ++sequence) {
+        stream.push(sequence, 0.0, 10);
+    }
+    CHECK_EQ(stream.pop(), Playout::Packet);
+    const JitterStats& stats = stream.buffer.stats();
+    CHECK_EQ(stats.discarded, 6u);
+    CHECK_EQ(stream.played(), 6);
+    CHECK_EQ(stats.packets, 1u);
+    CHECK(stream.buffer.currentDelay() <= stream.buffer.targetDelay() + std::chrono::milliseconds(40));
+
+    // 响亮的帧在最大延迟以内不丢弃
+    Stream loud;
+    for (uint16_t sequence = 0; sequence < 10; ++sequence) {
+        loud.push(sequence, 0.0);
+    }
+    CHECK_EQ(loud.pop(), Playout::Packet);
+    CHECK_EQ(loud.played(), 0);
+    CHECK_EQ(loud.buffer.stats().discarded, 0u);
+}
+
+} // namespace
+
+int main() {
+    testSteadyStream();
+    testLossRecoveredWithFec();
+    testReorderedPackets();
+    testLatePacketRaisesTarget();
+    testJitterRaisesTargetDelay();
+    testWaitsForTargetDelay();
+    testTalkSpurtEnds();
+    testDeepBufferDropsQuietFrames();
+    return test::result("jitter_buffer");
+}
@@ -0,0 +1,121 @@
+// 指标：直方图的桶边界、分位数误差、多线程分片的合并，以及指标查询端口对请求长度的限制
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "test_util.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+void testBucketBoundaries() {
+    // 小于 16 的值每个值一个桶
+    for (uint64_t value = 0; value < Histogram::SUB_BUCKETS; ++value) {
+        CHECK_EQ(Histogram::bucketIndex(value), value);
+    }
+    // 每个桶的下界落在该桶内，下界减一落在前一个桶；之后的桶宽不超过下界的 1/16
+    for (size_t index = 1; index < Histogram::BUCKET_COUNT; ++index) {
+        uint64_t lower = Histogram::bucketLowerBound(index);
+        CHECK_EQ(Histogram::bucketIndex(lower), index);
+        CHECK_EQ(Histogram::bucketIndex(lower - 1), index - 1);
+        if (index + 1 < Histogram::BUCKET_COUNT && index >= Histogram::SUB_BUCKETS) {
+            CHECK(Histogram::bucketLowerBound(index + 1) - lower <= lower / Histogram::SUB_BUCKETS);
+        }
+    }
+    // 超出范围的值都落在最后一个桶
+    CHECK_EQ(Histogram::bucketIndex(uint64_t(1) << 48), Histogram::BUCKET_COUNT - 1);
+    CHECK_EQ(Histogram::bucketIndex(UINT64_MAX), Histogram::BUCKET_COUNT - 1);
+}
+
+void testQuantiles() {
+    Histogram histogram;
+    CHECK_EQ(histogram.snapshot().quantile(0.5), 0u);
+
+    // 1..1000 各记录一次：分位数取所在桶的中点，相对误差不超过 1/16
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+    HistogramSnapshot snapshot = histogram.snapshot();
+    CHECK_EQ(snapshot.count, 1000u);
+    CHECK_EQ(snapshot.sum, 500500u);
+    CHECK_EQ(snapshot.quantile(0.0), 1u);
+    CHECK_EQ(snapshot.quantile(0.01), 10u);
+    for (double q : {0.1, 0.5, 0.9, 0.99, 1.0}) {
+        double exact = q * 1000.0;
+        double estimate = static_cast<double>(snapshot.quantile(q));
+        CHECK(estimate >= exact * (1.0 - 1.0 / 16));
+        CHECK(estimate <= exact * (1.0 + 1.0 / 16));
+    }
+}
+
+void testShardsMerged() {
+    // 每个线程各用一个分片，快照合并所有分片后计数、总和和各桶都不丢失
+    Histogram histogram;
+    constexpr uint64_t PER_THREAD = 10000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < METRIC_SHARDS; ++t) {
+        threads.emplace_back([&histogram, t] {
+            for (uint64_t i = 0; i < PER_THREAD; ++i) {
+                histogram.record(t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    HistogramSnapshot snapshot = histogram.snapshot();
+    CHECK_EQ(snapshot.count, METRIC_SHARDS * PER_THREAD);
+    CHECK_EQ(snapshot.sum, PER_THREAD * METRIC_SHARDS * (METRIC_SHARDS - 1) / 2);
+    for (size_t t = 0; t < METRIC_SHARDS; ++t) {
+        CHECK_EQ(snapshot.buckets[Histogram::bucketIndex(t)], PER_THREAD);
+    }
+}
+
+// 发送请求并读到连接关闭，返回收到的全部数据；服务端 5 秒内没有关闭连接时 closed 为 false
+std::string query(uint16_t port, const std::string& request, bool& closed) {
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::socket socket(io);
+    socket.connect({boost::asio::ip::address_v4::loopback(), port});
+    boost::system::error_code ec;
+    boost::asio::write(socket, boost::asio::buffer(request), ec);
+    std::string response;
+    closed = false;
+    boost::asio::async_read(socket, boost::asio::dynamic_buffer(response),
+        [&closed](const boost::system::error_code& /*error*/, std::size_t /*length*/) {
+            closed = true;
+        });
+    io.run_for(std::chrono::seconds(5));
+    return response;
+}
+
+void testMetricsServerRequestLimit() {
+    MetricsServer server;
+    CHECK(server.start(0));
+    CHECK(server.port() != 0);
+
+    bool closed = false;
+    std::string response = query(server.port(), "GET /metrics HTTP/1.0\r\n\r\n", closed);
+    CHECK(closed);
+    CHECK_EQ(response.compare(0, 15, "HTTP/1.0 200 OK"), 0);
+
+    // 没有结束标记、超过 8KB 上限的请求头不会被无限缓存，服务端不回复直接关闭连接
+    std::string padding(16 * 1024, 'a');
+    response = query(server.port(), "GET /metrics HTTP/1.0\r\nX-Padding: " + padding, closed);
+    CHECK(closed);
+    CHECK(response.empty());
+    server.stop();
+}
+
+} // namespace
+
+int main() {
+    testBucketBoundaries();
+    testQuantiles();
+    testShardsMerged();
+    testMetricsServerRequestLimit();
+    return test::result("metrics");
+}
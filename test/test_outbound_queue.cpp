@@ -0,0 +1,128 @@
+// OutboundQueue：积压超限时先丢最旧的媒体包、控制消息从不丢弃、批次大小上限和写状态的切换
+#include "asio_network.hpp"
+#include "frame_buffer.hpp"
+#include "test_util.hpp"
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+constexpr size_t BODY_SIZE = 16;
+constexpr size_t FRAME_SIZE = FrameBuffer::HEADER_SIZE + BODY_SIZE;
+
+// 消息体第一个字节作为编号，便于检查批次中的顺序
+SharedFrame frame(uint8_t id) {
+    FramePtr frame = FramePool::instance().acquire(BODY_SIZE);
+    frame->body()[0] = id;
+    return frame;
+}
+
+// 取出一个批次，返回其中各帧的编号
+std::vector<int> takeIds(OutboundQueue& queue) {
+    std::vector<boost::asio::const_buffer> buffers;
+    std::vector<int> ids;
+    if (!queue.takeBatch(buffers)) {
+        return ids;
+    }
+    for (const auto& buffer : buffers) {
+        ids.push_back(static_cast<const uint8_t*>(buffer.data())[FrameBuffer::HEADER_SIZE]);
+    }
+    queue.completeBatch();
+    return ids;
+}
+
+void testOldestMediaDroppedFirst() {
+    // 上限正好容纳 5 帧，第 6 个媒体包挤掉最旧的媒体包
+    OutboundQueue queue(5 * FRAME_SIZE);
+    CHECK(queue.push(frame(1), SendPriority::Media));
+    for (uint8_t id = 2; id <= 6; ++id) {
+        CHECK(!queue.push(frame(id), SendPriority::Media));
+    }
+    CHECK_EQ(queue.droppedCount(), 1u);
+    CHECK((takeIds(queue) == std::vector<int>{2, 3, 4, 5, 6}));
+}
+
+void testControlNeverDropped() {
+    OutboundQueue queue(5 * FRAME_SIZE);
+    // 控制消息挤掉队列中的媒体包，而不是被丢弃
+    queue.push(frame(1), SendPriority::Media);
+    queue.push(frame(2), SendPriority::Control);
+    queue.push(frame(3), SendPriority::Media);
+    queue.push(frame(4), SendPriority::Control);
+    queue.push(frame(5), SendPriority::Control);
+    queue.push(frame(6), SendPriority::Control);
+    queue.push(frame(7), SendPriority::Control);
+    CHECK_EQ(queue.droppedCount(), 2u);
+
+    // 队列中只剩控制消息时，超过上限的控制消息照样入队，新的媒体包直接丢弃
+    queue.push(frame(8), SendPriority::Control);
+    CHECK(!queue.push(frame(9), SendPriority::Media));
+    CHECK_EQ(queue.droppedCount(), 3u);
+    CHECK((takeIds(queue) == std::vector<int>{2, 4, 5, 6, 7, 8}));
+}
+
+void testOrderAcrossPriorities() {
+    // 控制消息和媒体包分开存放，但批次中保持入队顺序
+    OutboundQueue queue;
+    queue.push(frame(1), SendPriority::Control);
+    queue.push(frame(2), SendPriority::Media);
+    queue.push(frame(3), SendPriority::Media);
+    queue.push(frame(4), SendPriority::Control);
+    queue.push(frame(5), SendPriority::Media);
+    CHECK((takeIds(queue) == std::vector<int>{1, 2, 3, 4, 5}));
+    CHECK_EQ(queue.droppedCount(), 0u);
+}
+
+void testBatchBoundaries() {
+    OutboundQueue queue;
+    CHECK(!queue.isWriting());
+    // 第一个包要求调用者发起写，写进行期间到达的包只入队
+    CHECK(queue.push(frame(0), SendPriority::Control));
+    CHECK(queue.isWriting());
+    const size_t total = OutboundQueue::MAX_BATCH_PACKETS + 6;
+    for (size_t i = 1; i < total; ++i) {
+        CHECK(!queue.push(frame(static_cast<uint8_t>(i)), i % 2 ? SendPriority::Media : SendPriority::Control));
+    }
+
+    std::vector<int> first = takeIds(queue);
+    CHECK_EQ(first.size(), OutboundQueue::MAX_BATCH_PACKETS);
+    CHECK_EQ(first.front(), 0);
+    CHECK_EQ(first.back(), static_cast<int>(OutboundQueue::MAX_BATCH_PACKETS - 1));
+    std::vector<int> second = takeIds(queue);
+    CHECK_EQ(second.size(), 6u);
+    CHECK_EQ(second.front(), static_cast<int>(OutboundQueue::MAX_BATCH_PACKETS));
+
+    // 队列取空后结束写状态，下一个包重新要求发起写
+    std::vector<boost::asio::const_buffer> buffers;
+    CHECK(!queue.takeBatch(buffers));
+    CHECK(buffers.empty());
+    CHECK(!queue.isWriting());
+    CHECK(queue.push(frame(1), SendPriority::Media));
+}
+
+void testGrowsPastInitialCapacity() {
+    // 超过初始容量的积压不丢包，只扩容
+    OutboundQueue queue;
+    const size_t total = OutboundQueue::INITIAL_CAPACITY * 3;
+    for (size_t i = 0; i < total; ++i) {
+        queue.push(frame(static_cast<uint8_t>(i)), SendPriority::Media);
+    }
+    size_t taken = 0;
+    for (std::vector<int> ids = takeIds(queue); !ids.empty(); ids = takeIds(queue)) {
+        taken += ids.size();
+    }
+    CHECK_EQ(taken, total);
+    CHECK_EQ(queue.droppedCount(), 0u);
+}
+
+} // namespace
+
+int main() {
+    testOldestMediaDroppedFirst();
+    testControlNeverDropped();
+    testOrderAcrossPriorities();
+    testBatchBoundaries();
+    testGrowsPastInitialCapacity();
+    return test::result("outbound_queue");
+}
@@ -0,0 +1,138 @@
+// 媒体包格式：包头编码后再解析得到相同的字段，长度不足或版本不符的包被拒绝，混音流保留的源ID
+#include "protocol.hpp"
+#include "test_util.hpp"
+#include <cstdint>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+const std::vector<uint8_t> PAYLOAD = {0xF8, 0x01, 0x02, 0x03, 0x04};
+
+MediaHeader sampleHeader() {
+    MediaHeader header;
+    header.audioLevel = 90;
+    header.sequence = 0xFFFE;
+    header.timestamp = 0xFFFFFC40;  // 再加一帧（960）即回绕
+    header.sourceId = 0x12345678;
+    return header;
+}
+
+// 媒体帧中类型字节之后的部分
+std::vector<uint8_t> packetOf(const FramePtr& frame) {
+    return std::vector<uint8_t>(frame->body() + FRAME_TYPE_SIZE, frame->body() + frame->bodySize());
+}
+
+void testMediaRoundTrip() {
+    MediaHeader header = sampleHeader();
+    FramePtr frame = encodeMediaFrame(header, PAYLOAD.data(), PAYLOAD.size());
+    CHECK_EQ(frame->bodySize(), FRAME_TYPE_SIZE + MEDIA_HEADER_SIZE + PAYLOAD.size());
+    CHECK_EQ(frameTypeOf(frame->body(), frame->bodySize()), FRAME_MEDIA);
+
+    // 多字节字段按网络字节序写入
+    std::vector<uint8_t> packet = packetOf(frame);
+    CHECK_EQ(packet[0], MEDIA_VERSION << 6);
+    CHECK_EQ(packet[2], 0xFF);
+    CHECK_EQ(packet[3], 0xFE);
+    CHECK_EQ(packet[8], 0x12);
+    CHECK_EQ(packet[11], 0x78);
+
+    MediaView view;
+    CHECK(parseMediaPacket(packet.data(), packet.size(), view));
+    CHECK_EQ(view.header.audioLevel, header.audioLevel);
+    CHECK_EQ(view.header.sequence, header.sequence);
+    CHECK_EQ(view.header.timestamp, header.timestamp);
+    CHECK_EQ(view.header.sourceId, header.sourceId);
+    CHECK(std::vector<uint8_t>(view.payload.begin(), view.payload.end()) == PAYLOAD);
+}
+
+void testAudioLevelClamped() {
+    // 超出范围的电平按最大值编码，解析时只取低7位
+    MediaHeader header = sampleHeader();
+    header.audioLevel = 200;
+    std::vector<uint8_t> packet = packetOf(encodeMediaFrame(header, nullptr, 0));
+    MediaView view;
+    CHECK(parseMediaPacket(packet.data(), packet.size(), view));
+    CHECK_EQ(view.header.audioLevel, MAX_AUDIO_LEVEL);
+    CHECK(view.payload.empty());
+
+    packet[1] = 0xFF;
+    CHECK(parseMediaPacket(packet.data(), packet.size(), view));
+    CHECK_EQ(view.header.audioLevel, MAX_AUDIO_LEVEL);
+}
+
+void testMalformedMedia() {
+    std::vector<uint8_t> packet = packetOf(encodeMediaFrame(sampleHeader(), PAYLOAD.data(), PAYLOAD.size()));
+    MediaView view;
+    // 不足一个包头的长度都被拒绝，正好一个包头时负载为空
+    for (size_t size = 0; size < MEDIA_HEADER_SIZE; ++size) {
+        CHECK(!parseMediaPacket(packet.data(), size, view));
+    }
+    CHECK(parseMediaPacket(packet.data(), MEDIA_HEADER_SIZE, view));
+    CHECK(view.payload.empty());
+
+    // 版本不符的包被拒绝，保留位不影响解析
+    std::vector<uint8_t> wrongVersion = packet;
+    wrongVersion[0] = static_cast<uint8_t>((MEDIA_VERSION + 1) << 6);
+    CHECK(!parseMediaPacket(wrongVersion.data(), wrongVersion.size(), view));
+    wrongVersion[0] = 0;
+    CHECK(!parseMediaPacket(wrongVersion.data(), wrongVersion.size(), view));
+    std::vector<uint8_t> reservedBits = packet;
+    reservedBits[0] |= 0x3F;
+    CHECK(parseMediaPacket(reservedBits.data(), reservedBits.size(), view));
+
+    // 类型字节无法识别或消息体为空
+    uint8_t unknown = 0xEE;
+    CHECK_EQ(frameTypeOf(&unknown, 1), FRAME_UNKNOWN);
+    CHECK_EQ(frameTypeOf(&unknown, 0), FRAME_UNKNOWN);
+}
+
+void testBridgeMedia() {
+    std::vector<uint8_t> packet = packetOf(encodeMediaFrame(sampleHeader(), PAYLOAD.data(), PAYLOAD.size()));
+    FramePtr frame = encodeBridgeMediaFrame(0xA1B2C3D4, packet.data(), packet.size());
+    CHECK_EQ(frameTypeOf(frame->body(), frame->bodySize()), FRAME_BRIDGE_MEDIA);
+    std::vector<uint8_t> bridged = packetOf(frame);
+    CHECK_EQ(bridged.size(), BRIDGE_CHANNEL_SIZE + packet.size());
+
+    uint32_t channel = 0;
+    MediaView view;
+    CHECK(parseBridgeMedia(bridged.data(), bridged.size(), channel, view));
+    CHECK_EQ(channel, 0xA1B2C3D4u);
+    CHECK_EQ(view.header.sourceId, sampleHeader().sourceId);
+    CHECK_EQ(view.payload.size(), PAYLOAD.size());
+
+    // 通道号或媒体包头不完整时都被拒绝
+    for (size_t size = 0; size < BRIDGE_CHANNEL_SIZE + MEDIA_HEADER_SIZE; ++size) {
+        CHECK(!parseBridgeMedia(bridged.data(), size, channel, view));
+    }
+}
+
+void testMixerSourceIds() {
+    // 混音流的两个源ID保留，不会分配给客户端；编码和解析时照常保留其取值
+    CHECK(isMixerSourceId(MIXER_SOURCE_ID));
+    CHECK(isMixerSourceId(MIXER_MINUS_SOURCE_ID));
+    CHECK(MIXER_SOURCE_ID != MIXER_MINUS_SOURCE_ID);
+    CHECK(!isMixerSourceId(2));
+    CHECK(!isMixerSourceId(0xFFFFFFFF));
+
+    for (uint32_t sourceId : {MIXER_SOURCE_ID, MIXER_MINUS_SOURCE_ID, 0xFFFFFFFFu}) {
+        MediaHeader header = sampleHeader();
+        header.sourceId = sourceId;
+        std::vector<uint8_t> packet = packetOf(encodeMediaFrame(header, nullptr, 0));
+        MediaView view;
+        CHECK(parseMediaPacket(packet.data(), packet.size(), view));
+        CHECK_EQ(view.header.sourceId, sourceId);
+    }
+}
+
+} // namespace
+
+int main() {
+    testMediaRoundTrip();
+    testAudioLevelClamped();
+    testMalformedMedia();
+    testBridgeMedia();
+    testMixerSourceIds();
+    return test::result("protocol");
+}
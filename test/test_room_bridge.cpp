@@ -0,0 +1,193 @@
+// RoomBridge：对端列表的解析、入站 HELLO 的校验，以及链路的连接、HELLO 和断开后用同一连接对象重连
+#include "room_bridge.hpp"
+#include "protocol.hpp"
+#include "test_util.hpp"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+const std::string SECRET = "0123456789abcdef";
+
+// 解析失败时返回 true
+bool rejected(const std::string& spec) {
+    try {
+        parseBridgePeers(spec);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+void testParseBridgePeers() {
+    // 逗号分隔，忽略两端空白和空项，主机中可以含有冒号（IPv6），端口取最后一个冒号之后
+    std::vector<BridgePeer> peers = parseBridgePeers(" a@10.0.0.1:9000, ,b@node-b.local:1 ,c@::1:65535,");
+    CHECK_EQ(peers.size(), 3u);
+    if (peers.size() == 3) {
+        CHECK_EQ(peers[0].nodeId, "a");
+        CHECK_EQ(peers[0].host, "10.0.0.1");
+        CHECK_EQ(peers[0].port, 9000);
+        CHECK_EQ(peers[1].host, "node-b.local");
+        CHECK_EQ(peers[1].port, 1);
+        CHECK_EQ(peers[2].host, "::1");
+        CHECK_EQ(peers[2].port, 65535);
+    }
+    CHECK(parseBridgePeers("").empty());
+
+    // 缺少节点ID、主机或端口
+    CHECK(rejected("10.0.0.1:9000"));
+    CHECK(rejected("@10.0.0.1:9000"));
+    CHECK(rejected("a@:9000"));
+    CHECK(rejected("a@10.0.0.1"));
+    CHECK(rejected("a@10.0.0.1:"));
+    // 端口超出范围或含有多余字符，都以 std::invalid_argument 报告
+    CHECK(rejected("a@h:0"));
+    CHECK(rejected("a@h:65536"));
+    CHECK(rejected("a@h:99999999999999999999"));
+    CHECK(rejected("a@h:-1"));
+    CHECK(rejected("a@h:80x"));
+    CHECK(rejected("a@h: 80"));
+    CHECK(rejected("a@h:9000,b@h"));
+}
+
+void testAuthenticate() {
+    auto noRooms = []() { return std::make_shared<const BridgeRoomList>(); };
+    RoomBridge bridge("self", parseBridgePeers("self@h:1,a@h:2,b@h:3"), SECRET, noRooms);
+    CHECK(bridge.authenticate("a", SECRET));
+    CHECK(bridge.authenticate("b", SECRET));
+
+    // 不在对端列表中的节点，包括本节点自己
+    CHECK(!bridge.authenticate("c", SECRET));
+    CHECK(!bridge.authenticate("self", SECRET));
+    CHECK(!bridge.authenticate("", SECRET));
+
+    // 密钥内容或长度不一致
+    std::string wrong = SECRET;
+    wrong.back() ^= 1;
+    CHECK(!bridge.authenticate("a", wrong));
+    CHECK(!bridge.authenticate("a", SECRET.substr(0, SECRET.size() - 1)));
+    CHECK(!bridge.authenticate("a", SECRET + SECRET));
+    CHECK(!bridge.authenticate("a", ""));
+
+    // 未配置密钥时只接受空密钥
+    RoomBridge open("self", parseBridgePeers("a@h:2"), "", noRooms);
+    CHECK(open.authenticate("a", ""));
+    CHECK(!open.authenticate("a", SECRET));
+}
+
+// 等待条件成立，最多 timeout
+template <typename Predicate>
+bool waitFor(Predicate predicate, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+uint16_t freePort() {
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor(io, {boost::asio::ip::tcp::v4(), 0});
+    return acceptor.local_endpoint().port();
+}
+
+// 充当对端节点，记录收到的桥接消息
+struct PeerNode {
+    AsioServer server{1, 16};
+    std::mutex mutex;
+    std::vector<BridgeMessage> messages;
+
+    bool start(uint16_t port) {
+        server.setMessageCallback([this](ClientId, ByteSpan message) {
+            if (frameTypeOf(message.data(), message.size()) != FRAME_BRIDGE) {
+                return;
+            }
+            BridgeMessage parsed;
+            if (parsed.ParseFromArray(message.data() + FRAME_TYPE_SIZE,
+                                      static_cast<int>(message.size() - FRAME_TYPE_SIZE))) {
+                std::lock_guard<std::mutex> lock(mutex);
+                messages.push_back(parsed);
+            }
+        });
+        return server.start(port);
+    }
+
+    size_t helloCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = 0;
+        for (const auto& message : messages) {
+            count += message.type() == BridgeMessage::HELLO;
+        }
+        return count;
+    }
+};
+
+void testLinkConnectsAndReconnects() {
+    // 一个对端可达，另一个拒绝连接：不可达的对端不影响可达链路上的 HELLO 和房间列表
+    uint16_t port = freePort();
+    uint16_t downPort = freePort();
+    auto rooms = std::make_shared<const BridgeRoomList>(BridgeRoomList{{"lobby", 7}});
+    RoomBridge bridge("self", {{"peer", "127.0.0.1", port}, {"down", "127.0.0.1", downPort}}, SECRET,
+                      [rooms]() { return rooms; });
+
+    auto peer = std::make_unique<PeerNode>();
+    CHECK(peer->start(port));
+    bridge.start();
+    CHECK(waitFor([&] { return peer->helloCount() == 1; }, std::chrono::seconds(2)));
+    CHECK(waitFor([&] {
+        std::lock_guard<std::mutex> lock(peer->mutex);
+        return peer->messages.size() >= 2;
+    }, std::chrono::seconds(2)));
+    {
+        std::lock_guard<std::mutex> lock(peer->mutex);
+        if (peer->messages.size() >= 2) {
+            const BridgeMessage& hello = peer->messages[0];
+            CHECK_EQ(hello.type(), BridgeMessage::HELLO);
+            CHECK_EQ(hello.node_id(), "self");
+            CHECK_EQ(hello.secret(), SECRET);
+            CHECK_EQ(hello.protocol_version(), PROTOCOL_VERSION);
+            const BridgeMessage& list = peer->messages[1];
+            CHECK_EQ(list.type(), BridgeMessage::ROOMS);
+            CHECK(list.last());
+            CHECK_EQ(list.rooms_size(), 1);
+        }
+    }
+    CHECK(bridge.link("peer")->isConnected());
+    CHECK(!bridge.link("down")->isConnected());
+
+    // 对端重启后，同一个连接对象在重试间隔后重新连接，新连接上先发送 HELLO
+    peer->server.stop();
+    CHECK(waitFor([&] { return !bridge.link("peer")->isConnected(); }, std::chrono::seconds(2)));
+    peer = std::make_unique<PeerNode>();
+    CHECK(peer->start(port));
+    CHECK(waitFor([&] { return peer->helloCount() == 1; },
+                  RoomBridge::RECONNECT_INTERVAL + std::chrono::seconds(2)));
+    {
+        std::lock_guard<std::mutex> lock(peer->mutex);
+        CHECK(!peer->messages.empty() && peer->messages[0].type() == BridgeMessage::HELLO);
+    }
+
+    // 停止时等待所有连接的回调结束，之后链路不再可用
+    bridge.stop();
+    CHECK(!bridge.link("peer")->isConnected());
+    CHECK(!bridge.link("peer")->send(encodeFrame(FRAME_BRIDGE, BridgeMessage()), SendPriority::Control));
+}
+
+} // namespace
+
+int main() {
+    testParseBridgePeers();
+    testAuthenticate();
+    testLinkConnectsAndReconnects();
+    return test::result("room_bridge");
+}
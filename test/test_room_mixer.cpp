@@ -0,0 +1,153 @@
+// RoomMixer：逐周期送入编码好的包，检查每个周期的输出、接收者和媒体包头
+#include "room_mixer.hpp"
+#include "protocol.hpp"
+#include "test_util.hpp"
+#include <cmath>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+constexpr ClientId SPEAKER = 1;
+constexpr ClientId LISTENER = 2;
+
+// 发送端：按给定帧长编码正弦波
+struct Sender {
+    OpusCodec codec;
+    std::vector<float> pcm;
+
+    explicit Sender(std::chrono::microseconds frameDuration) {
+        codec.initialize(MIX_SAMPLE_RATE, 1);
+        codec.setFrameDuration(frameDuration);
+        pcm.resize(static_cast<size_t>(codec.frameSize()));
+        for (size_t i = 0; i < pcm.size(); ++i) {
+            pcm[i] = 0.3f * static_cast<float>(std::sin(2.0 * 3.14159265358979 * 440.0 * i / MIX_SAMPLE_RATE));
+        }
+    }
+
+    void submit(RoomMixer& mixer, ClientId speaker) {
+        std::vector<uint8_t> packet = codec.encode(pcm);
+        mixer.submit(speaker, ByteSpan(packet));
+    }
+};
+
+MediaView parse(const SharedFrame& frame) {
+    MediaView view;
+    CHECK_EQ(frameTypeOf(frame->body(), frame->bodySize()), FRAME_MEDIA);
+    CHECK(parseMediaPacket(frame->body() + FRAME_TYPE_SIZE, frame->bodySize() - FRAME_TYPE_SIZE, view));
+    return view;
+}
+
+void testTimestampsFollowTheMixClock() {
+    // 发言 3 个周期、停顿 3 个周期后继续：停顿期间没有输出，序列号连续，时间戳按经过的周期前进
+    RoomMixer mixer("room");
+    Sender sender(std::chrono::milliseconds(20));
+    std::vector<ClientId> members = {SPEAKER, LISTENER};
+    std::vector<MediaHeader> headers;
+    for (int tick = 0; tick < 8; ++tick) {
+        if (tick < 3 || tick >= 6) {
+            sender.submit(mixer, SPEAKER);
+        }
+        std::vector<MixOutput> outputs;
+        mixer.tick(members, outputs);
+        if (tick >= 3 && tick < 6) {
+            CHECK(outputs.empty());
+            continue;
+        }
+        CHECK_EQ(outputs.size(), 1u);
+        if (outputs.size() == 1) {
+            headers.push_back(parse(outputs[0].frame).header);
+        }
+    }
+    CHECK_EQ(headers.size(), 5u);
+    if (headers.size() == 5) {
+        for (size_t i = 1; i < headers.size(); ++i) {
+            CHECK_EQ(static_cast<uint16_t>(headers[i].sequence - headers[i - 1].sequence), 1);
+        }
+        CHECK_EQ(headers[1].timestamp - headers[0].timestamp, MIX_FRAME_SAMPLES);
+        CHECK_EQ(headers[3].timestamp - headers[2].timestamp, 4 * MIX_FRAME_SAMPLES);
+        CHECK_EQ(headers[4].timestamp - headers[3].timestamp, MIX_FRAME_SAMPLES);
+        CHECK_EQ(headers[0].sourceId, MIXER_SOURCE_ID);
+    }
+}
+
+void testMixMinusStreamsShareTheClock() {
+    // 两人同时发言时各自收到 mix-minus；一人停下后他改收完整混音，两条流的时间戳都对齐混音时钟
+    RoomMixer mixer("room");
+    Sender first(std::chrono::milliseconds(20));
+    Sender second(std::chrono::milliseconds(20));
+    std::vector<ClientId> members = {SPEAKER, LISTENER};
+
+    std::vector<MixOutput> outputs;
+    first.submit(mixer, SPEAKER);
+    second.submit(mixer, LISTENER);
+    mixer.tick(members, outputs);
+    CHECK_EQ(outputs.size(), 2u);
+    for (const auto& output : outputs) {
+        CHECK_EQ(output.recipients.size(), 1u);
+        MediaView view = parse(output.frame);
+        CHECK_EQ(view.header.sourceId, MIXER_MINUS_SOURCE_ID);
+        CHECK_EQ(view.header.timestamp, 0u);
+    }
+
+    outputs.clear();
+    first.submit(mixer, SPEAKER);
+    mixer.tick(members, outputs);
+    CHECK_EQ(outputs.size(), 1u);
+    if (outputs.size() == 1) {
+        CHECK(outputs[0].recipients == std::vector<ClientId>{LISTENER});
+        MediaView view = parse(outputs[0].frame);
+        CHECK_EQ(view.header.sourceId, MIXER_SOURCE_ID);
+        CHECK_EQ(view.header.timestamp, static_cast<uint32_t>(MIX_FRAME_SAMPLES));
+    }
+}
+
+// 按 frameDuration 的帧长发言 ticks 个周期，每个周期按发送端实时产生的包数提交，返回听众收到输出的周期数
+size_t mixedTicks(std::chrono::microseconds frameDuration, int ticks) {
+    RoomMixer mixer("room");
+    Sender sender(frameDuration);
+    std::vector<ClientId> members = {SPEAKER, LISTENER};
+    const size_t frameSamples = sender.pcm.size();
+    size_t captured = 0;
+    size_t sent = 0;
+    size_t mixed = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        captured += MIX_FRAME_SAMPLES;
+        for (; (sent + 1) * frameSamples <= captured; ++sent) {
+            sender.submit(mixer, SPEAKER);
+        }
+        std::vector<MixOutput> outputs;
+        mixer.tick(members, outputs);
+        if (outputs.empty()) {
+            continue;
+        }
+        // 唯一的发言者不会收到 mix-minus，完整混音只发给听众
+        CHECK_EQ(outputs.size(), 1u);
+        CHECK(outputs[0].recipients == std::vector<ClientId>{LISTENER});
+        CHECK_EQ(mixer.stats().speakers, 1u);
+        ++mixed;
+    }
+    return mixed;
+}
+
+void testShortFrames() {
+    // 2.5ms 的帧每个周期 8 个包，凑满 960 个采样后每个周期都参与混音，不会因积压被丢弃
+    CHECK_EQ(mixedTicks(std::chrono::microseconds(2500), 50), 50u);
+}
+
+void testLongFrames() {
+    // 60ms 的帧每 3 个周期一个包，一个包解码后分 3 个周期混音；
+    // 发送端采集满 60ms 才发出第一个包，前两个周期没有输出
+    CHECK_EQ(mixedTicks(std::chrono::milliseconds(60), 30), 28u);
+}
+
+} // namespace
+
+int main() {
+    testTimestampsFollowTheMixClock();
+    testMixMinusStreamsShareTheClock();
+    testShortFrames();
+    testLongFrames();
+    return test::result("room_mixer");
+}
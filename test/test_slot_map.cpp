@@ -0,0 +1,86 @@
+// SlotMap：句柄的分配顺序、删除后旧句柄失效、表满，以及代数回绕后句柄不为 0
+#include "slot_map.hpp"
+#include "test_util.hpp"
+#include <string>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+void testInsertFindErase() {
+    SlotMap<std::string> map(3);
+    CHECK(map.empty());
+    CHECK_EQ(map.capacity(), 3u);
+
+    Handle a = map.insert("a");
+    Handle b = map.insert("b");
+    CHECK(a != INVALID_HANDLE);
+    CHECK(b != INVALID_HANDLE);
+    // 空闲槽位按下标从小到大分配
+    CHECK_EQ(handleIndex(a), 0u);
+    CHECK_EQ(handleIndex(b), 1u);
+    CHECK_EQ(map.size(), 2u);
+    CHECK(map.find(a) != nullptr && *map.find(a) == "a");
+    CHECK(map.find(INVALID_HANDLE) == nullptr);
+
+    CHECK(map.erase(a));
+    CHECK(!map.erase(a));
+    CHECK(!map.contains(a));
+    CHECK_EQ(map.size(), 1u);
+
+    // 复用的槽位代数加一，旧句柄不会指向新元素
+    Handle c = map.insert("c");
+    CHECK_EQ(handleIndex(c), handleIndex(a));
+    CHECK(c != a);
+    CHECK(map.find(a) == nullptr);
+    CHECK(*map.find(c) == "c");
+}
+
+void testFullAndForEach() {
+    SlotMap<int> map(2);
+    Handle first = map.insert(10);
+    Handle second = map.insert(20);
+    CHECK_EQ(map.insert(30), INVALID_HANDLE);
+    CHECK_EQ(map.size(), 2u);
+
+    std::vector<Handle> handles;
+    int sum = 0;
+    map.forEach([&](Handle handle, int& value) {
+        handles.push_back(handle);
+        sum += value;
+    });
+    CHECK_EQ(handles.size(), 2u);
+    CHECK(handles[0] == first && handles[1] == second);
+    CHECK_EQ(sum, 30);
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(!map.contains(first));
+    CHECK(!map.contains(second));
+    CHECK(map.insert(40) != INVALID_HANDLE);
+}
+
+void testGenerationWrap() {
+    // 槽位 0 的代数转完一整圈后仍不产生无效句柄，也不与上一个句柄相同
+    SlotMap<int> map(1);
+    Handle previous = INVALID_HANDLE;
+    bool valid = true;
+    for (uint32_t i = 0; i < HANDLE_GENERATION_MASK + 2; ++i) {
+        Handle handle = map.insert(static_cast<int>(i));
+        valid = valid && handle != INVALID_HANDLE && handle != previous && map.contains(handle);
+        map.erase(handle);
+        previous = handle;
+    }
+    CHECK(valid);
+    CHECK(map.empty());
+}
+
+} // namespace
+
+int main() {
+    testInsertFindErase();
+    testFullAndForEach();
+    testGenerationWrap();
+    return test::result("slot_map");
+}
@@ -0,0 +1,134 @@
+// SpeakerSelector：按给定的时间送入各发言者的电平序列，检查每个包是否转发。
+// 时间都由测试指定，结果不依赖运行时的时钟
+#include "speaker_selector.hpp"
+#include "test_util.hpp"
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+constexpr uint32_t LOUD = 100;
+constexpr uint32_t QUIET = SpeakerSelector::ACTIVE_LEVEL - 1;
+constexpr int PACKET_MS = 20;
+
+struct Room {
+    explicit Room(size_t maxSpeakers) : selector(maxSpeakers) {}
+
+    SpeakerSelector selector;
+    SpeakerSelector::Clock::time_point start = SpeakerSelector::Clock::now();
+
+    bool forward(ClientId speaker, uint32_t level, int ms) {
+        return selector.shouldForward(speaker, level, start + std::chrono::milliseconds(ms));
+    }
+};
+
+void testTopK() {
+    // 名额为 2：前两个开口的发言者被选中，第三个在最短保持时间内无论多响都不转发
+    Room room(2);
+    for (int tick = 0; tick < 10; ++tick) {
+        int ms = tick * PACKET_MS;
+        CHECK(room.forward(1, LOUD, ms));
+        CHECK(room.forward(2, LOUD, ms));
+        CHECK(!room.forward(3, 127, ms));
+    }
+    // 被选中的发言者的静音帧照常转发
+    CHECK(room.forward(1, 0, 200));
+    CHECK(room.forward(2, QUIET, 200));
+}
+
+void testInactiveNotSelected() {
+    // 电平低于说话门限的发言者即使有空名额也不被选中
+    Room room(2);
+    for (int tick = 0; tick < 10; ++tick) {
+        CHECK(!room.forward(1, QUIET, tick * PACKET_MS));
+    }
+    CHECK(room.forward(1, SpeakerSelector::ACTIVE_LEVEL, 200));
+}
+
+void testMinHold() {
+    // 名额为 1：更响的发言者要等被替换者保持满 600ms 才能取而代之
+    Room room(1);
+    CHECK(room.forward(1, 70, 0));
+    int replacedAt = -1;
+    for (int tick = 1; tick <= 40 && replacedAt < 0; ++tick) {
+        int ms = tick * PACKET_MS;
+        CHECK(room.forward(1, 70, ms));
+        if (room.forward(2, 120, ms)) {
+            replacedAt = ms;
+        }
+    }
+    CHECK_EQ(replacedAt, static_cast<int>(SpeakerSelector::MIN_HOLD.count()));
+
+    // 落选后不再转发，新选中的发言者同样受最短保持时间保护
+    CHECK(!room.forward(1, 127, replacedAt + PACKET_MS));
+    CHECK(room.forward(2, 120, replacedAt + PACKET_MS));
+}
+
+void testHysteresis() {
+    // 名额为 1，发言者 1 的平滑电平稳定在 80。超过保持时间后，
+    // 电平 84 的发言者差距不足 6dB 始终不能替换；电平 100 的发言者平滑电平
+    // 依次为 20、36、48.8……第 9 个包（86.6）才超过 86，此时替换
+    Room room(1);
+    int ms = 0;
+    for (; ms < 1000; ms += PACKET_MS) {
+        CHECK(room.forward(1, 80, ms));
+    }
+    for (int tick = 0; tick < 50; ++tick, ms += PACKET_MS) {
+        CHECK(room.forward(1, 80, ms));
+        CHECK(!room.forward(2, 84, ms));
+    }
+    for (int packet = 1; packet <= 9; ++packet, ms += PACKET_MS) {
+        CHECK(room.forward(1, 80, ms));
+        CHECK_EQ(room.forward(3, LOUD, ms), packet == 9);
+    }
+    CHECK(!room.forward(1, 80, ms));
+}
+
+void testStaleSpeakerReplaced() {
+    // 被选中的发言者停止说话超过 400ms 后，任何开口的发言者都可立即替换他，不受保持时间和迟滞限制
+    Room room(1);
+    CHECK(room.forward(1, 127, 0));
+    int replacedAt = -1;
+    for (int tick = 1; tick <= 40 && replacedAt < 0; ++tick) {
+        int ms = tick * PACKET_MS;
+        CHECK(room.forward(1, 0, ms));
+        if (room.forward(2, 70, ms)) {
+            replacedAt = ms;
+        }
+    }
+    CHECK_EQ(replacedAt, static_cast<int>(SpeakerSelector::SPEAKER_TIMEOUT.count() + PACKET_MS));
+}
+
+void testRemoveAndResize() {
+    Room room(2);
+    CHECK(room.forward(1, LOUD, 0));
+    CHECK(room.forward(2, LOUD, 0));
+    CHECK(!room.forward(3, LOUD, 0));
+
+    // 离开房间立即让出名额
+    room.selector.removeSpeaker(1);
+    CHECK(room.forward(3, LOUD, PACKET_MS));
+
+    // 名额减少时最近选中的先落选
+    room.selector.setMaxSpeakers(1);
+    CHECK(room.forward(2, LOUD, 2 * PACKET_MS));
+    CHECK(!room.forward(3, LOUD, 2 * PACKET_MS));
+
+    // 0 表示不限制，静音的包也转发
+    room.selector.setMaxSpeakers(0);
+    CHECK(room.forward(3, 0, 3 * PACKET_MS));
+    CHECK(room.forward(4, 0, 3 * PACKET_MS));
+}
+
+} // namespace
+
+int main() {
+    testTopK();
+    testInactiveNotSelected();
+    testMinHold();
+    testHysteresis();
+    testStaleSpeakerReplaced();
+    testRemoveAndResize();
+    return test::result("speaker_selector");
+}
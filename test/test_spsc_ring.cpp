@@ -0,0 +1,99 @@
+// SpscRing：容量取整、写满截断、回绕后的顺序，以及一读一写两个线程并发时不丢不乱
+#include "spsc_ring.hpp"
+#include "test_util.hpp"
+#include <thread>
+#include <vector>
+
+using namespace voicechat;
+
+namespace {
+
+void testCapacity() {
+    CHECK_EQ(SpscRing<float>(5).capacity(), 8u);
+    CHECK_EQ(SpscRing<float>(8).capacity(), 8u);
+    CHECK_EQ(SpscRing<float>(1).capacity(), 1u);
+
+    SpscRing<int> ring(4);
+    CHECK_EQ(ring.readAvailable(), 0u);
+    CHECK_EQ(ring.writeAvailable(), 4u);
+
+    // 空间不足时只写入能容纳的部分
+    int input[6] = {1, 2, 3, 4, 5, 6};
+    CHECK_EQ(ring.write(input, 6), 4u);
+    CHECK_EQ(ring.readAvailable(), 4u);
+    CHECK_EQ(ring.writeAvailable(), 0u);
+    CHECK_EQ(ring.write(input, 1), 0u);
+
+    int output[6] = {};
+    CHECK_EQ(ring.read(output, 6), 4u);
+    CHECK_EQ(output[0], 1);
+    CHECK_EQ(output[3], 4);
+    CHECK_EQ(ring.read(output, 1), 0u);
+}
+
+void testWrapAround() {
+    SpscRing<int> ring(4);
+    int next = 0;
+    int expected = 0;
+    // 每轮写 3 个读 3 个，读写位置在数组末尾回绕
+    for (int round = 0; round < 10; ++round) {
+        int input[3] = {next, next + 1, next + 2};
+        next += 3;
+        CHECK_EQ(ring.write(input, 3), 3u);
+        int output[3] = {};
+        CHECK_EQ(ring.read(output, 3), 3u);
+        for (int value : output) {
+            CHECK_EQ(value, expected);
+            ++expected;
+        }
+    }
+    CHECK_EQ(ring.readAvailable(), 0u);
+}
+
+void testConcurrentProducer() {
+    constexpr int TOTAL = 200000;
+    SpscRing<int> ring(256);
+
+    std::thread producer([&ring]() {
+        std::vector<int> block(37);
+        int next = 0;
+        while (next < TOTAL) {
+            size_t count = 0;
+            for (; count < block.size() && next + static_cast<int>(count) < TOTAL; ++count) {
+                block[count] = next + static_cast<int>(count);
+            }
+            size_t written = ring.write(block.data(), count);
+            next += static_cast<int>(written);
+            if (written == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<int> output(53);
+    int expected = 0;
+    bool ordered = true;
+    while (expected < TOTAL) {
+        size_t count = ring.read(output.data(), output.size());
+        for (size_t i = 0; i < count; ++i) {
+            ordered = ordered && output[i] == expected;
+            ++expected;
+        }
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK_EQ(expected, TOTAL);
+    CHECK_EQ(ring.readAvailable(), 0u);
+}
+
+} // namespace
+
+int main() {
+    testCapacity();
+    testWrapAround();
+    testConcurrentProducer();
+    return test::result("spsc_ring");
+}
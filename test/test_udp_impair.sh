@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# 在回环网络上测试UDP媒体通道：通过 VOICECHAT_UDP_IMPAIR 模拟丢包、延迟和抖动
+# 用法: ./test_udp_impair.sh ["loss=0.05,delay=40,jitter=20,dup=0.01"]
+# 设置 loss=1 可模拟UDP被阻断，客户端应回退到TCP
+
+# 定义颜色
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+# 定义变量
+SERVER_PORT=8080
+BIN_DIR="../build/bin"
+IMPAIR="${1:-loss=0.05,delay=40,jitter=20,dup=0.01}"
+
+# 确保在正确的目录
+cd "$(dirname "$0")" || exit 1
+
+if [ ! -f "$BIN_DIR/voice_server" ] || [ ! -f "$BIN_DIR/voice_client" ]; then
+    echo -e "${RED}错误：找不到服务器或客户端可执行文件。${NC}"
+    exit 1
+fi
+
+echo -e "${BLUE}UDP损伤参数: $IMPAIR${NC}"
+
+# 服务器和客户端都对发出的数据报施加损伤
+export VOICECHAT_UDP_IMPAIR="$IMPAIR"
+
+echo -e "${GREEN}启动语音聊天服务器...${NC}"
+$BIN_DIR/voice_server $SERVER_PORT &
+SERVER_PID=$!
+sleep 2
+
+echo -e "${GREEN}启动客户端 user1 和 user2...${NC}"
+$BIN_DIR/voice_client user1 127.0.0.1 $SERVER_PORT &
+CLIENT1_PID=$!
+sleep 1
+$BIN_DIR/voice_client user2 127.0.0.1 $SERVER_PORT &
+CLIENT2_PID=$!
+
+echo
+echo "客户端输出中的 \"UDP媒体通道已启用\" 表示音频走UDP，"
+echo "\"UDP媒体通道超时，音频回退到TCP\" 表示已回退到TCP"
+echo -e "${RED}按回车键结束测试...${NC}"
+read
+
+kill $SERVER_PID $CLIENT1_PID $CLIENT2_PID 2>/dev/null
+echo -e "${GREEN}测试结束${NC}"
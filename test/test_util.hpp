@@ -0,0 +1,43 @@
+#pragma once
+
+// 单元测试共用的断言：失败时打印位置并计数，不中止，main 根据失败数返回退出码
+#include <iostream>
+
+namespace voicechat {
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int result(const char* name) {
+    if (failures() == 0) {
+        std::cout << name << ": 全部通过" << std::endl;
+        return 0;
+    }
+    std::cerr << name << ": " << failures() << " 项检查失败" << std::endl;
+    return 1;
+}
+
+} // namespace test
+} // namespace voicechat
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": 检查失败: " #condition << std::endl; \
+            ++voicechat::test::failures();                                                   \
+        }                                                                                    \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                          \
+    do {                                                                                    \
+        const auto& actualValue = (actual);                                                 \
+        const auto& expectedValue = (expected);                                             \
+        if (!(actualValue == expectedValue)) {                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": 检查失败: " #actual " == " #expected \
+                      << "，实际为 " << actualValue << "，期望 " << expectedValue << std::endl; \
+            ++voicechat::test::failures();                                                  \
+        }                                                                                   \
+    } while (0)